@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <new>
+
+#if defined(__linux__)
+#   include <sys/mman.h>
+#endif
+
+namespace leekpp
+{
+
+/** \addtogroup Storage
+ *  \{
+**/
+
+/** How an \c aligned_allocator backs large allocations. **/
+enum class page_mode
+{
+    /** Use regular pages. **/
+    normal,
+    /** Map memory aligned to a huge page and ask the kernel to back it with transparent huge pages
+     *  (<tt>madvise(MADV_HUGEPAGE)</tt>). The kernel is free to ignore this, in which case regular pages are used.
+    **/
+    transparent_huge,
+    /** Map memory from the explicit huge page pool (\c MAP_HUGETLB). This needs huge pages to be reserved ahead of
+     *  time (for example, through \c /proc/sys/vm/nr_hugepages); when the pool is too small, this falls back to
+     *  \c transparent_huge.
+    **/
+    explicit_huge,
+};
+
+namespace detail
+{
+
+/** The size of a huge page which \c page_mode assumes. This is the default on x86-64 and most ARM64 kernels. **/
+static constexpr std::size_t huge_page_size = std::size_t(1) << 21;
+
+inline std::size_t round_up(std::size_t value, std::size_t multiple)
+{
+    return (value + multiple - 1) / multiple * multiple;
+}
+
+/** Should an allocation of \a bytes with \a mode be mapped with \c allocate_huge? Anything smaller than a huge page
+ *  could not use one anyway, so it uses the regular allocator instead.
+**/
+inline bool use_huge_pages(page_mode mode, std::size_t bytes)
+{
+#if defined(__linux__)
+    return mode != page_mode::normal && bytes >= huge_page_size;
+#else
+    static_cast<void>(mode);
+    static_cast<void>(bytes);
+    return false;
+#endif
+}
+
+#if defined(__linux__)
+
+/** Map \a bytes (rounded up to a whole number of huge pages) aligned to \c huge_page_size.
+ *
+ *  \returns The mapping or \c nullptr if it could not be created.
+**/
+inline void* allocate_huge(page_mode mode, std::size_t bytes)
+{
+    std::size_t length = round_up(bytes, huge_page_size);
+    if (mode == page_mode::explicit_huge)
+    {
+        void* ptr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED)
+            return ptr;
+    }
+
+    // mmap only aligns to a regular page, so over-map by a huge page and trim both ends to get huge page alignment
+    std::size_t padded = length + huge_page_size;
+    void* raw = ::mmap(nullptr, padded, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (raw == MAP_FAILED)
+        return nullptr;
+
+    auto raw_addr   = reinterpret_cast<std::uintptr_t>(raw);
+    auto start_addr = round_up(raw_addr, huge_page_size);
+    if (start_addr != raw_addr)
+        ::munmap(raw, start_addr - raw_addr);
+    if (std::size_t tail = padded - (start_addr - raw_addr) - length)
+        ::munmap(reinterpret_cast<void*>(start_addr + length), tail);
+
+    void* ptr = reinterpret_cast<void*>(start_addr);
+#if defined(MADV_HUGEPAGE)
+    // Failure only means the kernel was built without transparent huge pages, which leaves regular pages
+    ::madvise(ptr, length, MADV_HUGEPAGE);
+#endif
+    return ptr;
+}
+
+inline void deallocate_huge(void* ptr, std::size_t bytes)
+{
+    ::munmap(ptr, round_up(bytes, huge_page_size));
+}
+
+#endif
+
+/** Allocate \a bytes aligned to \a alignment, which is a power of 2. Before C++17 there is no aligned
+ *  <tt>operator new</tt>, so this over-allocates and keeps the pointer to free just before the aligned block.
+**/
+inline void* allocate_aligned(std::size_t bytes, std::size_t alignment)
+{
+#if defined(__cpp_aligned_new)
+    return ::operator new(bytes, std::align_val_t(alignment));
+#else
+    std::size_t padding = alignment + sizeof(void*);
+    if (bytes > std::numeric_limits<std::size_t>::max() - padding)
+        throw std::bad_alloc();
+    auto raw     = static_cast<char*>(::operator new(bytes + padding));
+    auto aligned = round_up(reinterpret_cast<std::uintptr_t>(raw) + sizeof(void*), alignment);
+    reinterpret_cast<void**>(aligned)[-1] = raw;
+    return reinterpret_cast<void*>(aligned);
+#endif
+}
+
+inline void deallocate_aligned(void* ptr, std::size_t alignment)
+{
+#if defined(__cpp_aligned_new)
+    ::operator delete(ptr, std::align_val_t(alignment));
+#else
+    static_cast<void>(alignment);
+    ::operator delete(static_cast<void**>(ptr)[-1]);
+#endif
+}
+
+}
+
+/** An allocator which aligns every allocation to \a KAlignment bytes, optionally backing large ones with huge pages.
+ *
+ *  A default-allocated \c std::vector is only aligned to 16 bytes, so a 512-bit group of a
+ *  \c basic_cache_aligned_mixer generally straddles two cache lines and each lookup pays for two misses instead of
+ *  one. Using this allocator for the backing storage (see \c aligned_storage) puts every group on a single line. For
+ *  filters of many gigabytes, TLB misses dominate lookups next; \c page_mode::transparent_huge or
+ *  \c page_mode::explicit_huge reduce those by covering the filter with far fewer pages.
+ *
+ *  \tparam T The type of value to allocate.
+ *  \tparam KAlignment The byte alignment of each allocation. This must be a power of 2 and at least \c alignof(T).
+ *  \tparam KPages How to back allocations of at least one huge page.
+**/
+template <typename T,
+          std::size_t KAlignment = 64,
+          page_mode   KPages     = page_mode::normal
+         >
+class aligned_allocator
+{
+public:
+    using value_type = T;
+    using size_type  = std::size_t;
+
+    static constexpr size_type alignment = KAlignment;
+    static constexpr page_mode pages     = KPages;
+
+    static_assert(KAlignment > 0 && (KAlignment & (KAlignment - 1)) == 0, "KAlignment must be a power of 2");
+    static_assert(KAlignment >= alignof(T), "KAlignment must be at least the alignment of T");
+
+    template <typename U>
+    struct rebind
+    {
+        using other = aligned_allocator<U, KAlignment, KPages>;
+    };
+
+public:
+    aligned_allocator() = default;
+
+    template <typename U>
+    aligned_allocator(const aligned_allocator<U, KAlignment, KPages>&)
+    { }
+
+    T* allocate(size_type count)
+    {
+        if (count > std::numeric_limits<size_type>::max() / sizeof(T))
+            throw std::bad_array_new_length();
+
+        size_type bytes = count * sizeof(T);
+#if defined(__linux__)
+        if (detail::use_huge_pages(KPages, bytes))
+        {
+            if (void* ptr = detail::allocate_huge(KPages, bytes))
+                return static_cast<T*>(ptr);
+            throw std::bad_alloc();
+        }
+#endif
+        return static_cast<T*>(detail::allocate_aligned(bytes, KAlignment));
+    }
+
+    void deallocate(T* ptr, size_type count)
+    {
+        size_type bytes = count * sizeof(T);
+#if defined(__linux__)
+        if (detail::use_huge_pages(KPages, bytes))
+        {
+            detail::deallocate_huge(ptr, bytes);
+            return;
+        }
+#endif
+        detail::deallocate_aligned(ptr, KAlignment);
+    }
+};
+
+template <typename T, typename U, std::size_t KAlignment, page_mode KPages>
+bool operator==(const aligned_allocator<T, KAlignment, KPages>&, const aligned_allocator<U, KAlignment, KPages>&)
+{
+    return true;
+}
+
+template <typename T, typename U, std::size_t KAlignment, page_mode KPages>
+bool operator!=(const aligned_allocator<T, KAlignment, KPages>&, const aligned_allocator<U, KAlignment, KPages>&)
+{
+    return false;
+}
+
+/** \} **/
+
+}
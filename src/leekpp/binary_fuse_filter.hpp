@@ -0,0 +1,499 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "assert.hpp"
+#include "bloom_filter.hpp"
+#include "hash.hpp"
+#include "mixer.hpp"
+#include "storage.hpp"
+
+namespace leekpp
+{
+
+/** \addtogroup Filter
+ *  \{
+**/
+
+/** The layout of a \c basic_binary_fuse_filter: a fingerprint array of \c array_length slots, split into
+ *  <tt>segment_count + 2</tt> segments of \c segment_length slots. Each key maps to three slots in three consecutive
+ *  segments, starting in one of the first \c segment_count.
+**/
+struct binary_fuse_params
+{
+    /** The number of keys the filter was built from, including duplicates. **/
+    std::size_t key_count;
+    std::size_t segment_length;
+    std::size_t segment_count;
+    std::size_t array_length;
+    /** Mixed into the hash of every key. Construction changes this until it finds a seed for which the keys can be
+     *  placed, so a filter built from the same keys always ends up with the same seed.
+    **/
+    std::uint64_t seed;
+
+    binary_fuse_params() = default;
+
+    constexpr binary_fuse_params(std::size_t   key_count,
+                                 std::size_t   segment_length,
+                                 std::size_t   segment_count,
+                                 std::size_t   array_length,
+                                 std::uint64_t seed
+                                ) noexcept :
+            key_count(key_count),
+            segment_length(segment_length),
+            segment_count(segment_count),
+            array_length(array_length),
+            seed(seed)
+    { }
+
+    /** Create the layout for \a key_count keys. For large key counts, this is about 1.125 slots per key.
+     *
+     *  \throws std::invalid_argument if \a key_count is too large for 32-bit slot indices. If this exception is
+     *   actually thrown depends on the \c LEEK_ASSERT settings.
+    **/
+    static binary_fuse_params create(std::size_t key_count)
+    {
+        // The segment length and size factor are the ones from the paper, tuned so construction succeeds on the first
+        // seed almost every time
+        std::size_t segment_length = key_count == 0
+                                   ? 4
+                                   : std::size_t(1) << int(std::floor(std::log(double(key_count)) / std::log(3.33)
+                                                                      + 2.25
+                                                                     ));
+        segment_length = std::min(segment_length, std::size_t(1) << 18);
+
+        double size_factor = key_count <= 1
+                           ? 0.0
+                           : std::max(1.125, 0.875 + 0.25 * std::log(1000000.0) / std::log(double(key_count)));
+        auto capacity      = std::size_t(std::round(double(key_count) * size_factor));
+        auto segments      = (capacity + segment_length - 1) / segment_length;
+        auto segment_count = segments > 3 ? segments - 2 : 1;
+        auto array_length  = (segment_count + 2) * segment_length;
+        LEEK_ASSERT(array_length <= std::numeric_limits<std::uint32_t>::max(),
+                    invalid_argument,
+                    ("A binary fuse filter of %zu keys is too large", key_count)
+                   );
+
+        return binary_fuse_params(key_count, segment_length, segment_count, array_length, 0x726b2b9d438b9d4dULL);
+    }
+};
+
+/** A static filter in the xor filter family: the \e binary \e fuse filter of Graf and Lemire. It is built once from a
+ *  complete set of keys and can not be inserted into afterwards. In exchange, it needs about 1.125 slots of
+ *  \c fingerprint_bits bits per key for an FPR of \f$2^{-fingerprint\_bits}\f$ -- 9 bits per key for 0.39%, where a
+ *  Bloom filter needs 11.5 -- and a lookup is exactly three independent memory accesses, with no data-dependent
+ *  branches.
+ *
+ *  Each key maps to three slots, and construction assigns slots so that the xor of a key's three slots is its
+ *  fingerprint. A lookup computes that xor and compares it:
+ *
+ *  \code
+ *  std::vector<std::string> keys = load_keys();
+ *  leekpp::binary_fuse8_filter<std::string> filter(keys.begin(), keys.end());
+ *  if (filter.count("something"))
+ *      // probably in keys
+ *  \endcode
+ *
+ *  The \c count interface matches \c basic_bloom_filter, so it can stand in for one wherever a filter is only read.
+ *  Since each slot is written exactly once (starting from 0), construction only needs \c set_mask from the storage and
+ *  works with any storage concept, such as \c basic_mapped_storage. Reopen such a filter with the constructor taking
+ *  the same \c binary_fuse_params and its storage.
+ *
+ *  \tparam T The type of value this filter is meant to store.
+ *  \tparam TFingerprint The unsigned integer type of a fingerprint, which sets the FPR. \c std::uint8_t gives 0.39% and
+ *   \c std::uint16_t gives 0.0015%.
+ *  \tparam THash Function to use to transform a \c T into an integer. The result does not need to be well-mixed.
+ *  \tparam TStorage A block-based storage whose blocks are \c TFingerprint (see \c basic_storage).
+ *
+ *  \see https://arxiv.org/abs/2201.01174
+**/
+template <typename T,
+          typename TFingerprint = std::uint8_t,
+          typename THash        = hash<T>,
+          typename TStorage     = basic_storage<TFingerprint>
+         >
+class basic_binary_fuse_filter :
+        private THash
+{
+public:
+    using value_type       = T;
+    using fingerprint_type = TFingerprint;
+    using hash_type        = THash;
+    using storage_type     = TStorage;
+    using block_type       = typename storage_type::block_type;
+    using size_type        = std::size_t;
+
+    /** The number of bits in a fingerprint. **/
+    static constexpr size_type fingerprint_bits = sizeof(fingerprint_type) * 8;
+
+    /** The number of slots each key maps to. **/
+    static constexpr size_type num_hashes = 3;
+
+    static_assert(std::is_unsigned<fingerprint_type>::value, "TFingerprint must be an unsigned integer type");
+    static_assert(std::is_same<block_type, fingerprint_type>::value, "storage_type::block_type must be TFingerprint");
+
+public:
+    /** Build a filter containing every key in the range [\a first, \a last). Duplicate keys are allowed. Each key is
+     *  hashed once; construction then takes about 25 bytes of temporary memory per key.
+     *
+     *  \throws std::runtime_error if no seed was found which places every key. This is astronomically unlikely unless
+     *   \c hash_type maps distinct keys to the same value for a large fraction of them. If this exception is actually
+     *   thrown depends on the \c LEEK_ASSERT settings.
+    **/
+    template <typename TInputIterator>
+    basic_binary_fuse_filter(TInputIterator first, TInputIterator last, const hash_type& hash = hash_type()) :
+            basic_binary_fuse_filter(hash_keys(first, last, hash), hash)
+    { }
+
+    /** Create an instance using an already-built \a storage, such as a \c basic_mapped_storage reopened from a file.
+     *  There is a degree of trust that \a params are the ones the contents of \a storage were built with.
+     *
+     *  \throws std::invalid_argument if \a storage has fewer than \c params.array_length blocks. If this exception is
+     *   actually thrown depends on the \c LEEK_ASSERT settings.
+    **/
+    basic_binary_fuse_filter(const binary_fuse_params& params,
+                             storage_type              storage,
+                             const hash_type&          hash = hash_type()
+                            ) :
+            THash(hash),
+            _params(params),
+            _data(std::move(storage))
+    {
+        LEEK_ASSERT(_data.block_count() >= _params.array_length,
+                    invalid_argument,
+                    ("Storage of %zu blocks cannot hold %zu fingerprints",
+                     size_type(_data.block_count()),
+                     _params.array_length
+                    )
+                   );
+    }
+
+    /** Get the layout used for this filter. **/
+    const binary_fuse_params& params() const
+    {
+        return _params;
+    }
+
+    /** Get the fingerprint array of this filter. **/
+    const storage_type& data() const
+    {
+        return _data;
+    }
+
+    /** \copydoc data **/
+    storage_type& data()
+    {
+        return _data;
+    }
+
+    /** Get the expected false positive rate of this filter. Unlike a Bloom filter, this does not depend on how many
+     *  keys it holds, so \a elements is ignored; it is only there to match \c basic_bloom_filter::expected_fpr.
+    **/
+    double expected_fpr(std::size_t elements = 0) const
+    {
+        static_cast<void>(elements);
+        return std::ldexp(1.0, -int(fingerprint_bits));
+    }
+
+    /** Get the size of the fingerprint array in bits per key this filter was built from. **/
+    double bits_per_key() const
+    {
+        return _params.key_count == 0 ? 0.0 : double(_params.array_length * fingerprint_bits) / _params.key_count;
+    }
+
+    /** Test for the likely presence of \a x in this filter instance.
+     *
+     *  \returns \c 0 if the value is not present in this filter; \c 1 if it looks like the value is present.
+     *  \see basic_bloom_filter::count
+    **/
+    size_type count(const value_type& x) const
+    {
+        return count_mixed(mix(THash::operator()(x)));
+    }
+
+    /** Test for the likely presence of a value equivalent to \a x, without converting \a x to a \c value_type.
+     *
+     *  \see basic_bloom_filter::count(const U&) const
+    **/
+    template <typename U>
+    auto count(const U& x) const
+            -> typename std::enable_if<detail::is_heterogeneous_key<basic_binary_fuse_filter, T, U>::value,
+                                       size_type
+                                      >::type
+    {
+        return count_mixed(mix(THash::operator()(x)));
+    }
+
+    /** Hash \a x ahead of time for \c count_hash.
+     *
+     *  \see basic_split_block_bloom_filter::hash_value
+    **/
+    template <typename U>
+    static hashed_value hash_value(const U& x)
+    {
+        return hashed_value{ std::uint64_t(hash_type()(x)) };
+    }
+
+    /** Test for the likely presence of the value \a hashed was created from. **/
+    size_type count_hash(const hashed_value& hashed) const
+    {
+        return count_mixed(mix(hashed.value));
+    }
+
+private:
+    struct hashed_keys
+    {
+        std::vector<std::uint64_t> values;
+    };
+
+    /** The three slots of a key, with the first two repeated so that \c slots[found + 1] and \c slots[found + 2] are
+     *  the other two slots of the one at \c found.
+    **/
+    struct key_slots
+    {
+        std::uint32_t slots[5];
+    };
+
+    /** The number of seeds to try before giving up on construction. **/
+    static constexpr size_type max_attempts = 100;
+
+    template <typename TInputIterator>
+    static hashed_keys hash_keys(TInputIterator first, TInputIterator last, const hash_type& hash)
+    {
+        hashed_keys out;
+        for ( ; first != last; ++first)
+            out.values.push_back(std::uint64_t(hash(*first)));
+        return out;
+    }
+
+    basic_binary_fuse_filter(hashed_keys keys, const hash_type& hash) :
+            THash(hash),
+            _params(binary_fuse_params::create(keys.values.size())),
+            _data(_params.array_length * fingerprint_bits)
+    {
+        _data.clear();
+        if (!keys.values.empty())
+            populate(std::move(keys.values));
+    }
+
+    std::uint64_t mix(std::uint64_t hash) const
+    {
+        return detail::mix64(hash + _params.seed);
+    }
+
+    static fingerprint_type fingerprint(std::uint64_t mixed)
+    {
+        return fingerprint_type(mixed ^ (mixed >> 32));
+    }
+
+    /** The first slot picks a segment and an offset within it; the other two are in the next two segments, at offsets
+     *  flipped by independent bits of \a mixed.
+    **/
+    key_slots slots_of(std::uint64_t mixed) const
+    {
+        auto mask = std::uint32_t(_params.segment_length - 1);
+        key_slots out;
+        out.slots[0] = std::uint32_t(detail::reduce(mixed, _params.segment_count * _params.segment_length));
+        out.slots[1] = (out.slots[0] + std::uint32_t(_params.segment_length)) ^ (std::uint32_t(mixed >> 18) & mask);
+        out.slots[2] = (out.slots[0] + std::uint32_t(2 * _params.segment_length)) ^ (std::uint32_t(mixed) & mask);
+        out.slots[3] = out.slots[0];
+        out.slots[4] = out.slots[1];
+        return out;
+    }
+
+    size_type count_mixed(std::uint64_t mixed) const
+    {
+        auto slots = slots_of(mixed);
+        auto value = fingerprint_type(fingerprint(mixed)
+                                      ^ _data[slots.slots[0]]
+                                      ^ _data[slots.slots[1]]
+                                      ^ _data[slots.slots[2]]
+                                     );
+        return value == 0 ? 1 : 0;
+    }
+
+    /** Assign every slot with the peeling algorithm. Each slot keeps a count of the keys mapping to it (in the upper 6
+     *  bits of \c slot_counts), the xor of their hashes (in \c slot_hashes) and the xor of which of the three positions
+     *  it is for each of them (in the lower 2 bits). A slot with one key left identifies that key and its position, so
+     *  the key can be removed from its other two slots. Keys are then assigned in the reverse order of their removal,
+     *  each to its identifying slot, which no earlier-assigned key depends on.
+     *
+     *  Keys with the same hash map to the same three slots, so they can never be peeled. Pairs which are alone in a
+     *  slot cancel out and are caught as they are added; any others make the attempt fail, so after the first failure,
+     *  the hashes are deduplicated before trying the next seed.
+    **/
+    void populate(std::vector<std::uint64_t> keys)
+    {
+        size_type size = keys.size();
+        std::vector<std::uint64_t> order(size + 1, 0);
+        std::vector<std::uint8_t>  order_found(size);
+        std::vector<std::uint32_t> alone(_params.array_length);
+        std::vector<std::uint8_t>  slot_counts(_params.array_length, 0);
+        std::vector<std::uint64_t> slot_hashes(_params.array_length, 0);
+
+        // Keys are sorted into buckets by their starting segment first, so that filling the slot tables walks through
+        // memory in order instead of jumping to random cache lines
+        unsigned bucket_bits = 1;
+        while ((size_type(1) << bucket_bits) < _params.segment_count)
+            ++bucket_bits;
+        const size_type bucket_mask = (size_type(1) << bucket_bits) - 1;
+        std::vector<size_type> bucket_next(bucket_mask + 1);
+        order[size] = 1;
+
+        size_type stack_size   = 0;
+        bool      deduplicated = false;
+        for (size_type attempt = 0; ; ++attempt)
+        {
+            LEEK_ASSERT(attempt < max_attempts,
+                        runtime_error,
+                        ("Failed to build a binary fuse filter of %zu keys after %zu seeds", size, attempt)
+                       );
+            if (attempt != 0)
+            {
+                _params.seed = detail::mix64(_params.seed + 0x9e3779b97f4a7c15ULL);
+                std::fill(order.begin(), order.begin() + size, 0);
+                std::fill(slot_counts.begin(), slot_counts.end(), 0);
+                std::fill(slot_hashes.begin(), slot_hashes.end(), 0);
+            }
+
+            for (size_type bucket = 0; bucket <= bucket_mask; ++bucket)
+                bucket_next[bucket] = (bucket * size) >> bucket_bits;
+            for (auto key : keys)
+            {
+                auto mixed  = mix(key);
+                auto bucket = size_type(mixed >> (64 - bucket_bits));
+                while (order[bucket_next[bucket]] != 0)
+                    bucket = (bucket + 1) & bucket_mask;
+                order[bucket_next[bucket]++] = mixed;
+            }
+
+            bool      overflow   = false;
+            size_type duplicates = 0;
+            for (size_type idx = 0; idx < size; ++idx)
+            {
+                auto mixed = order[idx];
+                auto slots = slots_of(mixed);
+                for (std::uint8_t pos = 0; pos < 3; ++pos)
+                    add_to_slot(slot_counts, slot_hashes, slots.slots[pos], pos, mixed);
+
+                // A key identical to one before it cancels out of every slot's hash: back it out and count it
+                if ((slot_hashes[slots.slots[0]] & slot_hashes[slots.slots[1]] & slot_hashes[slots.slots[2]]) == 0
+                    && (   (slot_hashes[slots.slots[0]] == 0 && slot_counts[slots.slots[0]] == 8)
+                        || (slot_hashes[slots.slots[1]] == 0 && slot_counts[slots.slots[1]] == 8)
+                        || (slot_hashes[slots.slots[2]] == 0 && slot_counts[slots.slots[2]] == 8)
+                       )
+                   )
+                {
+                    ++duplicates;
+                    for (std::uint8_t pos = 0; pos < 3; ++pos)
+                        remove_from_slot(slot_counts, slot_hashes, slots.slots[pos], pos, mixed);
+                }
+
+                // The 6-bit count wrapped around, so the slot tables are no longer trustworthy
+                for (std::uint8_t pos = 0; pos < 3; ++pos)
+                    overflow = overflow || slot_counts[slots.slots[pos]] < 4;
+            }
+            if (overflow)
+                continue;
+
+            size_type queue_size = 0;
+            for (size_type slot = 0; slot < _params.array_length; ++slot)
+            {
+                alone[queue_size] = std::uint32_t(slot);
+                queue_size += (slot_counts[slot] >> 2) == 1 ? 1 : 0;
+            }
+
+            stack_size = 0;
+            while (queue_size > 0)
+            {
+                auto slot = alone[--queue_size];
+                if ((slot_counts[slot] >> 2) != 1)
+                    continue;
+
+                auto mixed = slot_hashes[slot];
+                auto found = std::uint8_t(slot_counts[slot] & 3);
+                auto slots = slots_of(mixed);
+                order_found[stack_size] = found;
+                order[stack_size]       = mixed;
+                ++stack_size;
+
+                for (std::uint8_t step = 1; step < 3; ++step)
+                {
+                    auto other = slots.slots[found + step];
+                    alone[queue_size] = other;
+                    queue_size += (slot_counts[other] >> 2) == 2 ? 1 : 0;
+                    remove_from_slot(slot_counts, slot_hashes, other, std::uint8_t((found + step) % 3), mixed);
+                }
+            }
+
+            if (stack_size + duplicates == size)
+                break;
+
+            if (!deduplicated)
+            {
+                std::sort(keys.begin(), keys.end());
+                keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+                size         = keys.size();
+                order[size]  = 1;
+                deduplicated = true;
+            }
+        }
+
+        for (size_type idx = stack_size; idx-- > 0; )
+        {
+            auto mixed = order[idx];
+            auto found = order_found[idx];
+            auto slots = slots_of(mixed);
+            auto value = fingerprint_type(fingerprint(mixed)
+                                          ^ _data[slots.slots[found + 1]]
+                                          ^ _data[slots.slots[found + 2]]
+                                         );
+            _data.set_mask(slots.slots[found], value);
+        }
+    }
+
+    static void add_to_slot(std::vector<std::uint8_t>&  slot_counts,
+                            std::vector<std::uint64_t>& slot_hashes,
+                            std::uint32_t               slot,
+                            std::uint8_t                pos,
+                            std::uint64_t               mixed
+                           )
+    {
+        slot_counts[slot] = std::uint8_t((slot_counts[slot] + 4) ^ pos);
+        slot_hashes[slot] ^= mixed;
+    }
+
+    static void remove_from_slot(std::vector<std::uint8_t>&  slot_counts,
+                                 std::vector<std::uint64_t>& slot_hashes,
+                                 std::uint32_t               slot,
+                                 std::uint8_t                pos,
+                                 std::uint64_t               mixed
+                                )
+    {
+        slot_counts[slot] = std::uint8_t((slot_counts[slot] - 4) ^ pos);
+        slot_hashes[slot] ^= mixed;
+    }
+
+private:
+    binary_fuse_params _params;
+    storage_type       _data;
+};
+
+/** A binary fuse filter with 8-bit fingerprints, for an FPR of 0.39% at about 9 bits per key. **/
+template <typename T>
+using binary_fuse8_filter = basic_binary_fuse_filter<T, std::uint8_t>;
+
+/** A binary fuse filter with 16-bit fingerprints, for an FPR of 0.0015% at about 18 bits per key. **/
+template <typename T>
+using binary_fuse16_filter = basic_binary_fuse_filter<T, std::uint16_t>;
+
+/** \} **/
+
+}
@@ -1,15 +1,329 @@
 #pragma once
 
 #include <cmath>
+#include <cstddef>
+#include <new>
 #include <type_traits>
+#include <utility>
+#include <vector>
 
 #include "assert.hpp"
 #include "mixer.hpp"
+#include "simd.hpp"
+#include "stats.hpp"
 #include "storage.hpp"
 
 namespace leekpp
 {
 
+namespace detail
+{
+
+/** The assumed size of a CPU cache line in bytes. **/
+static constexpr std::size_t cache_line_bytes = 64;
+
+/** The number of values \c basic_bloom_filter::count_many and \c basic_bloom_filter::insert_many hash and prefetch
+ *  ahead of actually touching the bits. This should be large enough to keep a healthy number of memory loads in flight,
+ *  but not so large that the prefetched lines get evicted before they are used.
+**/
+static constexpr std::size_t prefetch_window = 16;
+
+/** Calculate \f$E[f(X)]\f$ where \f$X\f$ is a Poisson-distributed variable with mean \a lambda. Terms further than
+ *  ten standard deviations from the mean are ignored, as they do not contribute anything representable.
+**/
+template <typename FFunction>
+double poisson_expectation(double lambda, FFunction f)
+{
+    // With nothing in the distribution, the log below would be of 0
+    if (lambda <= 0.0)
+        return f(0);
+
+    auto spread = 10.0 * std::sqrt(lambda) + 10.0;
+    auto first  = std::size_t(lambda > spread ? lambda - spread : 0.0);
+    auto last   = std::size_t(lambda + spread);
+    double sum = 0.0;
+    for (auto i = first; i <= last; ++i)
+        sum += std::exp(-lambda + double(i) * std::log(lambda) - std::lgamma(double(i) + 1.0)) * f(i);
+    return sum;
+}
+
+/** Calculate \f$E[f(X)]\f$ where \f$X\f$ is a binomially-distributed variable with \a trials trials which each succeed
+ *  with \a probability. Terms further than ten standard deviations from the mean are ignored.
+**/
+template <typename FFunction>
+double binomial_expectation(std::size_t trials, double probability, FFunction f)
+{
+    if (trials == 0 || probability <= 0.0)
+        return f(0);
+    if (probability >= 1.0)
+        return f(trials);
+
+    auto mean   = double(trials) * probability;
+    auto spread = 10.0 * std::sqrt(mean * (1.0 - probability)) + 10.0;
+    auto first  = std::size_t(mean > spread ? mean - spread : 0.0);
+    auto last   = std::min(trials, std::size_t(mean + spread));
+    auto log_n  = std::lgamma(double(trials) + 1.0);
+    double sum = 0.0;
+    for (auto i = first; i <= last; ++i)
+    {
+        auto log_choose = log_n - std::lgamma(double(i) + 1.0) - std::lgamma(double(trials - i) + 1.0);
+        sum += std::exp(log_choose
+                        + double(i) * std::log(probability)
+                        + double(trials - i) * std::log1p(-probability)
+                       )
+             * f(i);
+    }
+    return sum;
+}
+
+/** Blocks of at most this many bits get an exact FPR model from \c bloom_filter_params::expected_blocked_fpr. Above it,
+ *  the cost of the exact model grows with the block size while its difference from the approximation vanishes.
+**/
+static constexpr std::size_t exact_fpr_block_bits = 64;
+
+/** Calculate the FPR of a single block of \a block_bits bits after 0 through \a max_elements elements have each set
+ *  \a num_hashes bits drawn with replacement, as entry \c i of the result for \c i elements. This tracks the
+ *  distribution of the number of distinct set bits exactly instead of assuming each bit is set independently.
+**/
+inline std::vector<double> block_occupancy_fprs(std::size_t block_bits,
+                                                std::size_t num_hashes,
+                                                std::size_t max_elements
+                                               )
+{
+    // set_odds[x] is the chance that exactly x bits of the block are set
+    std::vector<double> set_odds(block_bits + 1, 0.0);
+    set_odds[0] = 1.0;
+
+    std::vector<double> hit_odds(block_bits + 1);
+    for (std::size_t x = 0; x <= block_bits; ++x)
+        hit_odds[x] = std::pow(double(x) / block_bits, double(num_hashes));
+
+    std::vector<double> out;
+    out.reserve(max_elements + 1);
+    for (std::size_t elements = 0; ; ++elements)
+    {
+        double fpr = 0.0;
+        for (std::size_t x = 0; x <= block_bits; ++x)
+            fpr += set_odds[x] * hit_odds[x];
+        out.push_back(fpr);
+        if (elements == max_elements)
+            return out;
+
+        for (std::size_t draw = 0; draw < num_hashes; ++draw)
+        {
+            for (std::size_t x = block_bits; x > 0; --x)
+                set_odds[x] = (set_odds[x] * x + set_odds[x - 1] * (block_bits - x + 1)) / block_bits;
+            set_odds[0] = 0.0;
+        }
+    }
+}
+
+/** OR the blocks [\a first, \a last) of \a src into \a dst as a single vectorized pass over contiguous memory. **/
+template <typename TDestStorage, typename TSourceStorage>
+typename std::enable_if<has_contiguous_data<TDestStorage>::value && has_contiguous_data<TSourceStorage>::value>::type
+union_blocks(TDestStorage& dst, const TSourceStorage& src, std::size_t first, std::size_t last)
+{
+    or_bytes(dst.data() + first, src.data() + first, (last - first) * sizeof(typename TDestStorage::block_type));
+}
+
+/** OR the blocks [\a first, \a last) of \a src into \a dst one block at a time through \c set_mask. With thread-safe
+ *  storage, this is an atomic \c fetch_or per block, so it is safe to do on a live filter without any lock.
+**/
+template <typename TDestStorage, typename TSourceStorage>
+typename std::enable_if<!(has_contiguous_data<TDestStorage>::value
+                          && has_contiguous_data<TSourceStorage>::value
+                         )
+                       >::type
+union_blocks(TDestStorage& dst, const TSourceStorage& src, std::size_t first, std::size_t last)
+{
+    for (auto block_idx = first; block_idx < last; ++block_idx)
+    {
+        typename TDestStorage::block_type mask = src[block_idx];
+        if (mask != 0)
+            dst.set_mask(block_idx, mask);
+    }
+}
+
+/** AND the blocks [\a first, \a last) of \a src into \a dst as a single vectorized pass over contiguous memory. **/
+template <typename TDestStorage, typename TSourceStorage>
+typename std::enable_if<has_contiguous_data<TDestStorage>::value && has_contiguous_data<TSourceStorage>::value>::type
+intersect_blocks(TDestStorage& dst, const TSourceStorage& src, std::size_t first, std::size_t last)
+{
+    and_bytes(dst.data() + first, src.data() + first, (last - first) * sizeof(typename TDestStorage::block_type));
+}
+
+/** AND the blocks [\a first, \a last) of \a src into \a dst one block at a time through \c and_mask. **/
+template <typename TDestStorage, typename TSourceStorage>
+typename std::enable_if<!(has_contiguous_data<TDestStorage>::value
+                          && has_contiguous_data<TSourceStorage>::value
+                         )
+                       >::type
+intersect_blocks(TDestStorage& dst, const TSourceStorage& src, std::size_t first, std::size_t last)
+{
+    for (auto block_idx = first; block_idx < last; ++block_idx)
+        dst.and_mask(block_idx, src[block_idx]);
+}
+
+/** OR the \a count blocks of \a src starting at \a first into the start of \a dst as a single vectorized pass. **/
+template <typename TDestStorage, typename TSourceStorage>
+typename std::enable_if<has_contiguous_data<TDestStorage>::value && has_contiguous_data<TSourceStorage>::value>::type
+fold_blocks(TDestStorage& dst, const TSourceStorage& src, std::size_t first, std::size_t count)
+{
+    or_bytes(dst.data(), src.data() + first, count * sizeof(typename TDestStorage::block_type));
+}
+
+/** OR the \a count blocks of \a src starting at \a first into the start of \a dst through \c set_mask. **/
+template <typename TDestStorage, typename TSourceStorage>
+typename std::enable_if<!(has_contiguous_data<TDestStorage>::value
+                          && has_contiguous_data<TSourceStorage>::value
+                         )
+                       >::type
+fold_blocks(TDestStorage& dst, const TSourceStorage& src, std::size_t first, std::size_t count)
+{
+    for (std::size_t block_idx = 0; block_idx < count; ++block_idx)
+    {
+        typename TDestStorage::block_type mask = src[first + block_idx];
+        if (mask != 0)
+            dst.set_mask(block_idx, mask);
+    }
+}
+
+/** Can a \c U be given to a filter of \c T using \c TMixer directly? This excludes \c T itself, so the non-template
+ *  overloads are used for it.
+**/
+template <typename TMixer, typename T, typename U>
+struct is_heterogeneous_key :
+        std::integral_constant<bool, has_transparent_hash<TMixer>::value && !std::is_same<T, U>::value>
+{ };
+
+/** Does \c TStorage keep a running count of its set bits (see \c basic_counted_storage)? **/
+template <typename TStorage>
+class has_set_bit_count
+{
+    template <typename UStorage>
+    static auto check(const UStorage* storage) -> decltype(std::size_t(storage->set_bit_count()), std::true_type());
+
+    static std::false_type check(...);
+
+public:
+    static constexpr bool value = decltype(check(static_cast<const TStorage*>(nullptr)))::value;
+};
+
+/** Count the bits in \a storage which are set to 1 with a vectorized pass over the contiguous block array. **/
+template <typename TStorage>
+typename std::enable_if<has_contiguous_data<TStorage>::value, std::size_t>::type
+count_set_bits(const TStorage& storage)
+{
+    return popcount_bytes(storage.data(), storage.block_count() * sizeof(typename TStorage::block_type));
+}
+
+/** Count the bits in \a storage which are set to 1, one block at a time. **/
+template <typename TStorage>
+typename std::enable_if<!has_contiguous_data<TStorage>::value, std::size_t>::type
+count_set_bits(const TStorage& storage)
+{
+    std::size_t count = 0;
+    for (std::size_t block_idx = 0; block_idx < storage.block_count(); ++block_idx)
+        count += popcount(std::uint64_t(storage[block_idx]));
+    return count;
+}
+
+/** Count the set bits of \a lhs, \a rhs and their union in one vectorized pass over both block arrays. **/
+template <typename TStorageA, typename TStorageB>
+typename std::enable_if<has_contiguous_data<TStorageA>::value && has_contiguous_data<TStorageB>::value,
+                        popcount_pair
+                       >::type
+count_set_bit_pair(const TStorageA& lhs, const TStorageB& rhs)
+{
+    return popcount_pair_bytes(lhs.data(), rhs.data(), lhs.block_count() * sizeof(typename TStorageA::block_type));
+}
+
+/** Count the set bits of \a lhs, \a rhs and their union in one pass, one block at a time. **/
+template <typename TStorageA, typename TStorageB>
+typename std::enable_if<!(has_contiguous_data<TStorageA>::value && has_contiguous_data<TStorageB>::value),
+                        popcount_pair
+                       >::type
+count_set_bit_pair(const TStorageA& lhs, const TStorageB& rhs)
+{
+    popcount_pair out = { 0, 0, 0 };
+    for (std::size_t block_idx = 0; block_idx < lhs.block_count(); ++block_idx)
+    {
+        auto a = std::uint64_t(lhs[block_idx]);
+        auto b = std::uint64_t(rhs[block_idx]);
+        out.first  += popcount(a);
+        out.second += popcount(b);
+        out.either += popcount(a | b);
+    }
+    return out;
+}
+
+/** Get the number of set bits of \a storage from its running count. **/
+template <typename TStorage>
+typename std::enable_if<has_set_bit_count<TStorage>::value, std::size_t>::type
+set_bits_of(const TStorage& storage)
+{
+    return storage.set_bit_count();
+}
+
+/** Get the number of set bits of \a storage by counting them. **/
+template <typename TStorage>
+typename std::enable_if<!has_set_bit_count<TStorage>::value, std::size_t>::type
+set_bits_of(const TStorage& storage)
+{
+    return count_set_bits(storage);
+}
+
+/** Fixed-capacity storage for up to \c KCapacity mixers, since mixers are not default-constructible. **/
+template <typename TMixer, std::size_t KCapacity>
+class mixer_window
+{
+public:
+    mixer_window() = default;
+    mixer_window(const mixer_window&) = delete;
+    mixer_window& operator=(const mixer_window&) = delete;
+
+    ~mixer_window()
+    {
+        clear();
+    }
+
+    std::size_t size() const
+    {
+        return _size;
+    }
+
+    bool full() const
+    {
+        return _size == KCapacity;
+    }
+
+    template <typename... TArgs>
+    TMixer& emplace_back(TArgs&&... args)
+    {
+        auto ptr = new (&_mixers[_size]) TMixer(std::forward<TArgs>(args)...);
+        ++_size;
+        return *ptr;
+    }
+
+    TMixer& operator[](std::size_t idx)
+    {
+        return *reinterpret_cast<TMixer*>(&_mixers[idx]);
+    }
+
+    void clear()
+    {
+        for (std::size_t idx = 0; idx < _size; ++idx)
+            (*this)[idx].~TMixer();
+        _size = 0;
+    }
+
+private:
+    typename std::aligned_storage<sizeof(TMixer), alignof(TMixer)>::type _mixers[KCapacity];
+    std::size_t                                                          _size = 0;
+};
+
+}
+
 /** \addtogroup Filter
  *  \{
 **/
@@ -48,6 +362,40 @@ struct bloom_filter_params
         return std::pow(1.0 - inner, num_hashes);
     }
 
+    /** Calculate the expected false positive rate if the number of \a elements were put into a Bloom filter with these
+     *  parameters where all \f$k\f$ bits of each element are placed in a single group of \a block_bits bits, as is done
+     *  by blocking mixers like \c basic_cache_aligned_mixer. Since some groups receive more elements than others, this
+     *  is always a bit worse than \c expected_fpr and gets worse as \a block_bits shrinks. With \f$B\f$ as the block
+     *  size, the number of elements in a block is Poisson-distributed with \f$\lambda = \frac{Bn}{m}\f$, so:
+     *
+     *  \f[ p = \sum_{i=0}^{\infty} \frac{e^{-\lambda} \lambda^i}{i!}
+     *          \left[1 - \left(1 - \frac{1}{B}\right)^{ki}\right]^k \f]
+     *
+     *  This treats the bits of a block as set independently, which underestimates the FPR of very small blocks, where
+     *  the bits an element sets compete for the same few positions. Blocks of up to 64 bits (such as those of
+     *  \c basic_register_blocked_mixer) use an exact model instead: the number of elements in a block is binomial, and
+     *  the FPR for each count comes from the exact distribution of the number of set bits.
+     *
+     *  \see https://algo2.iti.kit.edu/documents/cacheefficientbloomfilters-jea.pdf
+    **/
+    double expected_blocked_fpr(std::size_t elements, std::size_t block_bits) const
+    {
+        if (block_bits <= detail::exact_fpr_block_bits)
+        {
+            auto probability = std::min(1.0, double(block_bits) / bit_count);
+            auto mean        = double(elements) * probability;
+            auto last        = std::min(elements, std::size_t(mean + 10.0 * std::sqrt(mean) + 10.0));
+            auto fprs        = detail::block_occupancy_fprs(block_bits, num_hashes, last);
+            return detail::binomial_expectation(elements, probability, [&] (std::size_t i) { return fprs[i]; });
+        }
+
+        auto k = double(num_hashes);
+        auto per_bit = std::log(1.0 - 1.0 / block_bits);
+        return detail::poisson_expectation(double(block_bits) * elements / bit_count,
+                                           [&] (std::size_t i) { return std::pow(1.0 - std::exp(per_bit * k * i), k); }
+                                          );
+    }
+
     /** Estimate the number of elements in a filter.
      *
      *  \f[ n' = -\frac{m}{k} \ln\left(1 - \frac{X}{m}\right) \f]
@@ -59,6 +407,15 @@ struct bloom_filter_params
         return -double(bit_count) / num_hashes * std::log(1.0 - double(set_bits) / bit_count);
     }
 
+    /** Get the parameters of a filter with these parameters after it is folded by \a factor (see
+     *  \c basic_bloom_filter::fold). The FPR of the folded filter is \c expected_fpr of the result: folding by 2 holds
+     *  the same values in half the bits, so the FPR is about what these parameters would have with twice the values.
+    **/
+    constexpr bloom_filter_params folded(std::size_t factor) const
+    {
+        return bloom_filter_params(bit_count / factor, num_hashes);
+    }
+
     /** Create an "ideally sized" Bloom filter for the desired parameters. "Ideal" here means the output \c bit_count
      *  (\f$m\f$) yields a Bloom filter with an FPR close to \c desired_fpr (\f$p\f$) for the \c expected_elements
      *  (\f$n\f$) with a \c num_hashes (\f$k\f$) which minimizes the FPR.
@@ -97,19 +454,24 @@ struct bloom_filter_params
  *  \tparam TMixer A mixing function -- must meet the requirements of a Mixer (see \c basic_mixer).
  *  \tparam TStorage A block-based container to store the elements -- must meet the requirements of a Storage (see
  *   \c basic_storage).
+ *  \tparam TStats A statistics policy which counts inserts and lookups (see \c sharded_stats). The default
+ *   \c no_stats costs nothing.
  *
  *  \see https://en.wikipedia.org/wiki/Bloom_filter
 **/
 template <typename T,
           typename TMixer   = basic_mixer<T>,
-          typename TStorage = basic_storage<>
+          typename TStorage = basic_storage<>,
+          typename TStats   = no_stats
          >
-class basic_bloom_filter
+class basic_bloom_filter :
+        private TStats
 {
 public:
     using value_type   = T;
     using mixer_type   = TMixer;
     using storage_type = TStorage;
+    using stats_type   = TStats;
     using block_type   = typename storage_type::block_type;
     using size_type    = std::size_t;
     
@@ -123,11 +485,12 @@ public:
     }
 
     /** Creates a \c basic_bloom_filter from the parameters created with \c bloom_filter_params::create_ideal, rounding
-     *  up the bit count to \c mixer_type::block_bits.
+     *  up the bit count to \c mixer_type::block_bits (and to a size the mixer supports, if it has \c round_bit_count).
     **/
     static basic_bloom_filter create_ideal(double desired_fpr, std::size_t expected_elements)
     {
         auto params = bloom_filter_params::create_ideal(desired_fpr, expected_elements);
+        params.bit_count = detail::round_bit_count<mixer_type>(params.bit_count);
         if (mixer_type::block_bits > 0 && params.bit_count % mixer_type::block_bits != 0)
             params.bit_count += mixer_type::block_bits - (params.bit_count % mixer_type::block_bits);
         return basic_bloom_filter(params);
@@ -143,11 +506,11 @@ public:
             _data(std::move(storage)),
             _params(params)
     {
-        LEEK_ASSERT(params.bit_count <= storage.bit_count(),
+        LEEK_ASSERT(params.bit_count <= _data.bit_count(),
                     invalid_argument,
                     ("Parameters cannot fit into storage -- params.bit_count=%zd storage.bit_count=%zd",
                      params.bit_count,
-                     storage.bit_count()
+                     _data.bit_count()
                     )
                    );
     }
@@ -164,6 +527,55 @@ public:
         return _data;
     }
 
+    /** Get the contents of this Bloom filter for storage-specific operations (such as \c basic_mapped_storage::sync).
+     *  Clearing bits through this will introduce false negatives.
+    **/
+    storage_type& data()
+    {
+        return _data;
+    }
+
+    /** Calculate the expected false positive rate of this filter if \a elements distinct values were inserted.
+     *
+     *  \see bloom_filter_params::expected_fpr
+     *  \see bloom_filter_params::expected_blocked_fpr
+    **/
+    double expected_fpr(std::size_t elements) const
+    {
+        return mixer_type::block_bits == 0 ? _params.expected_fpr(elements)
+                                           : _params.expected_blocked_fpr(elements, mixer_type::block_bits);
+    }
+
+    /** Get the number of bits in this filter which are set to 1. This is constant-time when \c storage_type keeps a
+     *  running count (see \c basic_counted_storage); otherwise, it is a vectorized pass over the storage.
+    **/
+    size_type set_bits() const
+    {
+        return detail::set_bits_of(_data);
+    }
+
+    /** Estimate the number of distinct values which have been inserted into this filter from how many of its bits are
+     *  set.
+     *
+     *  \see bloom_filter_params::estimated_count
+    **/
+    size_type estimated_size() const
+    {
+        return _params.estimated_count(set_bits());
+    }
+
+    /** Estimate the false positive rate of this filter as it is now, as opposed to \c expected_fpr, which predicts it
+     *  for a number of values. Without blocking, a value which was never inserted tests positively when each of the
+     *  \f$k\f$ bits it probes is set, so with \f$X\f$ of the \f$m\f$ bits set, this is \f$(X/m)^k\f$. With a
+     *  blocking mixer, the fill varies from block to block, so this is \c expected_fpr of \c estimated_size.
+    **/
+    double estimated_fpr_now() const
+    {
+        if (mixer_type::block_bits > 0)
+            return expected_fpr(estimated_size());
+        return fill_fpr(set_bits());
+    }
+
     /** Test for the likely presence of \a x in this filter instance. Keep in mind that a Bloom filter might erroneously
      *  test positively for presence when \a x was never inserted due to false positives. However, this function will
      *  \e never return \c 0 for a value that was actually inserted (no false negatives).
@@ -173,7 +585,7 @@ public:
     size_type count(const value_type& x) const
     {
         mixer_type mixer(x, _data.bit_count());
-        return count_impl(mixer);
+        return record_query(count_impl(mixer));
     }
 
     /** Insert the value \a x into this filter. Inserting the same value multiple times has no effect. **/
@@ -181,15 +593,394 @@ public:
     {
         mixer_type mixer(x, _data.bit_count());
         insert_impl(mixer);
+        this->record_inserts(1);
+    }
+
+    /** Test for the likely presence of a value equivalent to \a x, without converting \a x to a \c value_type. This is
+     *  only available when the mixer's \c hash_type is transparent, like the \c leekpp::hash of strings, so a filter of
+     *  \c std::string can be queried with a \c std::string_view or <tt>const char*</tt> without allocating.
+     *
+     *  \see count
+    **/
+    template <typename U>
+    auto count(const U& x) const
+            -> typename std::enable_if<detail::is_heterogeneous_key<mixer_type, value_type, U>::value, size_type>::type
+    {
+        mixer_type mixer(x, _data.bit_count());
+        return record_query(count_impl(mixer));
+    }
+
+    /** Insert a value equivalent to \a x, without converting \a x to a \c value_type.
+     *
+     *  \see count(const U&) const
+    **/
+    template <typename U>
+    auto insert(const U& x)
+            -> typename std::enable_if<detail::is_heterogeneous_key<mixer_type, value_type, U>::value>::type
+    {
+        mixer_type mixer(x, _data.bit_count());
+        insert_impl(mixer);
+        this->record_inserts(1);
     }
 
-    /** Reset the contents of this filter to nothing. **/
+    /** Hash \a x ahead of time for \c count_hash and \c insert_hash. The result can be used with any filter whose mixer
+     *  has the same \c hash_type, so a value which is checked against many filters only needs to be hashed once.
+    **/
+    template <typename U>
+    static hashed_value hash_value(const U& x)
+    {
+        return hashed_value{ std::uint64_t(typename mixer_type::hash_type()(x)) };
+    }
+
+    /** Test for the likely presence of the value \a hashed was created from. Indices are derived from \a hashed for
+     *  the size of this filter, so this gives the same result as \c count.
+     *
+     *  \see hash_value
+    **/
+    size_type count_hash(const hashed_value& hashed) const
+    {
+        mixer_type mixer(hashed, _data.bit_count());
+        return record_query(count_impl(mixer));
+    }
+
+    /** Insert the value \a hashed was created from.
+     *
+     *  \see hash_value
+    **/
+    void insert_hash(const hashed_value& hashed)
+    {
+        mixer_type mixer(hashed, _data.bit_count());
+        insert_impl(mixer);
+        this->record_inserts(1);
+    }
+
+    /** Create the mixer for \a hashed at the size of this filter. Creating a mixer does some of the work of a lookup --
+     *  for blocking mixers like \c basic_cache_aligned_mixer, it selects the block -- so when checking a value against
+     *  many filters which have the same \c bit_count, create the probe once and pass copies to \c count_probe.
+    **/
+    mixer_type probe(const hashed_value& hashed) const
+    {
+        return mixer_type(hashed, _data.bit_count());
+    }
+
+    /** Test for the likely presence of the value a \a probe was created for. The \a probe must come from \c probe on
+     *  a filter with the same \c bit_count as this one, or the result is meaningless.
+    **/
+    size_type count_probe(mixer_type probe) const
+    {
+        return record_query(count_impl(probe));
+    }
+
+    /** Remove the value \a x from this filter. This is only available when \c storage_type keeps a count for each bit
+     *  (such as \c counting_storage), so the bits shared with other values stay set. Only erase values which were
+     *  actually inserted -- erasing a value which was not (even one which tests positively) can cause false negatives
+     *  for other values.
+    **/
+    template <typename UStorage = storage_type>
+    auto erase(const value_type& x)
+            -> decltype(std::declval<UStorage&>().clear_mask(size_type(0), block_type(0)), void())
+    {
+        mixer_type mixer(x, _data.bit_count());
+        erase_impl(mixer);
+    }
+
+    /** Call \a apply with <tt>(block_idx, mask)</tt> for each storage block which inserting \a x would modify, where
+     *  \c mask has the bits of the block which would be set. Nothing is modified; this is the building block for
+     *  inserting through something other than \c insert, such as a \c write_combining_buffer.
+    **/
+    template <typename FApply>
+    void visit_masks(const value_type& x, FApply apply) const
+    {
+        mixer_type mixer(x, _data.bit_count());
+        for_each_mask(mixer, apply);
+    }
+
+    /** Test each value in the range [\a first, \a last) for likely presence in this filter, writing the result of
+     *  \c count for each value to \a out.
+     *
+     *  This gives the same results as calling \c count in a loop, but it is much faster when the filter is larger than
+     *  your CPU cache. Values are hashed a window at a time and the blocks they map to are prefetched before any bits
+     *  are tested, so the memory loads for an entire window are in flight at once instead of one after another.
+     *
+     *  \returns \a out, advanced past the last written result.
+    **/
+    template <typename TInputIterator, typename TOutputIterator>
+    TOutputIterator count_many(TInputIterator first, TInputIterator last, TOutputIterator out) const
+    {
+        detail::mixer_window<mixer_type, detail::prefetch_window> window;
+        while (first != last)
+        {
+            for ( ; first != last && !window.full(); ++first)
+                prefetch_impl(window.emplace_back(*first, _data.bit_count()));
+
+            size_type positives = 0;
+            for (std::size_t idx = 0; idx < window.size(); ++idx, ++out)
+            {
+                auto result = count_impl(window[idx]);
+                positives += result;
+                *out = result;
+            }
+            this->record_queries(window.size(), positives);
+            window.clear();
+        }
+        return out;
+    }
+
+    /** Insert each value in the range [\a first, \a last) into this filter. This has the same effect as calling
+     *  \c insert in a loop, but hides memory latency in the same manner as \c count_many.
+    **/
+    template <typename TInputIterator>
+    void insert_many(TInputIterator first, TInputIterator last)
+    {
+        detail::mixer_window<mixer_type, detail::prefetch_window> window;
+        while (first != last)
+        {
+            for ( ; first != last && !window.full(); ++first)
+                prefetch_impl(window.emplace_back(*first, _data.bit_count()));
+
+            for (std::size_t idx = 0; idx < window.size(); ++idx)
+                insert_impl(window[idx]);
+            this->record_inserts(window.size());
+            window.clear();
+        }
+    }
+
+    /** Add everything in \a other to this filter, so this filter tests positively for everything either filter did.
+     *  The result is identical to a filter which had the contents of both inserted into it.
+     *
+     *  When both storages are contiguous, this is a single vectorized pass over the block array. Otherwise, blocks are
+     *  merged one at a time through \c set_mask; with \c thread_safe_storage as this filter's storage, that makes it
+     *  safe to merge into a filter which is being concurrently queried and inserted into.
+     *
+     *  \throws std::invalid_argument if \a other does not have the same parameters. If this exception is actually
+     *   thrown depends on the \c LEEK_ASSERT settings.
+    **/
+    template <typename UStorage, typename UStats>
+    basic_bloom_filter& union_with(const basic_bloom_filter<T, TMixer, UStorage, UStats>& other)
+    {
+        assert_compatible(other);
+        detail::union_blocks(_data, other.data(), 0, _data.block_count());
+        return *this;
+    }
+
+    /** Remove everything not in \a other from this filter. Unlike \c union_with, the result is \e not the same as a
+     *  filter with only the values in both sets inserted into it: the FPR of the result is at least as high, since bits
+     *  set by different values in each filter can survive.
+     *
+     *  \throws std::invalid_argument if \a other does not have the same parameters. If this exception is actually
+     *   thrown depends on the \c LEEK_ASSERT settings.
+    **/
+    template <typename UStorage, typename UStats>
+    basic_bloom_filter& intersect_with(const basic_bloom_filter<T, TMixer, UStorage, UStats>& other)
+    {
+        assert_compatible(other);
+        detail::intersect_blocks(_data, other.data(), 0, _data.block_count());
+        return *this;
+    }
+
+    /** Estimate the number of distinct values in the union of this filter and \a other from the bits set in either of
+     *  them. Nothing is modified and no temporary filter is built: the bits of both are counted in a single pass.
+     *
+     *  \throws std::invalid_argument if \a other does not have the same parameters. If this exception is actually
+     *   thrown depends on the \c LEEK_ASSERT settings.
+     *  \see https://doi.org/10.1021/ci600526a
+    **/
+    template <typename UStorage, typename UStats>
+    size_type estimated_union_size(const basic_bloom_filter<T, TMixer, UStorage, UStats>& other) const
+    {
+        assert_compatible(other);
+        return _params.estimated_count(detail::count_set_bit_pair(_data, other.data()).either);
+    }
+
+    /** Estimate the number of distinct values in both this filter and \a other as
+     *  \f$|A| + |B| - |A \cup B|\f$, with each term from \c bloom_filter_params::estimated_count. This is far more
+     *  accurate than \c estimated_size of the result of \c intersect_with, whose bits include those set by different
+     *  values in each filter.
+     *
+     *  \see estimated_union_size
+    **/
+    template <typename UStorage, typename UStats>
+    size_type estimated_intersection_size(const basic_bloom_filter<T, TMixer, UStorage, UStats>& other) const
+    {
+        assert_compatible(other);
+        return estimated_intersection(detail::count_set_bit_pair(_data, other.data()));
+    }
+
+    /** Estimate the Jaccard similarity \f$\frac{|A \cap B|}{|A \cup B|}\f$ of the sets in this filter and \a other,
+     *  which is \c 0 when both are empty.
+     *
+     *  \see estimated_union_size
+    **/
+    template <typename UStorage, typename UStats>
+    double jaccard_similarity(const basic_bloom_filter<T, TMixer, UStorage, UStats>& other) const
+    {
+        assert_compatible(other);
+        auto counts = detail::count_set_bit_pair(_data, other.data());
+        auto united = _params.estimated_count(counts.either);
+        return united == 0 ? 0.0 : double(estimated_intersection(counts)) / united;
+    }
+
+    /** Check that \a other has the same parameters and bit count as this filter, so their blocks can be combined. Since
+     *  the mixer is part of the type, it is guaranteed to match.
+     *
+     *  \throws std::invalid_argument if the filters are not compatible. If this exception is actually thrown depends on
+     *   the \c LEEK_ASSERT settings.
+    **/
+    template <typename UStorage, typename UStats>
+    void assert_compatible(const basic_bloom_filter<T, TMixer, UStorage, UStats>& other) const
+    {
+        static_assert(std::is_same<block_type, typename UStorage::block_type>::value,
+                      "Cannot combine filters with different block types"
+                     );
+        LEEK_ASSERT(_params.bit_count == other.params().bit_count
+                 && _params.num_hashes == other.params().num_hashes
+                 && _data.bit_count() == other.data().bit_count(),
+                    invalid_argument,
+                    ("Cannot combine filters with different parameters -- bit_count=%zu/%zu num_hashes=%zu/%zu",
+                     _params.bit_count,
+                     other.params().bit_count,
+                     _params.num_hashes,
+                     other.params().num_hashes
+                    )
+                   );
+    }
+
+    /** Reset the contents of this filter to nothing. The statistics are kept; see \c reset_stats. **/
     void clear()
     {
         _data.clear();
     }
 
+    /** Create a filter with \f$m / f\f$ bits which tests positively for everything this one does, by ORing the
+     *  \a factor equal slices of the block array together. This is for shipping a filter which was sized for the worst
+     *  case to somewhere which can live with a higher FPR; the new FPR is that of \c bloom_filter_params::folded.
+     *
+     *  Only mixers whose indices stay valid at the smaller size can be folded (see \c is_foldable_mixer). With a
+     *  blocking mixer, each slice is a whole number of blocks, so the blocks of the result stay aligned.
+     *
+     *  \throws std::invalid_argument if \a factor is not a power of 2 or the folded bit count is not a whole number of
+     *   storage blocks and mixer blocks. If this exception is actually thrown depends on the \c LEEK_ASSERT settings.
+    **/
+    basic_bloom_filter fold(size_type factor) const
+    {
+        static_assert(is_foldable_mixer<mixer_type>::value, "This mixer's indices do not survive folding");
+
+        constexpr size_type block_type_bits = sizeof(block_type) * 8;
+        constexpr size_type alignment_bits  = mixer_type::block_bits > block_type_bits ? mixer_type::block_bits
+                                                                                       : block_type_bits;
+        auto folded_bits = _data.bit_count() / (factor == 0 ? 1 : factor);
+        LEEK_ASSERT(factor != 0 && (factor & (factor - 1)) == 0,
+                    invalid_argument,
+                    ("The fold factor %zu is not a power of 2", factor)
+                   );
+        LEEK_ASSERT(_data.bit_count() % factor == 0 && folded_bits % alignment_bits == 0,
+                    invalid_argument,
+                    ("Cannot fold %zu bits by %zu into whole blocks of %zu bits",
+                     _data.bit_count(),
+                     factor,
+                     alignment_bits
+                    )
+                   );
+
+        basic_bloom_filter out(_params.folded(factor));
+        auto slice_blocks = folded_bits / block_type_bits;
+        for (size_type slice = 0; slice < factor; ++slice)
+            detail::fold_blocks(out._data, _data, slice * slice_blocks, slice_blocks);
+        return out;
+    }
+
+    /** Get the statistics policy of this filter. **/
+    const stats_type& stats() const
+    {
+        return *this;
+    }
+
+    /** Set the operation counters of the statistics policy back to 0. **/
+    void reset_stats()
+    {
+        stats_type::reset_counters();
+    }
+
+    /** Count \a count inserts which were written to the storage through something other than this filter's insert
+     *  functions, such as the masks of \c visit_masks (see \c insert_parallel and \c write_combining_buffer).
+    **/
+    void record_inserts(size_type count) const
+    {
+        stats_type::record_inserts(count);
+    }
+
+    /** Take a snapshot of the operation counters and the fill of this filter, for exporting to a metrics system. This
+     *  never blocks writers. The counters are a few relaxed loads; counting the set bits is a vectorized pass over the
+     *  storage, or constant-time with a storage which keeps a running count (see \c basic_counted_storage).
+    **/
+    filter_stats snapshot() const
+    {
+        filter_stats out;
+        out.counters       = stats_type::counters();
+        out.set_bits       = set_bits();
+        out.estimated_size = _params.estimated_count(out.set_bits);
+        out.expected_fpr   = expected_fpr(out.estimated_size);
+        out.estimated_fpr  = mixer_type::block_bits == 0 ? fill_fpr(out.set_bits) : out.expected_fpr;
+        return out;
+    }
+
 private:
+    size_type record_query(size_type result) const
+    {
+        this->record_queries(1, result);
+        return result;
+    }
+
+    /** The FPR of a non-blocked filter with \a set_bits bits set, which is \f$(X/m)^k\f$. **/
+    double fill_fpr(size_type set_bits) const
+    {
+        return std::pow(double(set_bits) / _params.bit_count, double(_params.num_hashes));
+    }
+
+    size_type estimated_intersection(const detail::popcount_pair& counts) const
+    {
+        auto both   = _params.estimated_count(counts.first) + _params.estimated_count(counts.second);
+        auto united = _params.estimated_count(counts.either);
+        return both > united ? both - united : 0;
+    }
+
+    /** Non-blocking mixers can jump anywhere in storage, so prefetch each of the blocks they will touch. Generating the
+     *  sequence is done on a copy, so \a mixer is left untouched for the real operation.
+    **/
+    template <typename UMixer>
+    typename std::enable_if<UMixer::block_bits == 0, void>::type
+    prefetch_impl(const UMixer& mixer) const
+    {
+        UMixer lookahead(mixer);
+        for (std::size_t count = 0; count < _params.num_hashes; ++count)
+            _data.prefetch(lookahead() / (8 * sizeof(block_type)));
+    }
+
+    /** Blocking mixers only touch the group starting at \c base_offset, so prefetch each cache line in that group. **/
+    template <typename UMixer>
+    typename std::enable_if<(UMixer::block_bits > 0), void>::type
+    prefetch_impl(const UMixer& mixer) const
+    {
+        constexpr std::size_t group_bytes  = UMixer::block_bits / 8;
+        constexpr std::size_t stride_bytes = group_bytes < detail::cache_line_bytes ? group_bytes
+                                                                                   : detail::cache_line_bytes;
+        std::size_t base_block_offset = mixer.base_offset() / (sizeof(block_type) * 8);
+        for (std::size_t offset = 0; offset < group_bytes; offset += stride_bytes)
+            _data.prefetch(base_block_offset + offset / sizeof(block_type));
+    }
+
+    template <typename UMixer>
+    void insert_impl(UMixer& mixer)
+    {
+        for_each_mask(mixer, [this] (size_type block_idx, block_type mask) { _data.set_mask(block_idx, mask); });
+    }
+
+    template <typename UMixer>
+    void erase_impl(UMixer& mixer)
+    {
+        for_each_mask(mixer, [this] (size_type block_idx, block_type mask) { _data.clear_mask(block_idx, mask); });
+    }
+
     template <typename UMixer>
     typename std::enable_if<UMixer::block_bits == 0, size_type>::type
     count_impl(UMixer& mixer) const
@@ -205,21 +996,21 @@ private:
         return 1;
     }
 
-    template <typename UMixer>
+    template <typename UMixer, typename FApply>
     typename std::enable_if<UMixer::block_bits == 0, void>::type
-    insert_impl(UMixer& mixer)
+    for_each_mask(UMixer& mixer, FApply apply) const
     {
         for (std::size_t count = 0; count < _params.num_hashes; ++count)
         {
             auto bit_idx = mixer();
             auto block_idx = bit_idx / (8 * sizeof(block_type));
             auto block_bit = bit_idx % (8 * sizeof(block_type));
-            _data.set_mask(block_idx, block_type(1) << block_bit);
+            apply(block_idx, block_type(1) << block_bit);
         }
     }
 
     template <typename UMixer>
-    typename std::enable_if<(UMixer::block_bits > 0), size_type>::type
+    typename std::enable_if<(UMixer::block_bits > 0 && !detail::has_block_mask<UMixer>::value), size_type>::type
     count_impl(UMixer& mixer) const
     {
         static_assert(UMixer::block_bits / (sizeof(block_type) * 8),
@@ -250,9 +1041,9 @@ private:
         return 1;
     }
 
-    template <typename UMixer>
-    typename std::enable_if<(UMixer::block_bits > 0), void>::type
-    insert_impl(UMixer& mixer)
+    template <typename UMixer, typename FApply>
+    typename std::enable_if<(UMixer::block_bits > 0 && !detail::has_block_mask<UMixer>::value), void>::type
+    for_each_mask(UMixer& mixer, FApply apply) const
     {
         static_assert(UMixer::block_bits / (sizeof(block_type) * 8),
                       "storage_type::block_type not compatible with mixer_type bit alignment"
@@ -277,7 +1068,33 @@ private:
 
         for (std::size_t idx = 0; idx < storage_blocks_in_mixer_block; ++idx)
             if (blocks[idx] != block_type(0))
-                _data.set_mask(base_block_offset + idx, blocks[idx]);
+                apply(base_block_offset + idx, blocks[idx]);
+    }
+
+    /** Mixers with a \c block_mask put every bit in a single storage block, so no bookkeeping of which blocks are
+     *  loaded is needed.
+    **/
+    template <typename UMixer>
+    typename std::enable_if<detail::has_block_mask<UMixer>::value, size_type>::type
+    count_impl(UMixer& mixer) const
+    {
+        static_assert(UMixer::block_bits == sizeof(block_type) * 8,
+                      "storage_type::block_type must be exactly mixer_type::block_bits wide"
+                     );
+        auto block_idx = mixer.base_offset() / (sizeof(block_type) * 8);
+        auto mask = block_type(mixer.block_mask(_params.num_hashes));
+        return (_data[block_idx] & mask) == mask ? 1 : 0;
+    }
+
+    template <typename UMixer, typename FApply>
+    typename std::enable_if<detail::has_block_mask<UMixer>::value, void>::type
+    for_each_mask(UMixer& mixer, FApply apply) const
+    {
+        static_assert(UMixer::block_bits == sizeof(block_type) * 8,
+                      "storage_type::block_type must be exactly mixer_type::block_bits wide"
+                     );
+        auto block_idx = mixer.base_offset() / (sizeof(block_type) * 8);
+        apply(block_idx, block_type(mixer.block_mask(_params.num_hashes)));
     }
 
 private:
@@ -285,15 +1102,68 @@ private:
     bloom_filter_params _params;
 };
 
+/** Create a filter containing everything in either \a a or \a b.
+ *
+ *  \see basic_bloom_filter::union_with
+**/
+template <typename T, typename TMixer, typename TStorage, typename TStats>
+basic_bloom_filter<T, TMixer, TStorage, TStats> operator|(basic_bloom_filter<T, TMixer, TStorage, TStats>        a,
+                                                          const basic_bloom_filter<T, TMixer, TStorage, TStats>& b
+                                                         )
+{
+    a.union_with(b);
+    return a;
+}
+
+/** Create a filter containing only what is in both \a a and \a b.
+ *
+ *  \see basic_bloom_filter::intersect_with
+**/
+template <typename T, typename TMixer, typename TStorage, typename TStats>
+basic_bloom_filter<T, TMixer, TStorage, TStats> operator&(basic_bloom_filter<T, TMixer, TStorage, TStats>        a,
+                                                          const basic_bloom_filter<T, TMixer, TStorage, TStats>& b
+                                                         )
+{
+    a.intersect_with(b);
+    return a;
+}
+
 template <typename T>
 using bloom_filter = basic_bloom_filter<T>;
 
 template <typename T>
-using cache_aligned_bloom_filter = basic_bloom_filter<T, basic_cache_aligned_mixer<T>>;
+using cache_aligned_bloom_filter = basic_bloom_filter<T, basic_cache_aligned_mixer<T>, aligned_storage>;
+
+template <typename T>
+using double_hash_bloom_filter = basic_bloom_filter<T, basic_double_hash_mixer<T>>;
+
+template <typename T>
+using cache_aligned_double_hash_bloom_filter = basic_bloom_filter<T,
+                                                                  basic_cache_aligned_double_hash_mixer<T>,
+                                                                  aligned_storage
+                                                                 >;
+
+template <typename T>
+using register_blocked_bloom_filter = basic_bloom_filter<T,
+                                                         basic_register_blocked_mixer<T>,
+                                                         basic_storage<std::uint64_t>
+                                                        >;
 
 template <typename T, typename TMixer = basic_mixer<T>>
 using thread_safe_bloom_filter = basic_bloom_filter<T, TMixer, thread_safe_storage>;
 
+template <typename T, typename TMixer = basic_mixer<T>>
+using contention_aware_bloom_filter = basic_bloom_filter<T, TMixer, contention_aware_storage>;
+
+template <typename T, typename TMixer = basic_mixer<T>>
+using counted_bloom_filter = basic_bloom_filter<T, TMixer, counted_storage>;
+
+template <typename T>
+using foldable_bloom_filter = basic_bloom_filter<T, basic_foldable_mixer<T>>;
+
+template <typename T, typename TMixer = basic_mixer<T>>
+using cow_bloom_filter = basic_bloom_filter<T, TMixer, cow_storage>;
+
 /** \} **/
 
 }
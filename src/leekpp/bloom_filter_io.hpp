@@ -2,7 +2,10 @@
 
 #include <ostream>
 
+#include "binary_fuse_filter.hpp"
 #include "bloom_filter.hpp"
+#include "cuckoo_filter.hpp"
+#include "split_block_bloom_filter.hpp"
 
 namespace leekpp
 {
@@ -18,9 +21,9 @@ operator<<(std::basic_ostream<TChar, TCharTraits>& os, const bloom_filter_params
     return os << "(m=" << params.bit_count << ", k=" << params.num_hashes << ')';
 }
 
-template <typename TChar, typename TCharTraits, typename T, typename TMixer, typename TStorage>
+template <typename TChar, typename TCharTraits, typename T, typename TMixer, typename TStorage, typename TStats>
 std::basic_ostream<TChar, TCharTraits>&
-operator<<(std::basic_ostream<TChar, TCharTraits>& os, const basic_bloom_filter<T, TMixer, TStorage>& value)
+operator<<(std::basic_ostream<TChar, TCharTraits>& os, const basic_bloom_filter<T, TMixer, TStorage, TStats>& value)
 {
     os << "{params=" << value.params();
     os << " data="   << value.data();
@@ -28,6 +31,62 @@ operator<<(std::basic_ostream<TChar, TCharTraits>& os, const basic_bloom_filter<
     return os;
 }
 
+template <typename TChar, typename TCharTraits, typename T, typename THash, typename TStorage>
+std::basic_ostream<TChar, TCharTraits>&
+operator<<(std::basic_ostream<TChar, TCharTraits>& os, const basic_split_block_bloom_filter<T, THash, TStorage>& value)
+{
+    os << "{params=" << value.params();
+    os << " data="   << value.data();
+    os << '}';
+    return os;
+}
+
+template <typename TChar, typename TCharTraits>
+std::basic_ostream<TChar, TCharTraits>&
+operator<<(std::basic_ostream<TChar, TCharTraits>& os, const binary_fuse_params& params)
+{
+    return os << "(n=" << params.key_count
+              << ", segments=" << params.segment_count << 'x' << params.segment_length
+              << ", seed=" << params.seed
+              << ')';
+}
+
+template <typename TChar,
+          typename TCharTraits,
+          typename T,
+          typename TFingerprint,
+          typename THash,
+          typename TStorage
+         >
+std::basic_ostream<TChar, TCharTraits>&
+operator<<(std::basic_ostream<TChar, TCharTraits>& os,
+           const basic_binary_fuse_filter<T, TFingerprint, THash, TStorage>& value
+          )
+{
+    os << "{params=" << value.params();
+    os << " data="   << value.data();
+    os << '}';
+    return os;
+}
+
+template <typename TChar, typename TCharTraits>
+std::basic_ostream<TChar, TCharTraits>&
+operator<<(std::basic_ostream<TChar, TCharTraits>& os, const cuckoo_filter_params& params)
+{
+    return os << "(buckets=" << params.bucket_count << ", f=" << params.fingerprint_bits << ')';
+}
+
+template <typename TChar, typename TCharTraits, typename T, typename THash, typename TStorage>
+std::basic_ostream<TChar, TCharTraits>&
+operator<<(std::basic_ostream<TChar, TCharTraits>& os, const basic_cuckoo_filter<T, THash, TStorage>& value)
+{
+    os << "{params=" << value.params();
+    os << " size="   << value.size();
+    os << " data="   << value.data();
+    os << '}';
+    return os;
+}
+
 /** \} **/
 
 }
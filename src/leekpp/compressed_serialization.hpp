@@ -0,0 +1,650 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "bloom_filter.hpp"
+#include "serialization.hpp"
+#include "simd.hpp"
+
+namespace leekpp
+{
+
+/** \addtogroup Serialization
+ *  \{
+ *
+ *  ### Compressed format
+ *
+ *  A filter sized for its peak load is mostly zeros until it gets there, and the plain format still spends a full block
+ *  on each of them. The compressed format (\c save_compressed and \c load_compressed) uses the same 64-byte header,
+ *  with the magic bytes `LEEKBLMZ` and the checksum still computed over the header and the decoded block array. The
+ *  payload is split into chunks of 32768 bits (4 KiB) -- the last chunk can be shorter -- and each chunk is stored with
+ *  whichever \c chunk_encoding is smallest for it:
+ *
+ *  | Field   | Size     | Notes                                                                            |
+ *  |:--------|:---------|:---------------------------------------------------------------------------------|
+ *  | Tag     | 1        | The \c chunk_encoding                                                            |
+ *  | Length  | 1 to 10  | Size of the payload in bytes (LEB128)                                            |
+ *  | Payload | Length   | The encoded chunk, which is never larger than its raw blocks                     |
+ *
+ *  Since every encoding is chosen by exact size, nothing is lost against the plain format besides 2 or 3 bytes per
+ *  chunk. Below about 30% fill, a chunk's set bits are cheaper to list than to store as a bitmap: the payload is about
+ *  a tenth of the plain size at 1% fill, a third at 5%, a half at 10% and a few bytes per chunk when empty.
+**/
+
+/** How a chunk of the compressed format is encoded. Multi-byte values are in native byte order, like the blocks. **/
+enum class chunk_encoding : std::uint8_t
+{
+    /** The blocks of the chunk, as in the plain format. **/
+    raw = 0,
+    /** Alternating LEB128 counts of all-zero blocks and of literal blocks, each count of literal blocks followed by the
+     *  blocks themselves, until the chunk is covered. This is the smallest for chunks with long stretches of zeros.
+    **/
+    run_length = 1,
+    /** A LEB128 count of set bits followed by the position of each within the chunk as a 16-bit integer. **/
+    sparse = 2,
+    /** A LEB128 count \c n of set bits followed by their positions with Elias-Fano coding: for a chunk of \c u bits,
+     *  the low <tt>l = floor(log2(u / n))</tt> bits of each position are packed into <tt>n * l</tt> bits, then the
+     *  high bits are stored in unary as a bitmap of <tt>n + (u >> l) + 1</tt> bits, where position \c i sets bit
+     *  <tt>(p >> l) + i</tt>. Both bit strings are padded to whole bytes and packed into 64-bit words starting at
+     *  their least significant bit. This takes at most <tt>2 + log2(u / n)</tt> bits per set bit.
+    **/
+    elias_fano = 3,
+};
+
+namespace detail
+{
+
+static constexpr char        serialized_compressed_magic[8] = { 'L', 'E', 'E', 'K', 'B', 'L', 'M', 'Z' };
+static constexpr std::size_t compressed_chunk_bits          = std::size_t(1) << 15;
+
+inline void put_varint(std::vector<unsigned char>& out, std::uint64_t value)
+{
+    for ( ; value >= 0x80; value >>= 7)
+        out.push_back(static_cast<unsigned char>(value | 0x80));
+    out.push_back(static_cast<unsigned char>(value));
+}
+
+inline std::size_t varint_size(std::uint64_t value)
+{
+    std::size_t out = 1;
+    for ( ; value >= 0x80; value >>= 7)
+        ++out;
+    return out;
+}
+
+inline unsigned floor_log2(std::uint64_t x)
+{
+    unsigned out = 0;
+    while (x >>= 1)
+        ++out;
+    return out;
+}
+
+/** Reads the payload of a single chunk, which was already copied to memory. **/
+class payload_reader
+{
+public:
+    payload_reader(const unsigned char* data, std::size_t size) :
+            _position(data),
+            _end(data + size)
+    { }
+
+    std::size_t remaining() const
+    {
+        return std::size_t(_end - _position);
+    }
+
+    const unsigned char* take(std::size_t size)
+    {
+        if (size > remaining())
+            throw serialization_error("Compressed chunk is truncated");
+        auto out = _position;
+        _position += size;
+        return out;
+    }
+
+    std::uint64_t varint()
+    {
+        std::uint64_t out = 0;
+        for (unsigned shift = 0; shift < 64; shift += 7)
+        {
+            auto byte = *take(1);
+            out |= std::uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                return out;
+        }
+        throw serialization_error("Compressed chunk has a malformed length");
+    }
+
+private:
+    const unsigned char* _position;
+    const unsigned char* _end;
+};
+
+/** Load the 64-bit word \a idx of a bit string of \a size bytes, where the last word can be partial. **/
+inline std::uint64_t load_bit_word(const unsigned char* bits, std::size_t size, std::size_t idx)
+{
+    std::uint64_t out = 0;
+    auto offset = idx * sizeof out;
+    if (offset < size)
+        std::memcpy(&out, bits + offset, size - offset < sizeof out ? size - offset : sizeof out);
+    return out;
+}
+
+/** Append the words of a bit string of \a bit_count bits to \a out, truncating the last word to whole bytes. **/
+inline void put_bit_words(std::vector<unsigned char>&       out,
+                          const std::vector<std::uint64_t>& words,
+                          std::size_t                       bit_count
+                         )
+{
+    auto byte_count = (bit_count + 7) / 8;
+    auto start      = out.size();
+    out.resize(start + byte_count);
+    for (std::size_t idx = 0; idx * 8 < byte_count; ++idx)
+        std::memcpy(out.data() + start + idx * 8, &words[idx], byte_count - idx * 8 < 8 ? byte_count - idx * 8 : 8);
+}
+
+/** Encodes and decodes chunks of \c compressed_chunk_bits bits for blocks of type \c TBlock. **/
+template <typename TBlock>
+class chunk_codec
+{
+public:
+    using block_type = TBlock;
+    using word_type  = typename std::make_unsigned<TBlock>::type;
+
+    static constexpr std::size_t block_bits   = sizeof(block_type) * 8;
+    static constexpr std::size_t chunk_blocks = compressed_chunk_bits / block_bits;
+
+    static_assert(compressed_chunk_bits % block_bits == 0, "Blocks must evenly divide a chunk");
+
+public:
+    /** Encode the \a count blocks at \a blocks (at most \c chunk_blocks) into \a out, which is overwritten.
+     *
+     *  \returns The encoding which was used.
+    **/
+    static chunk_encoding encode(const block_type* blocks, std::size_t count, std::vector<unsigned char>& out)
+    {
+        std::size_t bit_count       = count * block_bits;
+        std::size_t set_count       = 0;
+        std::size_t run_length_size = 0;
+        for (std::size_t idx = 0; idx < count; )
+        {
+            auto zeros_begin = idx;
+            while (idx < count && blocks[idx] == 0)
+                ++idx;
+            auto literals_begin = idx;
+            for ( ; idx < count && blocks[idx] != 0; ++idx)
+                set_count += popcount(word_type(blocks[idx]));
+            run_length_size += varint_size(literals_begin - zeros_begin)
+                             + varint_size(idx - literals_begin)
+                             + (idx - literals_begin) * sizeof(block_type);
+        }
+
+        auto low_bits = elias_fano_low_bits(set_count, bit_count);
+        std::size_t sizes[] =
+        {
+            count * sizeof(block_type),
+            run_length_size,
+            varint_size(set_count) + set_count * sizeof(std::uint16_t),
+            varint_size(set_count) + elias_fano_size(set_count, bit_count, low_bits),
+        };
+        std::size_t best = 0;
+        for (std::size_t idx = 1; idx < sizeof sizes / sizeof sizes[0]; ++idx)
+            if (sizes[idx] < sizes[best])
+                best = idx;
+
+        out.clear();
+        out.reserve(sizes[best]);
+        switch (chunk_encoding(best))
+        {
+        case chunk_encoding::raw:
+            out.resize(sizes[best]);
+            std::memcpy(out.data(), blocks, sizes[best]);
+            break;
+        case chunk_encoding::run_length:
+            encode_run_length(blocks, count, out);
+            break;
+        case chunk_encoding::sparse:
+            put_varint(out, set_count);
+            for_each_set_bit(blocks,
+                             count,
+                             [&] (std::size_t position)
+                             {
+                                 auto value = std::uint16_t(position);
+                                 unsigned char bytes[sizeof value];
+                                 std::memcpy(bytes, &value, sizeof value);
+                                 out.insert(out.end(), bytes, bytes + sizeof value);
+                             }
+                            );
+            break;
+        case chunk_encoding::elias_fano:
+            put_varint(out, set_count);
+            encode_elias_fano(blocks, count, set_count, low_bits, out);
+            break;
+        }
+        return chunk_encoding(best);
+    }
+
+    /** Decode a chunk of \a count blocks from the \a size bytes at \a payload into \a blocks, which are overwritten.
+     *
+     *  \throws serialization_error if the payload is malformed.
+    **/
+    static void decode(chunk_encoding       encoding,
+                       const unsigned char* payload,
+                       std::size_t          size,
+                       block_type*          blocks,
+                       std::size_t          count
+                      )
+    {
+        payload_reader reader(payload, size);
+        if (encoding == chunk_encoding::raw)
+        {
+            std::memcpy(blocks, reader.take(count * sizeof(block_type)), count * sizeof(block_type));
+        }
+        else
+        {
+            std::memset(blocks, 0, count * sizeof(block_type));
+            switch (encoding)
+            {
+            case chunk_encoding::run_length:
+                decode_run_length(reader, blocks, count);
+                break;
+            case chunk_encoding::sparse:
+                decode_sparse(reader, blocks, count);
+                break;
+            case chunk_encoding::elias_fano:
+                decode_elias_fano(reader, blocks, count);
+                break;
+            default:
+                throw serialization_error("Unknown chunk encoding " + std::to_string(int(encoding)));
+            }
+        }
+        if (reader.remaining() != 0)
+            throw serialization_error("Compressed chunk has trailing bytes");
+    }
+
+private:
+    static unsigned elias_fano_low_bits(std::size_t set_count, std::size_t bit_count)
+    {
+        return set_count == 0 ? 0 : floor_log2(bit_count / set_count);
+    }
+
+    static std::size_t elias_fano_size(std::size_t set_count, std::size_t bit_count, unsigned low_bits)
+    {
+        return (set_count * low_bits + 7) / 8 + (set_count + (bit_count >> low_bits) + 1 + 7) / 8;
+    }
+
+    template <typename FVisit>
+    static void for_each_set_bit(const block_type* blocks, std::size_t count, FVisit visit)
+    {
+        for (std::size_t idx = 0; idx < count; ++idx)
+        {
+            for (std::uint64_t word = word_type(blocks[idx]); word != 0; word &= word - 1)
+                visit(idx * block_bits + count_trailing_zeros(word));
+        }
+    }
+
+    static void set_bit(block_type* blocks, std::size_t position)
+    {
+        blocks[position / block_bits] |= block_type(word_type(1) << (position % block_bits));
+    }
+
+    static void encode_run_length(const block_type* blocks, std::size_t count, std::vector<unsigned char>& out)
+    {
+        for (std::size_t idx = 0; idx < count; )
+        {
+            auto zeros_begin = idx;
+            while (idx < count && blocks[idx] == 0)
+                ++idx;
+            auto literals_begin = idx;
+            while (idx < count && blocks[idx] != 0)
+                ++idx;
+            put_varint(out, literals_begin - zeros_begin);
+            put_varint(out, idx - literals_begin);
+            auto bytes = reinterpret_cast<const unsigned char*>(blocks + literals_begin);
+            out.insert(out.end(), bytes, bytes + (idx - literals_begin) * sizeof(block_type));
+        }
+    }
+
+    static void decode_run_length(payload_reader& reader, block_type* blocks, std::size_t count)
+    {
+        for (std::size_t idx = 0; idx < count; )
+        {
+            auto zeros    = reader.varint();
+            auto literals = reader.varint();
+            if (zeros > count - idx || literals > count - idx - zeros || zeros + literals == 0)
+                throw serialization_error("Compressed chunk has an invalid run length");
+            idx += zeros;
+            std::memcpy(blocks + idx, reader.take(literals * sizeof(block_type)), literals * sizeof(block_type));
+            idx += literals;
+        }
+    }
+
+    static void decode_sparse(payload_reader& reader, block_type* blocks, std::size_t count)
+    {
+        auto set_count = reader.varint();
+        if (set_count > count * block_bits)
+            throw serialization_error("Compressed chunk has too many set bits");
+        auto positions = reader.take(set_count * sizeof(std::uint16_t));
+        for (std::size_t idx = 0; idx < set_count; ++idx)
+        {
+            std::uint16_t position;
+            std::memcpy(&position, positions + idx * sizeof position, sizeof position);
+            if (position >= count * block_bits)
+                throw serialization_error("Compressed chunk has a bit out of range");
+            set_bit(blocks, position);
+        }
+    }
+
+    static void encode_elias_fano(const block_type*           blocks,
+                                  std::size_t                 count,
+                                  std::size_t                 set_count,
+                                  unsigned                    low_bits,
+                                  std::vector<unsigned char>& out
+                                 )
+    {
+        auto high_bit_count = set_count + ((count * block_bits) >> low_bits) + 1;
+        std::vector<std::uint64_t> low((set_count * low_bits + 63) / 64 + 1, 0);
+        std::vector<std::uint64_t> high((high_bit_count + 63) / 64, 0);
+
+        std::size_t idx = 0;
+        for_each_set_bit(blocks,
+                         count,
+                         [&] (std::size_t position)
+                         {
+                             auto low_value  = std::uint64_t(position) & ((std::uint64_t(1) << low_bits) - 1);
+                             auto low_offset = idx * low_bits;
+                             low[low_offset / 64] |= low_value << (low_offset % 64);
+                             if (low_offset % 64 + low_bits > 64)
+                                 low[low_offset / 64 + 1] |= low_value >> (64 - low_offset % 64);
+
+                             auto high_offset = (position >> low_bits) + idx;
+                             high[high_offset / 64] |= std::uint64_t(1) << (high_offset % 64);
+                             ++idx;
+                         }
+                        );
+        put_bit_words(out, low, set_count * low_bits);
+        put_bit_words(out, high, high_bit_count);
+    }
+
+    static void decode_elias_fano(payload_reader& reader, block_type* blocks, std::size_t count)
+    {
+        auto bit_count = count * block_bits;
+        auto set_count = reader.varint();
+        if (set_count > bit_count)
+            throw serialization_error("Compressed chunk has too many set bits");
+
+        auto low_bits  = elias_fano_low_bits(set_count, bit_count);
+        auto low_mask  = (std::uint64_t(1) << low_bits) - 1;
+        auto low_size  = (set_count * low_bits + 7) / 8;
+        auto high_size = (set_count + (bit_count >> low_bits) + 1 + 7) / 8;
+        auto low       = reader.take(low_size);
+        auto high      = reader.take(high_size);
+
+        std::size_t idx = 0;
+        for (std::size_t word_idx = 0; word_idx * 8 < high_size; ++word_idx)
+        {
+            for (auto word = load_bit_word(high, high_size, word_idx); word != 0; word &= word - 1)
+            {
+                auto high_offset = word_idx * 64 + count_trailing_zeros(word);
+                if (idx == set_count || high_offset < idx)
+                    throw serialization_error("Compressed chunk has a malformed Elias-Fano bitmap");
+
+                auto low_offset = idx * low_bits;
+                auto low_value  = load_bit_word(low, low_size, low_offset / 64) >> (low_offset % 64);
+                if (low_offset % 64 + low_bits > 64)
+                    low_value |= load_bit_word(low, low_size, low_offset / 64 + 1) << (64 - low_offset % 64);
+
+                auto position = ((high_offset - idx) << low_bits) | (low_value & low_mask);
+                if (position >= bit_count)
+                    throw serialization_error("Compressed chunk has a bit out of range");
+                set_bit(blocks, position);
+                ++idx;
+            }
+        }
+        if (idx != set_count)
+            throw serialization_error("Compressed chunk has a malformed Elias-Fano bitmap");
+    }
+};
+
+template <typename TStorage, typename FVisit>
+typename std::enable_if<has_contiguous_data<TStorage>::value>::type
+for_each_compressed_chunk(const TStorage& storage, FVisit visit)
+{
+    constexpr auto chunk_blocks = chunk_codec<typename TStorage::block_type>::chunk_blocks;
+    for (std::size_t first = 0; first < storage.block_count(); first += chunk_blocks)
+    {
+        std::size_t count = storage.block_count() - first;
+        visit(storage.data() + first, count < chunk_blocks ? count : chunk_blocks);
+    }
+}
+
+template <typename TStorage, typename FVisit>
+typename std::enable_if<!has_contiguous_data<TStorage>::value>::type
+for_each_compressed_chunk(const TStorage& storage, FVisit visit)
+{
+    constexpr auto chunk_blocks = chunk_codec<typename TStorage::block_type>::chunk_blocks;
+    typename TStorage::block_type buffer[chunk_blocks];
+    for (std::size_t first = 0; first < storage.block_count(); first += chunk_blocks)
+    {
+        std::size_t count = 0;
+        for ( ; count < chunk_blocks && first + count < storage.block_count(); ++count)
+            buffer[count] = storage[first + count];
+        visit(buffer, count);
+    }
+}
+
+/** Decode straight into the block array of a contiguous \a storage. **/
+template <typename TStorage>
+typename std::enable_if<has_contiguous_data<TStorage>::value>::type
+store_decoded_chunk(TStorage&                         storage,
+                    std::size_t                       first,
+                    std::size_t                       count,
+                    chunk_encoding                    encoding,
+                    const std::vector<unsigned char>& payload
+                   )
+{
+    using codec_type = chunk_codec<typename TStorage::block_type>;
+    codec_type::decode(encoding, payload.data(), payload.size(), storage.data() + first, count);
+}
+
+template <typename TStorage>
+typename std::enable_if<!has_contiguous_data<TStorage>::value>::type
+store_decoded_chunk(TStorage&                         storage,
+                    std::size_t                       first,
+                    std::size_t                       count,
+                    chunk_encoding                    encoding,
+                    const std::vector<unsigned char>& payload
+                   )
+{
+    using codec_type = chunk_codec<typename TStorage::block_type>;
+    typename TStorage::block_type buffer[codec_type::chunk_blocks];
+    codec_type::decode(encoding, payload.data(), payload.size(), buffer, count);
+    for (std::size_t idx = 0; idx < count; ++idx)
+        storage.set_mask(first + idx, buffer[idx]);
+}
+
+/** Counts the bytes written to it without storing them. **/
+class counting_sink
+{
+public:
+    void write(const void*, std::size_t size)
+    {
+        _size += size;
+    }
+
+    std::size_t size() const
+    {
+        return _size;
+    }
+
+private:
+    std::size_t _size = 0;
+};
+
+template <typename TSink, typename TBloomFilter>
+std::size_t save_compressed_to(TSink& sink, const TBloomFilter& filter)
+{
+    using block_type = typename TBloomFilter::block_type;
+
+    auto header = make_header(filter, serialized_compressed_magic);
+    sink.write(&header, sizeof header);
+    std::size_t size = sizeof header;
+
+    std::vector<unsigned char> lead;
+    std::vector<unsigned char> payload;
+    for_each_compressed_chunk(filter.data(),
+                              [&] (const block_type* blocks, std::size_t count)
+                              {
+                                  auto encoding = chunk_codec<block_type>::encode(blocks, count, payload);
+                                  lead.assign(1, static_cast<unsigned char>(encoding));
+                                  put_varint(lead, payload.size());
+                                  sink.write(lead.data(), lead.size());
+                                  sink.write(payload.data(), payload.size());
+                                  size += lead.size() + payload.size();
+                              }
+                             );
+    return size;
+}
+
+template <typename TBloomFilter, typename TSource>
+TBloomFilter load_compressed_from(TSource& source)
+{
+    using codec_type = chunk_codec<typename TBloomFilter::block_type>;
+
+    serialized_header header;
+    source.read(&header, sizeof header);
+    validate_header<TBloomFilter>(header, serialized_compressed_magic);
+    // Every chunk takes at least a tag and a length byte, however well it compresses
+    auto chunk_count = (header.block_count + codec_type::chunk_blocks - 1) / codec_type::chunk_blocks;
+    check_remaining(source, 2 * chunk_count);
+
+    TBloomFilter filter(bloom_filter_params(header.bit_count, header.num_hashes));
+    std::vector<unsigned char> payload;
+    for (std::size_t first = 0; first < filter.data().block_count(); first += codec_type::chunk_blocks)
+    {
+        std::size_t count = filter.data().block_count() - first;
+        count = count < codec_type::chunk_blocks ? count : codec_type::chunk_blocks;
+
+        unsigned char tag;
+        source.read(&tag, 1);
+        std::uint64_t size = 0;
+        for (unsigned shift = 0; ; shift += 7)
+        {
+            unsigned char byte;
+            source.read(&byte, 1);
+            if (shift >= 64)
+                throw serialization_error("Compressed chunk has a malformed length");
+            size |= std::uint64_t(byte & 0x7f) << shift;
+            if (!(byte & 0x80))
+                break;
+        }
+        // An encoding is only chosen when it is no larger than the raw blocks
+        if (size > count * sizeof(typename TBloomFilter::block_type))
+            throw serialization_error("Compressed chunk is larger than its blocks");
+
+        payload.resize(std::size_t(size));
+        source.read(payload.data(), payload.size());
+        store_decoded_chunk(filter.data(), first, count, chunk_encoding(tag), payload);
+    }
+
+    if (checksum_filter(header, filter.data()) != header.checksum)
+        throw serialization_error("Filter checksum does not match its contents");
+    return filter;
+}
+
+}
+
+/** Get the number of bytes \c save_compressed will write for \a filter. This encodes the whole filter, so it costs
+ *  about as much as saving it.
+**/
+template <typename T, typename TMixer, typename TStorage, typename TStats>
+std::size_t compressed_size(const basic_bloom_filter<T, TMixer, TStorage, TStats>& filter)
+{
+    detail::counting_sink sink;
+    return detail::save_compressed_to(sink, filter);
+}
+
+/** Write \a filter to the stream \a os in the compressed format.
+ *
+ *  \throws serialization_error if the stream fails.
+**/
+template <typename T, typename TMixer, typename TStorage, typename TStats>
+void save_compressed(std::ostream& os, const basic_bloom_filter<T, TMixer, TStorage, TStats>& filter)
+{
+    detail::stream_sink sink(os);
+    detail::save_compressed_to(sink, filter);
+}
+
+/** Write \a filter to the file descriptor \a fd at its current position in the compressed format.
+ *
+ *  \throws std::system_error if writing fails.
+**/
+template <typename T, typename TMixer, typename TStorage, typename TStats>
+void save_compressed(int fd, const basic_bloom_filter<T, TMixer, TStorage, TStats>& filter)
+{
+    detail::fd_sink sink(fd);
+    detail::save_compressed_to(sink, filter);
+}
+
+/** Write \a filter to the \a buffer of \a size bytes in the compressed format. Use \c compressed_size to find how
+ *  large \a buffer needs to be.
+ *
+ *  \returns The number of bytes written.
+ *  \throws serialization_error if \a size is too small.
+**/
+template <typename T, typename TMixer, typename TStorage, typename TStats>
+std::size_t save_compressed(void*                                                  buffer,
+                            std::size_t                                            size,
+                            const basic_bloom_filter<T, TMixer, TStorage, TStats>& filter
+                           )
+{
+    detail::buffer_sink sink(buffer, size);
+    return detail::save_compressed_to(sink, filter);
+}
+
+/** Read a filter of type \c TBloomFilter in the compressed format from the stream \a is.
+ *
+ *  \throws serialization_error under the same conditions as \c load, or if a chunk is malformed.
+**/
+template <typename TBloomFilter>
+TBloomFilter load_compressed(std::istream& is)
+{
+    detail::stream_source source(is);
+    return detail::load_compressed_from<TBloomFilter>(source);
+}
+
+/** Read a filter of type \c TBloomFilter in the compressed format from the file descriptor \a fd at its current
+ *  position.
+ *
+ *  \throws serialization_error under the same conditions as loading from a stream.
+ *  \throws std::system_error if reading fails.
+**/
+template <typename TBloomFilter>
+TBloomFilter load_compressed(int fd)
+{
+    detail::fd_source source(fd);
+    return detail::load_compressed_from<TBloomFilter>(source);
+}
+
+/** Read a filter of type \c TBloomFilter in the compressed format from the \a buffer of \a size bytes.
+ *
+ *  \throws serialization_error under the same conditions as loading from a stream.
+**/
+template <typename TBloomFilter>
+TBloomFilter load_compressed(const void* buffer, std::size_t size)
+{
+    detail::buffer_source source(buffer, size);
+    return detail::load_compressed_from<TBloomFilter>(source);
+}
+
+/** \} **/
+
+}
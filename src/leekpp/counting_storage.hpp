@@ -0,0 +1,311 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "bloom_filter.hpp"
+#include "storage.hpp"
+
+namespace leekpp
+{
+
+namespace detail
+{
+
+/** Each counter is a nibble, so a 64-bit word holds 16 of them. **/
+static constexpr std::uint64_t nibble_low_bits = 0x1111111111111111ULL;
+
+/** Move bit \c i of the 16-bit \a mask to bit \c 4i, so that each set bit becomes a 1 in its own nibble. **/
+inline std::uint64_t spread_nibbles(std::uint64_t mask)
+{
+    mask &= 0xffffULL;
+    mask = (mask | (mask << 24)) & 0x000000ff000000ffULL;
+    mask = (mask | (mask << 12)) & 0x000f000f000f000fULL;
+    mask = (mask | (mask <<  6)) & 0x0303030303030303ULL;
+    mask = (mask | (mask <<  3)) & nibble_low_bits;
+    return mask;
+}
+
+/** The inverse of \c spread_nibbles: move bit \c 4i of \a spread to bit \c i. **/
+inline std::uint64_t gather_nibbles(std::uint64_t spread)
+{
+    spread &= nibble_low_bits;
+    spread = (spread | (spread >>  3)) & 0x0303030303030303ULL;
+    spread = (spread | (spread >>  6)) & 0x000f000f000f000fULL;
+    spread = (spread | (spread >> 12)) & 0x000000ff000000ffULL;
+    spread = (spread | (spread >> 24)) & 0xffffULL;
+    return spread;
+}
+
+/** Get a 1 in the low bit of each nibble of \a word which is not zero. **/
+inline std::uint64_t nonzero_nibbles(std::uint64_t word)
+{
+    return (word | (word >> 1) | (word >> 2) | (word >> 3)) & nibble_low_bits;
+}
+
+/** Get a 1 in the low bit of each nibble of \a word which is saturated (15). **/
+inline std::uint64_t saturated_nibbles(std::uint64_t word)
+{
+    return word & (word >> 1) & (word >> 2) & (word >> 3) & nibble_low_bits;
+}
+
+/** Add 1 to each counter of \a word selected by the 16-bit \a mask, unless it is saturated. Since no counter can
+ *  overflow into its neighbor, this is a single addition.
+**/
+inline std::uint64_t increment_nibbles(std::uint64_t word, std::uint64_t mask)
+{
+    return word + (spread_nibbles(mask) & ~saturated_nibbles(word));
+}
+
+/** Subtract 1 from each counter of \a word selected by the 16-bit \a mask, unless it is zero or saturated. Saturated
+ *  counters have lost track of how many values were added, so they are never decremented.
+**/
+inline std::uint64_t decrement_nibbles(std::uint64_t word, std::uint64_t mask)
+{
+    return word - (spread_nibbles(mask) & nonzero_nibbles(word) & ~saturated_nibbles(word));
+}
+
+}
+
+/** \addtogroup Storage
+ *  \{
+**/
+
+/** Storage for a counting Bloom filter, which supports \c basic_bloom_filter::erase. Each bit of the filter is backed
+ *  by a 4-bit saturating counter, packed 16 to a 64-bit word, so a logical 64-bit block is 4 consecutive words (32
+ *  bytes). \c set_mask increments and \c clear_mask decrements the counters of the set bits of the mask with a few
+ *  word-level operations and no branches per counter, and \c operator[] gives the bits with a non-zero counter.
+ *
+ *  A counter which reaches 15 sticks there forever, since it no longer knows how many values it counts. With an ideally
+ *  sized filter, the chance of any counter reaching 15 is vanishingly small.
+ *
+ *  This uses 4 times the memory of \c basic_storage. When used with \c basic_cache_aligned_mixer, a 512-bit group
+ *  becomes 4 cache lines of counters; use a \c KAlignBits of 128 to keep each group of counters in a single line.
+ *
+ *  \tparam TBackingStorage The "real" type to store counter words in.
+ *
+ *  \see to_bit_filter
+**/
+template <typename TBackingStorage = std::vector<std::uint64_t>>
+class basic_counting_storage
+{
+public:
+    using block_type           = std::uint64_t;
+    using backing_storage_type = TBackingStorage;
+    using size_type            = typename backing_storage_type::size_type;
+    using allocator_type       = typename backing_storage_type::allocator_type;
+
+    /** The number of counter words which make up a single block. **/
+    static constexpr size_type words_per_block = 4;
+
+    static constexpr size_type partition_blocks = 1;
+
+public:
+    static constexpr size_type block_count(size_type bit_count)
+    {
+        return basic_storage<block_type>::block_count(bit_count);
+    }
+
+    explicit basic_counting_storage(size_type bit_count, const allocator_type& alloc = allocator_type()) :
+            _storage(block_count(bit_count) * words_per_block, std::uint64_t(0), alloc),
+            _bit_count(bit_count)
+    { }
+
+    size_type bit_count() const
+    {
+        return _bit_count;
+    }
+
+    size_type block_count() const
+    {
+        return _storage.size() / words_per_block;
+    }
+
+    /** Get the bits of the block at \a idx whose counter is not zero. **/
+    block_type operator[](size_type idx) const
+    {
+        const auto* words = &_storage[idx * words_per_block];
+        block_type out = 0;
+        for (size_type word = 0; word < words_per_block; ++word)
+            out |= detail::gather_nibbles(detail::nonzero_nibbles(words[word])) << (16 * word);
+        return out;
+    }
+
+    /** Get the value of the counter for the bit at \a bit_idx. **/
+    unsigned counter(size_type bit_idx) const
+    {
+        return unsigned(_storage.at(bit_idx / 16) >> (4 * (bit_idx % 16))) & 0xf;
+    }
+
+    void prefetch(size_type idx) const
+    {
+        detail::prefetch(&_storage[idx * words_per_block]);
+        detail::prefetch(&_storage[idx * words_per_block + words_per_block - 1]);
+    }
+
+    /** Increment the counter of each bit in \a mask of the block at \a block_idx. **/
+    void set_mask(size_type block_idx, const block_type& mask)
+    {
+        auto* words = &_storage.at(block_idx * words_per_block);
+        for (size_type word = 0; word < words_per_block; ++word)
+            words[word] = detail::increment_nibbles(words[word], mask >> (16 * word));
+    }
+
+    /** Decrement the counter of each bit in \a mask of the block at \a block_idx. **/
+    void clear_mask(size_type block_idx, const block_type& mask)
+    {
+        auto* words = &_storage.at(block_idx * words_per_block);
+        for (size_type word = 0; word < words_per_block; ++word)
+            words[word] = detail::decrement_nibbles(words[word], mask >> (16 * word));
+    }
+
+    void clear()
+    {
+        _storage.assign(_storage.size(), std::uint64_t(0));
+    }
+
+private:
+    backing_storage_type _storage;
+    size_type            _bit_count;
+};
+
+/** \see basic_counting_storage **/
+using counting_storage = basic_counting_storage<>;
+
+/** Similar to \c basic_counting_storage, but counters are updated in a thread-safe manner. Each word is updated with a
+ *  compare-and-swap loop, which is skipped entirely for words with no bits in the mask.
+ *
+ *  \tparam TBackingStorage The "real" type to store counter words in.
+**/
+template <typename TBackingStorage = std::vector<std::atomic<std::uint64_t>>>
+class basic_thread_safe_counting_storage
+{
+public:
+    using block_type           = std::uint64_t;
+    using backing_storage_type = TBackingStorage;
+    using size_type            = typename backing_storage_type::size_type;
+    using allocator_type       = typename backing_storage_type::allocator_type;
+
+    static constexpr size_type words_per_block = 4;
+    static constexpr size_type partition_blocks = 1;
+
+public:
+    static constexpr size_type block_count(size_type bit_count)
+    {
+        return basic_storage<block_type>::block_count(bit_count);
+    }
+
+    explicit basic_thread_safe_counting_storage(size_type bit_count, const allocator_type& alloc = allocator_type()) :
+            _storage(block_count(bit_count) * words_per_block, alloc),
+            _bit_count(bit_count)
+    { }
+
+    size_type bit_count() const
+    {
+        return _bit_count;
+    }
+
+    size_type block_count() const
+    {
+        return _storage.size() / words_per_block;
+    }
+
+    block_type operator[](size_type idx) const
+    {
+        block_type out = 0;
+        for (size_type word = 0; word < words_per_block; ++word)
+        {
+            auto value = _storage[idx * words_per_block + word].load(std::memory_order_relaxed);
+            out |= detail::gather_nibbles(detail::nonzero_nibbles(value)) << (16 * word);
+        }
+        return out;
+    }
+
+    unsigned counter(size_type bit_idx) const
+    {
+        return unsigned(_storage.at(bit_idx / 16).load(std::memory_order_relaxed) >> (4 * (bit_idx % 16))) & 0xf;
+    }
+
+    void prefetch(size_type idx) const
+    {
+        detail::prefetch(&_storage[idx * words_per_block]);
+        detail::prefetch(&_storage[idx * words_per_block + words_per_block - 1]);
+    }
+
+    void set_mask(size_type block_idx, const block_type& mask)
+    {
+        update(block_idx, mask, &detail::increment_nibbles);
+    }
+
+    void clear_mask(size_type block_idx, const block_type& mask)
+    {
+        update(block_idx, mask, &detail::decrement_nibbles);
+    }
+
+    void clear()
+    {
+        for (auto& word : _storage)
+            word.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    void update(size_type block_idx, block_type mask, std::uint64_t (*op)(std::uint64_t, std::uint64_t))
+    {
+        auto* words = &_storage.at(block_idx * words_per_block);
+        for (size_type word = 0; word < words_per_block; ++word)
+        {
+            auto word_mask = (mask >> (16 * word)) & 0xffffULL;
+            if (word_mask == 0)
+                continue;
+
+            auto expected = words[word].load(std::memory_order_relaxed);
+            while (!words[word].compare_exchange_weak(expected,
+                                                      op(expected, word_mask),
+                                                      std::memory_order_relaxed,
+                                                      std::memory_order_relaxed
+                                                     ))
+            { }
+        }
+    }
+
+private:
+    backing_storage_type _storage;
+    size_type            _bit_count;
+};
+
+/** \see basic_thread_safe_counting_storage **/
+using thread_safe_counting_storage = basic_thread_safe_counting_storage<>;
+
+/** \} **/
+
+/** \addtogroup Filter
+ *  \{
+**/
+
+template <typename T, typename TMixer = basic_mixer<T>>
+using counting_bloom_filter = basic_bloom_filter<T, TMixer, counting_storage>;
+
+template <typename T, typename TMixer = basic_mixer<T>>
+using thread_safe_counting_bloom_filter = basic_bloom_filter<T, TMixer, thread_safe_counting_storage>;
+
+/** Collapse a counting filter into a plain Bloom filter with the same parameters, which answers \c count identically
+ *  but uses a quarter of the memory. This is a single pass which turns each word of counters into 16 bits, so it is
+ *  cheap enough to do every time a read-only copy of the filter needs to be shipped somewhere.
+**/
+template <typename T, typename TMixer, typename TCountingStorage, typename TStats>
+basic_bloom_filter<T, TMixer, basic_storage<std::uint64_t>>
+to_bit_filter(const basic_bloom_filter<T, TMixer, TCountingStorage, TStats>& filter)
+{
+    basic_storage<std::uint64_t> bits(filter.data().bit_count());
+    auto* blocks = bits.data();
+    for (std::size_t block_idx = 0; block_idx < bits.block_count(); ++block_idx)
+        blocks[block_idx] = filter.data()[block_idx];
+    return basic_bloom_filter<T, TMixer, basic_storage<std::uint64_t>>(filter.params(), std::move(bits));
+}
+
+/** \} **/
+
+}
@@ -0,0 +1,595 @@
+#pragma once
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "assert.hpp"
+#include "hash.hpp"
+#include "mixer.hpp"
+#include "simd.hpp"
+#include "storage.hpp"
+
+namespace leekpp
+{
+
+namespace detail
+{
+
+inline std::uint64_t load_le64(const unsigned char* p)
+{
+    std::uint64_t out;
+    std::memcpy(&out, p, sizeof out);
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    out = __builtin_bswap64(out);
+#endif
+    return out;
+}
+
+inline void store_le64(unsigned char* p, std::uint64_t value)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    std::memcpy(p, &value, sizeof value);
+}
+
+}
+
+/** \addtogroup Filter
+ *  \{
+**/
+
+/** Parameters for creating a \c basic_cuckoo_filter. **/
+struct cuckoo_filter_params
+{
+    /** The number of fingerprints in a bucket. **/
+    static constexpr std::size_t slots_per_bucket = 4;
+
+    /** The highest fraction of slots which \c create_ideal expects to fill. Inserts into a filter with 4-slot buckets
+     *  start failing at around 95% full.
+    **/
+    static constexpr double max_load_factor = 0.94;
+
+    /** The number of buckets, which does not need to be a power of 2. **/
+    std::size_t bucket_count;
+
+    /** The number of bits in a fingerprint: 8, 12 or 16. **/
+    std::size_t fingerprint_bits;
+
+    cuckoo_filter_params() = default;
+
+    constexpr cuckoo_filter_params(std::size_t bucket_count, std::size_t fingerprint_bits) noexcept :
+            bucket_count(bucket_count),
+            fingerprint_bits(fingerprint_bits)
+    { }
+
+    /** Calculate the expected false positive rate with \a elements stored. A lookup compares against the occupied slots
+     *  of two buckets, <tt>2n / buckets</tt> of them on average, each of which matches a random (non-zero) fingerprint
+     *  with probability \f$\frac{1}{2^f - 1}\f$.
+    **/
+    double expected_fpr(std::size_t elements) const
+    {
+        auto per_slot = 1.0 / (std::ldexp(1.0, int(fingerprint_bits)) - 1.0);
+        return 1.0 - std::pow(1.0 - per_slot, 2.0 * elements / bucket_count);
+    }
+
+    /** Create parameters with enough buckets for \a expected_elements at \c max_load_factor and the smallest
+     *  fingerprint which meets \a desired_fpr.
+     *
+     *  \throws std::invalid_argument if not even 16-bit fingerprints can meet \a desired_fpr. If this exception is
+     *   actually thrown depends on the \c LEEK_ASSERT settings.
+    **/
+    static cuckoo_filter_params create_ideal(double desired_fpr, std::size_t expected_elements)
+    {
+        auto bucket_count = std::size_t(std::ceil(expected_elements / (slots_per_bucket * max_load_factor)));
+        bucket_count = bucket_count == 0 ? 1 : bucket_count;
+
+        for (std::size_t fingerprint_bits : { 8, 12, 16 })
+        {
+            cuckoo_filter_params out(bucket_count, fingerprint_bits);
+            if (out.expected_fpr(expected_elements) <= desired_fpr)
+                return out;
+        }
+        LEEK_ASSERT(false,
+                    invalid_argument,
+                    ("A cuckoo filter cannot reach an FPR of %f; the lowest is %f with 16-bit fingerprints",
+                     desired_fpr,
+                     cuckoo_filter_params(bucket_count, 16).expected_fpr(expected_elements)
+                    )
+                   );
+        return cuckoo_filter_params(bucket_count, 16);
+    }
+};
+
+/** A cuckoo filter (Fan et al.): each value is stored as a short fingerprint in one of two buckets of 4 slots, and
+ *  inserting into a full bucket moves ("kicks") an existing fingerprint to its other bucket. Compared to
+ *  \c basic_bloom_filter, a lookup is always exactly two bucket loads, values can be removed with \c erase, and below
+ *  an FPR of about 3% it uses less space -- for example, 12.8 bits per value at 0.2% with 12-bit fingerprints.
+ *
+ *  A bucket is packed into <tt>4 * fingerprint_bits</tt> bits and loaded as a single 64-bit word, so a lookup compares
+ *  the fingerprint against all 4 slots at once with a few integer operations (SIMD within a register), with no loop
+ *  over the slots.
+ *
+ *  The other bucket of a fingerprint is found from the bucket it is in and the fingerprint alone, as
+ *  <tt>(h(fp) - bucket) mod buckets</tt>, which works for any number of buckets. Insertion gives up after \c max_kicks
+ *  moves, returns \c false and undoes the moves, so a failed insert leaves the filter as it was. A filter created by
+ *  \c create_ideal for \a n values reliably holds them.
+ *
+ *  Inserting the same value many times stores a fingerprint for each; after 8 copies there is no room for another. Only
+ *  \c erase values which were inserted, or another value with the same fingerprint can be removed instead.
+ *
+ *  This class is not thread-safe; see \c basic_concurrent_cuckoo_filter.
+ *
+ *  \tparam T The type of value this filter is meant to store.
+ *  \tparam THash Function to use to transform a \c T into an integer. The result does not need to be well-mixed.
+ *  \tparam TStorage A block-based storage of 64-bit blocks. With contiguous access through \c data() (as
+ *   \c basic_storage has), buckets are loaded straight from memory. Otherwise (as with \c basic_thread_safe_storage),
+ *   they are read and written through the storage's \c operator[], \c set_mask and \c and_mask, one or two blocks
+ *   at a time.
+ *
+ *  \see https://www.cs.cmu.edu/~dga/papers/cuckoo-conext2014.pdf
+**/
+template <typename T,
+          typename THash    = hash<T>,
+          typename TStorage = basic_storage<std::uint64_t>
+         >
+class basic_cuckoo_filter :
+        private THash
+{
+public:
+    using value_type   = T;
+    using hash_type    = THash;
+    using storage_type = TStorage;
+    using block_type   = typename storage_type::block_type;
+    using size_type    = std::size_t;
+
+    static_assert(sizeof(block_type) == sizeof(std::uint64_t), "TStorage must have 64-bit blocks.");
+
+    /** The number of fingerprints in a bucket. **/
+    static constexpr size_type slots_per_bucket = cuckoo_filter_params::slots_per_bucket;
+
+    /** The number of fingerprints to move before an insert gives up. **/
+    static constexpr size_type max_kicks = 500;
+
+public:
+    /** Create an instance using \a params.
+     *
+     *  \throws std::invalid_argument if \c params.fingerprint_bits is not 8, 12 or 16 or \c params.bucket_count is 0.
+     *   If this exception is actually thrown depends on the \c LEEK_ASSERT settings.
+    **/
+    explicit basic_cuckoo_filter(const cuckoo_filter_params& params, const hash_type& hash = hash_type()) :
+            THash(hash),
+            _params(params),
+            _data(params.bucket_count * slots_per_bucket * params.fingerprint_bits + 64),
+            _size(0),
+            _kick_state(0x2545f4914f6cdd1dULL)
+    {
+        LEEK_ASSERT(params.fingerprint_bits == 8 || params.fingerprint_bits == 12 || params.fingerprint_bits == 16,
+                    invalid_argument,
+                    ("Fingerprints must be 8, 12 or 16 bits, not %zu", params.fingerprint_bits)
+                   );
+        LEEK_ASSERT(params.bucket_count > 0, invalid_argument, ("A cuckoo filter needs at least one bucket"));
+
+        auto bits = params.fingerprint_bits;
+        _fingerprint_mask = (std::uint64_t(1) << bits) - 1;
+        _lane_ones        = 0;
+        for (size_type lane = 0; lane < slots_per_bucket; ++lane)
+            _lane_ones |= std::uint64_t(1) << (lane * bits);
+        _lane_highs  = _lane_ones << (bits - 1);
+        _bucket_mask = bits * slots_per_bucket == 64 ? ~std::uint64_t(0) : (std::uint64_t(1) << (bits * 4)) - 1;
+        _data.clear();
+    }
+
+    /** Creates a \c basic_cuckoo_filter from the parameters created with \c cuckoo_filter_params::create_ideal. **/
+    static basic_cuckoo_filter create_ideal(double desired_fpr, std::size_t expected_elements)
+    {
+        return basic_cuckoo_filter(cuckoo_filter_params::create_ideal(desired_fpr, expected_elements));
+    }
+
+    /** Get the parameters used for this filter. **/
+    const cuckoo_filter_params& params() const
+    {
+        return _params;
+    }
+
+    /** Get the packed buckets of this filter. **/
+    const storage_type& data() const
+    {
+        return _data;
+    }
+
+    /** Get the number of fingerprints stored. **/
+    size_type size() const
+    {
+        return _size;
+    }
+
+    /** Calculate the expected false positive rate of this filter if \a elements values were inserted.
+     *
+     *  \see cuckoo_filter_params::expected_fpr
+    **/
+    double expected_fpr(std::size_t elements) const
+    {
+        return _params.expected_fpr(elements);
+    }
+
+    /** Test for the likely presence of \a x in this filter instance.
+     *
+     *  \returns \c 0 if the value is not present in this filter; \c 1 if it looks like the value is present.
+     *  \see basic_bloom_filter::count
+    **/
+    size_type count(const value_type& x) const
+    {
+        auto location = locate(THash::operator()(x));
+        auto spread   = location.second * _lane_ones;
+        return (zero_lanes(load_bucket(location.first) ^ spread) != 0
+                || zero_lanes(load_bucket(alternate(location.first, location.second)) ^ spread) != 0
+               ) ? 1 : 0;
+    }
+
+    /** Insert the value \a x into this filter.
+     *
+     *  \returns \c true if it was inserted; \c false if there was no room for it, in which case the filter is
+     *   unchanged.
+    **/
+    bool insert(const value_type& x)
+    {
+        auto location = locate(THash::operator()(x));
+        auto bucket   = location.first;
+        auto other    = alternate(bucket, location.second);
+        if (put(bucket, location.second) || put(other, location.second))
+        {
+            ++_size;
+            return true;
+        }
+
+        // Every slot of both buckets is taken, so move fingerprints out of the way, remembering where each move went so
+        // they can be undone
+        struct kick
+        {
+            size_type bucket;
+            size_type lane;
+        };
+        kick kicks[max_kicks];
+
+        auto homeless = location.second;
+        bucket = next_random() & 1 ? other : bucket;
+        for (size_type idx = 0; idx < max_kicks; ++idx)
+        {
+            auto lane = size_type(next_random() % slots_per_bucket);
+            kicks[idx] = kick{ bucket, lane };
+            homeless   = swap_lane(bucket, lane, homeless);
+            bucket     = alternate(bucket, homeless);
+            if (put(bucket, homeless))
+            {
+                ++_size;
+                return true;
+            }
+        }
+
+        for (size_type idx = max_kicks; idx-- > 0; )
+            homeless = swap_lane(kicks[idx].bucket, kicks[idx].lane, homeless);
+        return false;
+    }
+
+    /** Remove one copy of the value \a x from this filter.
+     *
+     *  \returns \c true if a matching fingerprint was found and removed.
+    **/
+    bool erase(const value_type& x)
+    {
+        auto location = locate(THash::operator()(x));
+        if (remove(location.first, location.second)
+            || remove(alternate(location.first, location.second), location.second))
+        {
+            --_size;
+            return true;
+        }
+        return false;
+    }
+
+    /** Reset the contents of this filter to nothing. **/
+    void clear()
+    {
+        _data.clear();
+        _size = 0;
+    }
+
+private:
+    unsigned char* bytes()
+    {
+        return reinterpret_cast<unsigned char*>(_data.data());
+    }
+
+    const unsigned char* bytes() const
+    {
+        return reinterpret_cast<const unsigned char*>(_data.data());
+    }
+
+    /** Get the first bucket and the fingerprint of a value which hashed to \a hash. A fingerprint of 0 marks an empty
+     *  slot, so it is never used.
+    **/
+    std::pair<size_type, std::uint64_t> locate(std::uint64_t hash) const
+    {
+        auto mixed       = detail::mix64(hash);
+        auto fingerprint = mixed & _fingerprint_mask;
+        return { size_type(detail::reduce(mixed, _params.bucket_count)), fingerprint == 0 ? 1 : fingerprint };
+    }
+
+    /** Get the other bucket of \a fingerprint when it is in \a bucket. Applying this twice gives back \a bucket. **/
+    size_type alternate(size_type bucket, std::uint64_t fingerprint) const
+    {
+        auto mixed = detail::mix64(fingerprint ^ 0x9e3779b97f4a7c15ULL);
+        auto pivot = size_type(detail::reduce(mixed, _params.bucket_count));
+        return pivot >= bucket ? pivot - bucket : pivot + _params.bucket_count - bucket;
+    }
+
+    template <typename UStorage = storage_type>
+    typename std::enable_if<detail::has_contiguous_data<UStorage>::value, std::uint64_t>::type
+    load_bucket(size_type bucket) const
+    {
+        return detail::load_le64(bytes() + bucket * bucket_bytes()) & _bucket_mask;
+    }
+
+    template <typename UStorage = storage_type>
+    typename std::enable_if<detail::has_contiguous_data<UStorage>::value>::type
+    store_bucket(size_type bucket, std::uint64_t value)
+    {
+        auto p = bytes() + bucket * bucket_bytes();
+        detail::store_le64(p, (detail::load_le64(p) & ~_bucket_mask) | value);
+    }
+
+    /** Load a bucket which can straddle two blocks of the storage. There is always a block after the last bucket. **/
+    template <typename UStorage = storage_type>
+    typename std::enable_if<!detail::has_contiguous_data<UStorage>::value, std::uint64_t>::type
+    load_bucket(size_type bucket) const
+    {
+        auto bit   = bucket * bucket_bytes() * 8;
+        auto block = bit / 64;
+        auto shift = unsigned(bit % 64);
+        auto out   = std::uint64_t(_data[block]) >> shift;
+        if (shift != 0)
+            out |= std::uint64_t(_data[block + 1]) << (64 - shift);
+        return out & _bucket_mask;
+    }
+
+    /** Store a bucket by setting and clearing only the bits which change, so the bits of neighboring buckets in the
+     *  same blocks are never rewritten.
+    **/
+    template <typename UStorage = storage_type>
+    typename std::enable_if<!detail::has_contiguous_data<UStorage>::value>::type
+    store_bucket(size_type bucket, std::uint64_t value)
+    {
+        auto old     = load_bucket(bucket);
+        auto to_set  = value & ~old;
+        auto to_zero = old & ~value;
+        auto bit     = bucket * bucket_bytes() * 8;
+        auto block   = bit / 64;
+        auto shift   = unsigned(bit % 64);
+        change_bits(block, to_set << shift, to_zero << shift);
+        if (shift != 0)
+            change_bits(block + 1, to_set >> (64 - shift), to_zero >> (64 - shift));
+    }
+
+    void change_bits(size_type block, std::uint64_t to_set, std::uint64_t to_zero)
+    {
+        if (to_set != 0)
+            _data.set_mask(block, block_type(to_set));
+        if (to_zero != 0)
+            _data.and_mask(block, block_type(~to_zero));
+    }
+
+    size_type bucket_bytes() const
+    {
+        return _params.fingerprint_bits * slots_per_bucket / 8;
+    }
+
+    /** Get a word with the high bit of each lane of \a x which is zero set. Lanes above a zero lane can also be flagged
+     *  (from the borrow), but the lowest flagged lane is always the lowest zero lane.
+    **/
+    std::uint64_t zero_lanes(std::uint64_t x) const
+    {
+        return (x - _lane_ones) & ~x & _lane_highs;
+    }
+
+    size_type lowest_lane(std::uint64_t flags) const
+    {
+        return detail::count_trailing_zeros(flags) / _params.fingerprint_bits;
+    }
+
+    /** Put \a fingerprint into an empty slot of \a bucket, if there is one. **/
+    bool put(size_type bucket, std::uint64_t fingerprint)
+    {
+        auto value = load_bucket(bucket);
+        auto empty = zero_lanes(value);
+        if (empty == 0)
+            return false;
+        store_bucket(bucket, value | (fingerprint << (lowest_lane(empty) * _params.fingerprint_bits)));
+        return true;
+    }
+
+    /** Clear a slot of \a bucket holding \a fingerprint, if there is one. **/
+    bool remove(size_type bucket, std::uint64_t fingerprint)
+    {
+        auto value   = load_bucket(bucket);
+        auto matches = zero_lanes(value ^ (fingerprint * _lane_ones));
+        if (matches == 0)
+            return false;
+        store_bucket(bucket, value & ~(_fingerprint_mask << (lowest_lane(matches) * _params.fingerprint_bits)));
+        return true;
+    }
+
+    /** Replace the fingerprint in \a lane of \a bucket with \a fingerprint and return the one that was there. **/
+    std::uint64_t swap_lane(size_type bucket, size_type lane, std::uint64_t fingerprint)
+    {
+        auto shift = lane * _params.fingerprint_bits;
+        auto value = load_bucket(bucket);
+        auto out   = (value >> shift) & _fingerprint_mask;
+        store_bucket(bucket, (value & ~(_fingerprint_mask << shift)) | (fingerprint << shift));
+        return out;
+    }
+
+    /** Step the xorshift generator which picks which fingerprint to kick. **/
+    std::uint64_t next_random()
+    {
+        _kick_state ^= _kick_state << 13;
+        _kick_state ^= _kick_state >> 7;
+        _kick_state ^= _kick_state << 17;
+        return _kick_state;
+    }
+
+private:
+    cuckoo_filter_params _params;
+    storage_type         _data;
+    size_type            _size;
+    std::uint64_t        _fingerprint_mask;
+    std::uint64_t        _lane_ones;
+    std::uint64_t        _lane_highs;
+    std::uint64_t        _bucket_mask;
+    std::uint64_t        _kick_state;
+};
+
+/** A \c basic_cuckoo_filter which can be used from many threads at once. This suits read-mostly use, such as a filter
+ *  consulted on every request and updated occasionally; for insert-heavy workloads, a \c thread_safe_bloom_filter
+ *  scales better, since its inserts never block each other.
+ *
+ *  Lookups are optimistic and never write to shared memory: they read a version counter, load the two buckets, and
+ *  check that the version did not change, retrying if a writer was active in between. \c insert, \c erase and
+ *  \c clear serialize on a mutex and make the version odd while they modify the buckets, so a lookup never sees a
+ *  fingerprint which is halfway through a chain of kicks. Readers only wait while a write is in progress. The buckets
+ *  live in atomic blocks which are read and written with relaxed operations, so a lookup which overlaps a write reads
+ *  stale or mixed values (which it then discards) instead of racing with it.
+ *
+ *  \tparam TStorage A storage with atomic blocks, such as \c basic_thread_safe_storage (see \c basic_cuckoo_filter).
+ *
+ *  \see basic_cuckoo_filter
+**/
+template <typename T,
+          typename THash    = hash<T>,
+          typename TStorage = basic_thread_safe_storage<std::uint64_t>
+         >
+class basic_concurrent_cuckoo_filter
+{
+public:
+    using filter_type = basic_cuckoo_filter<T, THash, TStorage>;
+    using value_type  = T;
+    using hash_type   = THash;
+    using size_type   = std::size_t;
+
+    static_assert(!detail::has_contiguous_data<TStorage>::value,
+                  "TStorage must be read and written through atomic blocks, not plain memory."
+                 );
+
+public:
+    explicit basic_concurrent_cuckoo_filter(const cuckoo_filter_params& params, const hash_type& hash = hash_type()) :
+            _filter(params, hash),
+            _version(0),
+            _size(0)
+    { }
+
+    /** \see basic_cuckoo_filter::create_ideal **/
+    static basic_concurrent_cuckoo_filter create_ideal(double desired_fpr, std::size_t expected_elements)
+    {
+        return basic_concurrent_cuckoo_filter(cuckoo_filter_params::create_ideal(desired_fpr, expected_elements));
+    }
+
+    basic_concurrent_cuckoo_filter(basic_concurrent_cuckoo_filter&& src) :
+            _filter(std::move(src._filter)),
+            _version(0),
+            _size(src._size.load(std::memory_order_relaxed))
+    { }
+
+    basic_concurrent_cuckoo_filter(const basic_concurrent_cuckoo_filter&) = delete;
+    basic_concurrent_cuckoo_filter& operator=(const basic_concurrent_cuckoo_filter&) = delete;
+
+    const cuckoo_filter_params& params() const
+    {
+        return _filter.params();
+    }
+
+    size_type size() const
+    {
+        return _size.load(std::memory_order_relaxed);
+    }
+
+    double expected_fpr(std::size_t elements) const
+    {
+        return _filter.expected_fpr(elements);
+    }
+
+    size_type count(const value_type& x) const
+    {
+        return read([&] { return _filter.count(x); });
+    }
+
+    bool insert(const value_type& x)
+    {
+        return write([&] { return _filter.insert(x); });
+    }
+
+    bool erase(const value_type& x)
+    {
+        return write([&] { return _filter.erase(x); });
+    }
+
+    void clear()
+    {
+        write([&] { _filter.clear(); return true; });
+    }
+
+private:
+    /** Call \a f until it runs without a writer modifying the filter at the same time. **/
+    template <typename FRead>
+    auto read(FRead f) const -> decltype(f())
+    {
+        for ( ; ; )
+        {
+            auto before = _version.load(std::memory_order_acquire);
+            if (before & 1)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            auto out = f();
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (_version.load(std::memory_order_relaxed) == before)
+                return out;
+        }
+    }
+
+    /** Call \a f with the filter to itself, with the version odd while it runs. **/
+    template <typename FWrite>
+    bool write(FWrite f)
+    {
+        std::lock_guard<std::mutex> lock(_write_mutex);
+        auto before = _version.load(std::memory_order_relaxed);
+        _version.store(before + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        auto out = f();
+        _version.store(before + 2, std::memory_order_release);
+        _size.store(_filter.size(), std::memory_order_relaxed);
+        return out;
+    }
+
+private:
+    filter_type                _filter;
+    std::atomic<std::uint64_t> _version;
+    std::atomic<size_type>     _size;
+    std::mutex                 _write_mutex;
+};
+
+template <typename T>
+using cuckoo_filter = basic_cuckoo_filter<T>;
+
+template <typename T>
+using concurrent_cuckoo_filter = basic_concurrent_cuckoo_filter<T>;
+
+/** \} **/
+
+}
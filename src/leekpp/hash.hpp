@@ -0,0 +1,379 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+
+#if __cplusplus >= 201703L
+#   include <string_view>
+#endif
+
+#include "simd.hpp"
+
+namespace leekpp
+{
+
+namespace detail
+{
+
+/** Constants from [wyhash](https://github.com/wangyi-fudan/wyhash). **/
+static constexpr std::uint64_t hash_primes[4] =
+{
+    0xa0761d6478bd642fULL, 0xe7037ed1a0b428dbULL, 0x8ebc6af09c88c6e3ULL, 0x589965cc75374cc3ULL,
+};
+
+/** Keys for the long input path. Each 64-byte stripe is combined with 8 of these, starting at a different offset for
+ *  each stripe, so moving stripes around changes the hash.
+**/
+static constexpr std::uint64_t hash_secret[16] =
+{
+    0x8071ff8c62e69cfeULL, 0xc4f32ad9d70ad7f6ULL, 0xa26dcb1dc7e7b464ULL, 0x089e9e6de2ee19d6ULL,
+    0x7a7080c3c2afd0bbULL, 0x3c85fe5119f950e5ULL, 0x1a478148ea937a96ULL, 0x6915913cae9d0ee1ULL,
+    0xa67d1be6586e82edULL, 0xce96a85ce5664d98ULL, 0xd05c9333ef3fc16dULL, 0x1857b259715fda51ULL,
+    0x439a705e71666c36ULL, 0x083a10b9798f0e50ULL, 0x447209116fc75fd0ULL, 0x7511e42d9c065fbeULL,
+};
+
+/** Inputs at least this long use \c hash_long. **/
+static constexpr std::size_t hash_long_threshold = 1024;
+
+/** The number of stripes accumulated between scrambles in \c hash_long. **/
+static constexpr std::size_t hash_stripes_per_block = 8;
+
+static constexpr std::uint64_t hash_scramble_prime = 0x9e3779b1ULL;
+
+/** Replace \a a and \a b with the low and high halves of their 128-bit product. **/
+inline void multiply_wide(std::uint64_t& a, std::uint64_t& b)
+{
+#if defined(__SIZEOF_INT128__)
+    auto product = static_cast<unsigned __int128>(a) * b;
+    a = std::uint64_t(product);
+    b = std::uint64_t(product >> 64);
+#else
+    std::uint64_t a_lo = a & 0xffffffffULL, a_hi = a >> 32;
+    std::uint64_t b_lo = b & 0xffffffffULL, b_hi = b >> 32;
+    std::uint64_t lo_lo = a_lo * b_lo;
+    std::uint64_t hi_lo = a_hi * b_lo;
+    std::uint64_t lo_hi = a_lo * b_hi;
+    std::uint64_t hi_hi = a_hi * b_hi;
+    std::uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffffULL) + lo_hi;
+    a = (cross << 32) | (lo_lo & 0xffffffffULL);
+    b = hi_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+/** Fold the 128-bit product of \a a and \a b into 64 bits. **/
+inline std::uint64_t multiply_fold(std::uint64_t a, std::uint64_t b)
+{
+    multiply_wide(a, b);
+    return a ^ b;
+}
+
+inline std::uint64_t read64(const unsigned char* p)
+{
+    std::uint64_t out;
+    std::memcpy(&out, p, sizeof out);
+    return out;
+}
+
+inline std::uint64_t read32(const unsigned char* p)
+{
+    std::uint32_t out;
+    std::memcpy(&out, p, sizeof out);
+    return out;
+}
+
+/** Read 1 to 3 bytes (every byte contributes, without branching on the exact length). **/
+inline std::uint64_t read_small(const unsigned char* p, std::size_t len)
+{
+    return (std::uint64_t(p[0]) << 16) | (std::uint64_t(p[len >> 1]) << 8) | p[len - 1];
+}
+
+inline void hash_accumulate_scalar(std::uint64_t* acc, const unsigned char* p, const std::uint64_t* key)
+{
+    for (std::size_t lane = 0; lane < 8; ++lane)
+    {
+        auto value   = read64(p + 8 * lane);
+        auto keyed   = value ^ key[lane];
+        acc[lane ^ 1] += value;
+        acc[lane]     += (keyed & 0xffffffffULL) * (keyed >> 32);
+    }
+}
+
+inline void hash_scramble_scalar(std::uint64_t* acc, const std::uint64_t* key)
+{
+    for (std::size_t lane = 0; lane < 8; ++lane)
+    {
+        acc[lane] ^= acc[lane] >> 47;
+        acc[lane] ^= key[lane];
+        acc[lane] *= hash_scramble_prime;
+    }
+}
+
+/** Stripe loop for \c hash_long: every stripe but the last, then the last 64 bytes (which might overlap the previous
+ *  stripe). \c FAccumulate and \c FScramble are one of the implementations above.
+**/
+template <typename TAcc, typename FAccumulate, typename FScramble>
+void hash_stripes(TAcc& acc, const unsigned char* p, std::size_t len, FAccumulate accumulate, FScramble scramble)
+{
+    auto stripes = (len - 1) / 64;
+    for (std::size_t stripe = 0; stripe < stripes; ++stripe)
+    {
+        accumulate(acc, p + 64 * stripe, hash_secret + stripe % hash_stripes_per_block);
+        if (stripe % hash_stripes_per_block == hash_stripes_per_block - 1)
+            scramble(acc, hash_secret + 8);
+    }
+    accumulate(acc, p + len - 64, hash_secret + 3);
+}
+
+inline void hash_long_lanes_scalar(std::uint64_t* acc, const unsigned char* p, std::size_t len)
+{
+    hash_stripes(acc,
+                 p,
+                 len,
+                 [] (std::uint64_t* acc, const unsigned char* p, const std::uint64_t* key)
+                 {
+                     hash_accumulate_scalar(acc, p, key);
+                 },
+                 [] (std::uint64_t* acc, const std::uint64_t* key)
+                 {
+                     hash_scramble_scalar(acc, key);
+                 }
+                );
+}
+
+#if LEEK_USE_AVX2
+
+/** The AVX2 version of \c hash_long_lanes_scalar, which produces exactly the same accumulators. **/
+inline void hash_long_lanes_avx2(std::uint64_t* acc_out, const unsigned char* p, std::size_t len)
+{
+    __m256i acc[2] =
+    {
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc_out)),
+        _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc_out + 4)),
+    };
+    hash_stripes(acc,
+                 p,
+                 len,
+                 [] (__m256i* acc, const unsigned char* p, const std::uint64_t* key)
+                 {
+                     for (std::size_t half = 0; half < 2; ++half)
+                     {
+                         auto value   = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p) + half);
+                         auto keys    = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + 4 * half));
+                         auto keyed   = _mm256_xor_si256(value, keys);
+                         auto product = _mm256_mul_epu32(keyed, _mm256_shuffle_epi32(keyed, _MM_SHUFFLE(0, 3, 0, 1)));
+                         auto swapped = _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+                         acc[half] = _mm256_add_epi64(acc[half], _mm256_add_epi64(swapped, product));
+                     }
+                 },
+                 [] (__m256i* acc, const std::uint64_t* key)
+                 {
+                     const auto prime = _mm256_set1_epi64x(std::int64_t(hash_scramble_prime));
+                     for (std::size_t half = 0; half < 2; ++half)
+                     {
+                         auto keys = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(key + 4 * half));
+                         auto x    = _mm256_xor_si256(acc[half], _mm256_srli_epi64(acc[half], 47));
+                         x = _mm256_xor_si256(x, keys);
+                         auto lo = _mm256_mul_epu32(x, prime);
+                         auto hi = _mm256_mul_epu32(_mm256_srli_epi64(x, 32), prime);
+                         acc[half] = _mm256_add_epi64(lo, _mm256_slli_epi64(hi, 32));
+                     }
+                 }
+                );
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc_out), acc[0]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc_out + 4), acc[1]);
+}
+
+#endif
+
+/** Hash an input of at least \c hash_long_threshold bytes. Eight independent 64-bit lanes each take a 32x32-bit
+ *  multiply per 8 bytes (the structure of XXH3), which maps directly onto SIMD registers, instead of the dependent
+ *  chain of 128-bit multiplies used for shorter inputs.
+**/
+inline std::uint64_t hash_long(const unsigned char* p, std::size_t len, std::uint64_t seed)
+{
+    std::uint64_t acc[8];
+    for (std::size_t lane = 0; lane < 8; ++lane)
+        acc[lane] = hash_secret[lane] ^ seed;
+
+#if LEEK_USE_AVX2
+    hash_long_lanes_avx2(acc, p, len);
+#else
+    hash_long_lanes_scalar(acc, p, len);
+#endif
+
+    auto out = seed ^ (len * hash_primes[0]);
+    for (std::size_t lane = 0; lane < 8; lane += 2)
+        out = multiply_fold(acc[lane] ^ hash_secret[8 + lane], acc[lane + 1] ^ out);
+    return multiply_fold(out ^ hash_primes[0], hash_primes[1]);
+}
+
+/** Hash \a len bytes at \a data. Inputs shorter than \c hash_long_threshold use the final version of
+ *  [wyhash](https://github.com/wangyi-fudan/wyhash); longer ones use \c hash_long.
+**/
+inline std::uint64_t hash_bytes(const void* data, std::size_t len, std::uint64_t seed = 0)
+{
+    auto p = static_cast<const unsigned char*>(data);
+    seed ^= multiply_fold(seed ^ hash_primes[0], hash_primes[1]);
+    if (len >= hash_long_threshold)
+        return hash_long(p, len, seed);
+
+    std::uint64_t a, b;
+    if (len <= 16)
+    {
+        if (len >= 4)
+        {
+            a = (read32(p) << 32) | read32(p + ((len >> 3) << 2));
+            b = (read32(p + len - 4) << 32) | read32(p + len - 4 - ((len >> 3) << 2));
+        }
+        else if (len > 0)
+        {
+            a = read_small(p, len);
+            b = 0;
+        }
+        else
+        {
+            a = b = 0;
+        }
+    }
+    else
+    {
+        auto remaining = len;
+        if (remaining > 48)
+        {
+            auto seed1 = seed, seed2 = seed;
+            do
+            {
+                seed  = multiply_fold(read64(p) ^ hash_primes[1], read64(p + 8) ^ seed);
+                seed1 = multiply_fold(read64(p + 16) ^ hash_primes[2], read64(p + 24) ^ seed1);
+                seed2 = multiply_fold(read64(p + 32) ^ hash_primes[3], read64(p + 40) ^ seed2);
+                p += 48;
+                remaining -= 48;
+            } while (remaining > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (remaining > 16)
+        {
+            seed = multiply_fold(read64(p) ^ hash_primes[1], read64(p + 8) ^ seed);
+            p += 16;
+            remaining -= 16;
+        }
+        a = read64(p + remaining - 16);
+        b = read64(p + remaining - 8);
+    }
+
+    a ^= hash_primes[1];
+    b ^= seed;
+    multiply_wide(a, b);
+    return multiply_fold(a ^ hash_primes[0] ^ len, b ^ hash_primes[1]);
+}
+
+/** Hash a single 64-bit integer. This is a single 128-bit multiply, but every bit of the input affects every bit of
+ *  the output.
+**/
+inline std::uint64_t hash_integer(std::uint64_t x)
+{
+    return multiply_fold(x ^ hash_primes[0], hash_primes[1]);
+}
+
+template <typename T, typename TEnable = void>
+struct hash_impl
+{
+    std::uint64_t operator()(const T& x) const
+    {
+        return hash_integer(std::hash<T>()(x));
+    }
+};
+
+template <typename T>
+struct hash_impl<T, typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value>::type>
+{
+    std::uint64_t operator()(T x) const
+    {
+        // Converting through a signed 64-bit integer sign-extends negative values, so an int and a long with the same
+        // value have the same hash
+        using wide_type = typename std::conditional<std::is_signed<T>::value, std::int64_t, std::uint64_t>::type;
+        return hash_integer(std::uint64_t(wide_type(x)));
+    }
+};
+
+template <typename T>
+struct hash_impl<T, typename std::enable_if<std::is_floating_point<T>::value>::type>
+{
+    std::uint64_t operator()(T x) const
+    {
+        // 0.0 and -0.0 compare equal, so they must hash equally
+        if (x == T(0))
+            x = T(0);
+        return hash_bytes(&x, sizeof x);
+    }
+};
+
+/** Hashes strings of \c TChar by their contents. This is \e transparent: any of the string-like types can be hashed,
+ *  and equal strings have the same hash no matter which type holds them.
+**/
+template <typename TChar, typename TCharTraits>
+struct string_hash
+{
+    using is_transparent = void;
+
+    template <typename TAllocator>
+    std::uint64_t operator()(const std::basic_string<TChar, TCharTraits, TAllocator>& x) const
+    {
+        return hash_bytes(x.data(), x.size() * sizeof(TChar));
+    }
+
+#if __cplusplus >= 201703L
+    std::uint64_t operator()(std::basic_string_view<TChar, TCharTraits> x) const
+    {
+        return hash_bytes(x.data(), x.size() * sizeof(TChar));
+    }
+#endif
+
+    std::uint64_t operator()(const TChar* x) const
+    {
+        return hash_bytes(x, TCharTraits::length(x) * sizeof(TChar));
+    }
+};
+
+}
+
+/** \addtogroup Mixer
+ *  \{
+**/
+
+/** The default hash function for mixers. Integers, enumerations and floating-point values are hashed by value and
+ *  strings (\c std::basic_string and \c std::basic_string_view) by contents, with a fast and well-distributed 64-bit
+ *  hash: a single 128-bit multiply for integers, [wyhash](https://github.com/wangyi-fudan/wyhash) for short strings and
+ *  an XXH3-style vectorized loop for long ones. Any other \c T is hashed with \c std::hash and then mixed, so every
+ *  type \c std::hash supports works here as well.
+ *
+ *  Unlike \c std::hash, the result is well-mixed even for sequential integers, and the same on every platform with the
+ *  same endianness.
+ *
+ *  The string hashes are \e transparent (they define \c is_transparent), so a \c basic_bloom_filter of \c std::string
+ *  can be queried with a \c std::string_view or a <tt>const char*</tt> without constructing a \c std::string.
+**/
+template <typename T>
+struct hash :
+        detail::hash_impl<T>
+{ };
+
+template <typename TChar, typename TCharTraits, typename TAllocator>
+struct hash<std::basic_string<TChar, TCharTraits, TAllocator>> :
+        detail::string_hash<TChar, TCharTraits>
+{ };
+
+#if __cplusplus >= 201703L
+template <typename TChar, typename TCharTraits>
+struct hash<std::basic_string_view<TChar, TCharTraits>> :
+        detail::string_hash<TChar, TCharTraits>
+{ };
+#endif
+
+/** \} **/
+
+}
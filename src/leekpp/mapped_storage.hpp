@@ -0,0 +1,303 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "assert.hpp"
+#include "storage.hpp"
+
+namespace leekpp
+{
+
+/** \addtogroup Storage
+ *  \{
+**/
+
+/** How a \c basic_mapped_storage maps its file. **/
+enum class map_mode
+{
+    /** The mapping can only be read from. Calling \c set_mask or \c clear is an error. **/
+    read_only,
+    /** Changes to the mapping are written back to the file (see \c basic_mapped_storage::sync). **/
+    read_write,
+};
+
+/** Provides block storage backed by a memory-mapped file. Opening an existing file is O(1) no matter how large it is,
+ *  since nothing is read up front -- the operating system faults pages in lazily as they are probed. This makes it
+ *  possible to restart a process with a multi-gigabyte filter without rebuilding or copying it.
+ *
+ *  The blocks are stored in the file as a raw array in native byte order, starting at a byte \c offset (which allows
+ *  for a header). Since the storage does not know the \c bloom_filter_params it was created with, you must pass the
+ *  same parameters when reopening it:
+ *
+ *  \code
+ *  using filter_type = leekpp::basic_bloom_filter<std::string,
+ *                                                 leekpp::basic_mixer<std::string>,
+ *                                                 leekpp::mapped_storage
+ *                                                >;
+ *
+ *  auto params = leekpp::bloom_filter_params::create_ideal(0.01, 100000000);
+ *  filter_type filter(params, leekpp::mapped_storage::create("filter.bin", params.bit_count));
+ *  // ...later, in another process...
+ *  filter_type same(params, leekpp::mapped_storage::open("filter.bin", params.bit_count));
+ *  \endcode
+ *
+ *  Changes are visible to other processes mapping the same file immediately, but call \c sync (for example, through
+ *  \c basic_bloom_filter::data) to make sure they have reached the disk.
+ *
+ *  This storage is only available on POSIX systems. Errors from the operating system are reported by throwing
+ *  \c std::system_error.
+ *
+ *  \tparam TBlock The type of block to store. This must be an integral type.
+**/
+template <typename TBlock = std::size_t>
+class basic_mapped_storage
+{
+public:
+    using block_type = TBlock;
+    using size_type  = std::size_t;
+
+    static_assert(std::is_integral<block_type>::value, "TBlock must be an integral type.");
+
+    static constexpr size_type partition_blocks = 1;
+
+public:
+    static constexpr size_type block_count(size_type bit_count)
+    {
+        return basic_storage<block_type>::block_count(bit_count);
+    }
+
+    /** Create a new file at \a path (or truncate an existing one) large enough to hold \a bit_count bits after
+     *  \a offset bytes and map it with \c map_mode::read_write. The blocks start out as 0.
+    **/
+    static basic_mapped_storage create(const std::string& path, size_type bit_count, size_type offset = 0)
+    {
+        check_offset(offset);
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(), "Failed to create " + path);
+
+        basic_mapped_storage out(fd, map_mode::read_write, bit_count, offset);
+        if (::ftruncate(fd, off_t(out._map_length)) != 0)
+            throw std::system_error(errno, std::generic_category(), "Failed to resize " + path);
+        out.map(path);
+        return out;
+    }
+
+    /** Map the existing file at \a path, which holds \a bit_count bits after \a offset bytes.
+     *
+     *  \throws std::invalid_argument if the file is too small to hold \a bit_count bits. If this exception is actually
+     *   thrown depends on the \c LEEK_ASSERT settings.
+    **/
+    static basic_mapped_storage open(const std::string& path,
+                                     size_type          bit_count,
+                                     map_mode           mode   = map_mode::read_only,
+                                     size_type          offset = 0
+                                    )
+    {
+        check_offset(offset);
+        int fd = ::open(path.c_str(), mode == map_mode::read_only ? O_RDONLY : O_RDWR);
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(), "Failed to open " + path);
+
+        basic_mapped_storage out(fd, mode, bit_count, offset);
+        struct stat info;
+        if (::fstat(fd, &info) != 0)
+            throw std::system_error(errno, std::generic_category(), "Failed to stat " + path);
+        LEEK_ASSERT(size_type(info.st_size) >= out._map_length,
+                    invalid_argument,
+                    ("File %s is %zu bytes, but %zu are needed",
+                     path.c_str(),
+                     size_type(info.st_size),
+                     out._map_length
+                    )
+                   );
+        out.map(path);
+        return out;
+    }
+
+    basic_mapped_storage(basic_mapped_storage&& src) noexcept :
+            _fd(src._fd),
+            _mode(src._mode),
+            _bit_count(src._bit_count),
+            _offset(src._offset),
+            _map_length(src._map_length),
+            _map(src._map)
+    {
+        src._fd  = -1;
+        src._map = nullptr;
+    }
+
+    basic_mapped_storage& operator=(basic_mapped_storage&& src) noexcept
+    {
+        if (this != &src)
+        {
+            release();
+            _fd         = src._fd;
+            _mode       = src._mode;
+            _bit_count  = src._bit_count;
+            _offset     = src._offset;
+            _map_length = src._map_length;
+            _map        = src._map;
+            src._fd  = -1;
+            src._map = nullptr;
+        }
+        return *this;
+    }
+
+    basic_mapped_storage(const basic_mapped_storage&) = delete;
+    basic_mapped_storage& operator=(const basic_mapped_storage&) = delete;
+
+    ~basic_mapped_storage()
+    {
+        release();
+    }
+
+    map_mode mode() const
+    {
+        return _mode;
+    }
+
+    size_type bit_count() const
+    {
+        return _bit_count;
+    }
+
+    size_type block_count() const
+    {
+        return block_count(_bit_count);
+    }
+
+    const block_type& operator[](size_type idx) const
+    {
+        return data()[idx];
+    }
+
+    /** Get a pointer to the contiguous array of \c block_count blocks. **/
+    const block_type* data() const
+    {
+        return reinterpret_cast<const block_type*>(static_cast<const char*>(_map) + _offset);
+    }
+
+    /** \copydoc data
+     *
+     *  \throws std::logic_error if this storage is \c map_mode::read_only. If this exception is actually thrown
+     *   depends on the \c LEEK_ASSERT settings.
+    **/
+    block_type* data()
+    {
+        assert_writable();
+        return reinterpret_cast<block_type*>(static_cast<char*>(_map) + _offset);
+    }
+
+    void prefetch(size_type idx) const
+    {
+        detail::prefetch(&data()[idx]);
+    }
+
+    void set_mask(size_type block_idx, const block_type& mask)
+    {
+        LEEK_ASSERT(block_idx < block_count(),
+                    out_of_range,
+                    ("Block index %zu is out of range for %zu blocks", block_idx, block_count())
+                   );
+        data()[block_idx] |= mask;
+    }
+
+    void and_mask(size_type block_idx, const block_type& mask)
+    {
+        LEEK_ASSERT(block_idx < block_count(),
+                    out_of_range,
+                    ("Block index %zu is out of range for %zu blocks", block_idx, block_count())
+                   );
+        data()[block_idx] &= mask;
+    }
+
+    void clear()
+    {
+        std::memset(data(), 0, block_count() * sizeof(block_type));
+    }
+
+    /** Write the changes made to the mapping back to the file. If \a wait is \c false, the write is only scheduled and
+     *  this returns immediately.
+    **/
+    void sync(bool wait = true)
+    {
+        if (_map_length != 0 && ::msync(_map, _map_length, wait ? MS_SYNC : MS_ASYNC) != 0)
+            throw std::system_error(errno, std::generic_category(), "Failed to sync mapped storage");
+    }
+
+private:
+    basic_mapped_storage(int fd, map_mode mode, size_type bit_count, size_type offset) :
+            _fd(fd),
+            _mode(mode),
+            _bit_count(bit_count),
+            _offset(offset),
+            _map_length(offset + block_count(bit_count) * sizeof(block_type)),
+            _map(nullptr)
+    { }
+
+    static void check_offset(size_type offset)
+    {
+        LEEK_ASSERT(offset % alignof(block_type) == 0,
+                    invalid_argument,
+                    ("Offset %zu is not aligned for blocks of %zu bytes", offset, alignof(block_type))
+                   );
+    }
+
+    void map(const std::string& path)
+    {
+        if (_map_length == 0)
+            return;
+
+        int prot = _mode == map_mode::read_only ? PROT_READ : PROT_READ | PROT_WRITE;
+        void* ptr = ::mmap(nullptr, _map_length, prot, MAP_SHARED, _fd, 0);
+        if (ptr == MAP_FAILED)
+            throw std::system_error(errno, std::generic_category(), "Failed to map " + path);
+        _map = ptr;
+    }
+
+    void assert_writable() const
+    {
+        LEEK_ASSERT(_mode == map_mode::read_write,
+                    logic_error,
+                    ("Cannot modify mapped storage opened as read_only")
+                   );
+    }
+
+    void release()
+    {
+        if (_map)
+            ::munmap(_map, _map_length);
+        if (_fd >= 0)
+            ::close(_fd);
+        _map = nullptr;
+        _fd  = -1;
+    }
+
+private:
+    int       _fd;
+    map_mode  _mode;
+    size_type _bit_count;
+    size_type _offset;
+    size_type _map_length;
+    void*     _map;
+};
+
+/** \see basic_mapped_storage **/
+using mapped_storage = basic_mapped_storage<>;
+
+/** \} **/
+
+}
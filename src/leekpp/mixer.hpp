@@ -4,17 +4,120 @@
 #include <cstdint>
 #include <functional>
 #include <random>
+#include <type_traits>
+#include <utility>
 
 #include "assert.hpp"
+#include "hash.hpp"
 
 namespace leekpp
 {
 
+namespace detail
+{
+
+/** The 64-bit finalizer from MurmurHash3. This is used to spread the output of hash functions like \c std::hash, which
+ *  is often the identity function for integers, across all 64 bits.
+**/
+inline std::uint64_t mix64(std::uint64_t x)
+{
+    x ^= x >> 33;
+    x *= 0xff51afd7ed558ccdULL;
+    x ^= x >> 33;
+    x *= 0xc4ceb9fe1a85ec53ULL;
+    x ^= x >> 33;
+    return x;
+}
+
+/** Map \a x onto the range [0, \a range) with a multiply and shift instead of a modulo, as described by Daniel Lemire in
+ *  [A fast alternative to the modulo reduction](https://lemire.me/blog/2016/06/27/a-fast-alternative-to-the-modulo-reduction/).
+ *  This uses the high bits of \a x, so \a x should be well-mixed.
+**/
+inline std::uint64_t reduce(std::uint64_t x, std::uint64_t range)
+{
+#if defined(__SIZEOF_INT128__)
+    return std::uint64_t((static_cast<unsigned __int128>(x) * range) >> 64);
+#else
+    std::uint64_t x_lo = x & 0xffffffffULL, x_hi = x >> 32;
+    std::uint64_t r_lo = range & 0xffffffffULL, r_hi = range >> 32;
+    std::uint64_t lo_lo = x_lo * r_lo;
+    std::uint64_t hi_lo = x_hi * r_lo;
+    std::uint64_t lo_hi = x_lo * r_hi;
+    std::uint64_t cross = (lo_lo >> 32) + (hi_lo & 0xffffffffULL) + lo_hi;
+    return x_hi * r_hi + (hi_lo >> 32) + (cross >> 32);
+#endif
+}
+
+inline std::uint64_t rotate_left(std::uint64_t x, unsigned shift)
+{
+    return (x << shift) | (x >> (64 - shift));
+}
+
+/** Does \c TMixer have a transparent \c hash_type (one defining \c is_transparent), so it can be created from values
+ *  of types other than the one it mixes?
+**/
+template <typename TMixer>
+class has_transparent_hash
+{
+    template <typename UMixer>
+    static auto check(UMixer*)
+            -> decltype(std::declval<typename UMixer::hash_type::is_transparent*>(), std::true_type());
+
+    static std::false_type check(...);
+
+public:
+    static constexpr bool value = decltype(check(static_cast<TMixer*>(nullptr)))::value;
+};
+
+/** Does \c TMixer provide a \c round_bit_count function? If so, it only supports some bit counts. **/
+template <typename TMixer>
+class has_round_bit_count
+{
+    template <typename UMixer>
+    static auto check(UMixer*) -> decltype(UMixer::round_bit_count(std::size_t(0)), std::true_type());
+
+    static std::false_type check(...);
+
+public:
+    static constexpr bool value = decltype(check(static_cast<TMixer*>(nullptr)))::value;
+};
+
+/** Get the smallest bit count of at least \a bit_count which \c TMixer supports (see \c TMixer::round_bit_count). **/
+template <typename TMixer>
+typename std::enable_if<has_round_bit_count<TMixer>::value, std::size_t>::type
+round_bit_count(std::size_t bit_count)
+{
+    return TMixer::round_bit_count(bit_count);
+}
+
+/** Mixers without \c round_bit_count support any bit count. **/
+template <typename TMixer>
+typename std::enable_if<!has_round_bit_count<TMixer>::value, std::size_t>::type
+round_bit_count(std::size_t bit_count)
+{
+    return bit_count;
+}
+
+/** Does \c TMixer provide a \c block_mask function? If so, all of its bits land in a single storage block. **/
+template <typename TMixer>
+class has_block_mask
+{
+    template <typename UMixer>
+    static auto check(UMixer* mixer) -> decltype(mixer->block_mask(std::size_t(0)), std::true_type());
+
+    static std::false_type check(...);
+
+public:
+    static constexpr bool value = decltype(check(static_cast<TMixer*>(nullptr)))::value;
+};
+
+}
+
 /** \addtogroup Mixer
  *  \{
  *
  *  A \e mixer is responsible for transforming an input type \c T into a sequence of bit indices for use in a Bloom
- *  filter. A mixer is a fusion of \c std::hash and a psuedo random number generator.
+ *  filter. A mixer is a fusion of a hash function (\c leekpp::hash by default) and a psuedo random number generator.
  *
  *  ### Requirements
  *
@@ -30,10 +133,26 @@ namespace leekpp
  *  | `M::block_bits` -> `size_t`   | How many bits live in a block? A value of 0 means this is a non-blocking mixer.  |
  *  | `m()` -> `size_t`             | Generate the next index in the sequence.                                         |
  *  | `m.base_offset()` -> `size_t` | Get the bit index of the start of the group this mixer will generate. (Only if `block_bits > 0`) |
+ *  | `m.block_mask(k)` -> `B`      | Get all `k` bits as a mask of the single storage block at `base_offset()`. (Optional) |
+ *  | `M::hash_type`                | The hash function. If it defines `is_transparent`, `M(u, sz)` accepts any `u` it can hash. (Optional) |
+ *  | `M(h, sz)`                    | Create a mixer from a \c hashed_value. This must be the same as `M(t, sz)` when `h` is `M::hash_type()(t)`. (Optional) |
+ *  | `M::round_bit_count(sz)` -> `size_t` | Get the smallest bit count of at least `sz` this mixer supports. (Optional) |
  *
  *  \see basic_mixer
 **/
 
+/** The output of a mixer's \c hash_type for some value, computed ahead of time. Creating a mixer from this skips
+ *  hashing, so a value can be hashed once and then checked against any number of filters whose mixers share a
+ *  \c hash_type, even when they have different sizes or mixer types.
+ *
+ *  \see basic_bloom_filter::hash_value
+ *  \see basic_bloom_filter::count_hash
+**/
+struct hashed_value
+{
+    std::uint64_t value;
+};
+
 /** A hash and LC-RNG based mixing function. The hash function is used to transform inputs of type \c T into a number,
  *  which is used to seed the \c TRng. The next index is generated by asking the PRNG to generate the next value.
  *
@@ -43,13 +162,14 @@ namespace leekpp
  *  \tparam TRng A psuedo random number generator used to generate values.
 **/
 template <typename T,
-          typename THash = std::hash<T>,
+          typename THash = hash<T>,
           typename TRng  = std::minstd_rand
          >
-class basic_mixer :
-        private THash
+class basic_mixer
 {
 public:
+    using hash_type = THash;
+
     /** How many bits live in a block? A value of 0 means this mixer does not generate bit indices in groups.
      *
      *  \see basic_cache_aligned_mixer
@@ -57,10 +177,18 @@ public:
     static constexpr std::size_t block_bits = 0;
 
 public:
-    explicit basic_mixer(const T& val, std::size_t bit_count, const THash& hash = THash()) :
-            THash(hash),
+    /** Create a mixer for \a val. This accepts any \c U which \c THash can hash, such as a \c std::string_view
+     *  when \c T is \c std::string.
+    **/
+    template <typename U>
+    explicit basic_mixer(const U& val, std::size_t bit_count, const THash& hash = THash()) :
+            basic_mixer(hashed_value{ std::uint64_t(hash(val)) }, bit_count)
+    { }
+
+    /** Create a mixer from the output of \c THash for a value, which was computed ahead of time. **/
+    explicit basic_mixer(const hashed_value& hashed, std::size_t bit_count) :
             _bit_count(bit_count),
-            _rng(THash::operator()(val))
+            _rng(hashed.value)
     { }
     
     std::size_t operator()()
@@ -92,21 +220,26 @@ private:
 **/
 template <typename    T,
           std::size_t KAlignBits = 512,
-          typename    THash = std::hash<T>,
+          typename    THash = hash<T>,
           typename    TRng  = std::minstd_rand
          >
-class basic_cache_aligned_mixer :
-        private THash
+class basic_cache_aligned_mixer
 {
 public:
+    using hash_type = THash;
+
     static constexpr std::size_t block_bits = KAlignBits;
     static_assert(block_bits > 1, "Alignment too low");
 
 public:
     
-    explicit basic_cache_aligned_mixer(const T& val, std::size_t bit_count, const THash& hash = THash()) :
-            THash(hash),
-            _rng(THash::operator()(val)),
+    template <typename U>
+    explicit basic_cache_aligned_mixer(const U& val, std::size_t bit_count, const THash& hash = THash()) :
+            basic_cache_aligned_mixer(hashed_value{ std::uint64_t(hash(val)) }, bit_count)
+    { }
+
+    explicit basic_cache_aligned_mixer(const hashed_value& hashed, std::size_t bit_count) :
+            _rng(hashed.value),
             _base_offset((_rng() % (bit_count / KAlignBits)) * KAlignBits)
     {
         LEEK_ASSERT(bit_count % KAlignBits == 0,
@@ -130,6 +263,349 @@ private:
     std::size_t _base_offset;
 };
 
+/** A mixing function which generates all indices from a single 64-bit hash with the "enhanced double hashing" of
+ *  Kirsch and Mitzenmacher in
+ *  [Less Hashing, Same Performance: Building a Better Bloom Filter](https://www.eecs.harvard.edu/~michaelm/postscripts/rsa2008.pdf).
+ *  Compared to \c basic_mixer, generating the next index is two additions and a multiply instead of a PRNG step and a
+ *  64-bit division. The running hash and step are still a serial chain, but it is two single-cycle additions long, so
+ *  the multiply and the memory access of each index overlap with computing the next one.
+ *
+ *  \tparam T The type of values this mixer should accept.
+ *  \tparam THash Function to use to transform a \c T into an integer. The result does not need to be well-mixed.
+**/
+template <typename T,
+          typename THash = hash<T>
+         >
+class basic_double_hash_mixer
+{
+public:
+    using hash_type = THash;
+
+    static constexpr std::size_t block_bits = 0;
+
+public:
+    template <typename U>
+    explicit basic_double_hash_mixer(const U& val, std::size_t bit_count, const THash& hash = THash()) :
+            basic_double_hash_mixer(hashed_value{ std::uint64_t(hash(val)) }, bit_count)
+    { }
+
+    explicit basic_double_hash_mixer(const hashed_value& hashed, std::size_t bit_count) :
+            _bit_count(bit_count),
+            _hash(detail::mix64(hashed.value)),
+            _delta(detail::mix64(_hash ^ 0x9e3779b97f4a7c15ULL)),
+            _step(0)
+    { }
+
+    std::size_t operator()()
+    {
+        auto out = detail::reduce(_hash, _bit_count);
+        _hash  += _delta;
+        _delta += ++_step;
+        return std::size_t(out);
+    }
+
+private:
+    std::uint64_t _bit_count;
+    std::uint64_t _hash;
+    std::uint64_t _delta;
+    std::uint64_t _step;
+};
+
+/** The cache-friendly grouping of \c basic_cache_aligned_mixer with the index generation of
+ *  \c basic_double_hash_mixer. The group is selected by the high bits of the hash, while the start and step of the
+ *  indices inside of the group come from two differently salted remixes of it. Since \c KAlignBits is a compile-time
+ *  constant, reducing into the group is a single shift when it is a power of 2.
+ *
+ *  \tparam T The type of values this mixer should accept.
+ *  \tparam KAlignBits The bit alignment used to group index sequences (see \c basic_cache_aligned_mixer).
+ *  \tparam THash Function to use to transform a \c T into an integer. The result does not need to be well-mixed.
+**/
+template <typename    T,
+          std::size_t KAlignBits = 512,
+          typename    THash = hash<T>
+         >
+class basic_cache_aligned_double_hash_mixer
+{
+public:
+    using hash_type = THash;
+
+    static constexpr std::size_t block_bits = KAlignBits;
+    static_assert(block_bits > 1, "Alignment too low");
+
+public:
+    template <typename U>
+    explicit basic_cache_aligned_double_hash_mixer(const U& val, std::size_t bit_count, const THash& hash = THash()) :
+            basic_cache_aligned_double_hash_mixer(hashed_value{ std::uint64_t(hash(val)) }, bit_count)
+    { }
+
+    explicit basic_cache_aligned_double_hash_mixer(const hashed_value& hashed, std::size_t bit_count) :
+            _base_offset(0),
+            _hash(detail::mix64(hashed.value)),
+            _delta(detail::mix64(_hash ^ 0xc2b2ae3d27d4eb4fULL) | 1),
+            _step(0)
+    {
+        LEEK_ASSERT(bit_count % KAlignBits == 0,
+                    invalid_argument,
+                    ("The bit count %zu is not divisible by alignment %zu", bit_count, KAlignBits)
+                   );
+        _base_offset = std::size_t(detail::reduce(_hash, bit_count / KAlignBits)) * KAlignBits;
+        _hash = detail::mix64(_hash ^ 0x9e3779b97f4a7c15ULL);
+    }
+
+    std::size_t base_offset() const
+    {
+        return _base_offset;
+    }
+
+    std::size_t operator()()
+    {
+        auto out = detail::reduce(_hash, KAlignBits);
+        _hash  += _delta;
+        _delta += ++_step;
+        return _base_offset + std::size_t(out);
+    }
+
+private:
+    std::size_t   _base_offset;
+    std::uint64_t _hash;
+    std::uint64_t _delta;
+    std::uint64_t _step;
+};
+
+/** A mixing function which places all bits for a value in a single 64-bit word. This is the most extreme form of
+ *  blocking: inserting is a single \c set_mask with a precomputed mask and testing is a single load and compare, with
+ *  no loops over storage. The bit positions come 6 bits at a time from a remix of the hash, instead of stepping a PRNG;
+ *  every 10 positions, the hash is remixed with a new salt.
+ *
+ *  This speed comes at a price in FPR, since with only 64 bits per block, the number of elements that land in each
+ *  block varies a lot and bits within a word often collide. With \c bloom_filter_params::create_ideal sizing for a 5%
+ *  goal, expect an FPR closer to 6.3%; a 1% goal gives closer to 2.4%. This penalty is modeled exactly by
+ *  \c bloom_filter_params::expected_blocked_fpr with a \c block_bits of 64. If you need the lower FPR, add bits. This
+ *  mixer is best for small filters which live in L1 or L2 cache, where the cost of a lookup is dominated by arithmetic
+ *  instead of memory.
+ *
+ *  \tparam T The type of values this mixer should accept.
+ *  \tparam THash Function to use to transform a \c T into an integer. The result does not need to be well-mixed.
+**/
+template <typename T,
+          typename THash = hash<T>
+         >
+class basic_register_blocked_mixer
+{
+public:
+    using hash_type = THash;
+
+    static constexpr std::size_t block_bits = 64;
+
+public:
+    template <typename U>
+    explicit basic_register_blocked_mixer(const U& val, std::size_t bit_count, const THash& hash = THash()) :
+            basic_register_blocked_mixer(hashed_value{ std::uint64_t(hash(val)) }, bit_count)
+    { }
+
+    explicit basic_register_blocked_mixer(const hashed_value& hashed, std::size_t bit_count) :
+            _base_offset(0),
+            _hash(detail::mix64(hashed.value)),
+            _bits(0),
+            _bits_left(0),
+            _round(0)
+    {
+        LEEK_ASSERT(bit_count % block_bits == 0,
+                    invalid_argument,
+                    ("The bit count %zu is not divisible by the word size %zu", bit_count, std::size_t(block_bits))
+                   );
+        _base_offset = std::size_t(detail::reduce(_hash, bit_count / block_bits)) * block_bits;
+    }
+
+    std::size_t base_offset() const
+    {
+        return _base_offset;
+    }
+
+    std::size_t operator()()
+    {
+        // Each round of draws comes from the full hash; remixing the 4 bits left over would leave only 16 states
+        if (_bits_left == 0)
+        {
+            _bits      = detail::mix64(_hash ^ (0x9e3779b97f4a7c15ULL * ++_round));
+            _bits_left = 64 / 6;
+        }
+        auto out = _bits & 63;
+        _bits >>= 6;
+        --_bits_left;
+        return _base_offset + std::size_t(out);
+    }
+
+    /** Get the mask of all \a num_hashes bits in the block at \c base_offset. This consumes the sequence, so it gives
+     *  the same bits as calling \c operator() \a num_hashes times.
+    **/
+    std::uint64_t block_mask(std::size_t num_hashes)
+    {
+        std::uint64_t mask = 0;
+        for (std::size_t count = 0; count < num_hashes; ++count)
+            mask |= std::uint64_t(1) << ((*this)() - _base_offset);
+        return mask;
+    }
+
+private:
+    std::size_t   _base_offset;
+    std::uint64_t _hash;
+    std::uint64_t _bits;
+    unsigned      _bits_left;
+    std::uint64_t _round;
+};
+
+/** A mixing function whose indices stay valid when a filter is folded (see \c basic_bloom_filter::fold). The bit count
+ *  must be a power of 2 and each index is the low bits of an enhanced double hash (as in \c basic_double_hash_mixer),
+ *  so reducing into the bit range is a mask instead of a division. Halving the bit count keeps the low bits of every
+ *  index, so a folded filter sets and tests exactly the bits that a filter created at the smaller size would.
+ *
+ *  \tparam T The type of values this mixer should accept.
+ *  \tparam THash Function to use to transform a \c T into an integer. The result does not need to be well-mixed.
+**/
+template <typename T,
+          typename THash = hash<T>
+         >
+class basic_foldable_mixer
+{
+public:
+    using hash_type = THash;
+
+    static constexpr std::size_t block_bits = 0;
+
+public:
+    /** Get the power of 2 at or above \a bit_count. **/
+    static std::size_t round_bit_count(std::size_t bit_count)
+    {
+        std::size_t out = 1;
+        while (out < bit_count)
+            out <<= 1;
+        return out;
+    }
+
+    template <typename U>
+    explicit basic_foldable_mixer(const U& val, std::size_t bit_count, const THash& hash = THash()) :
+            basic_foldable_mixer(hashed_value{ std::uint64_t(hash(val)) }, bit_count)
+    { }
+
+    explicit basic_foldable_mixer(const hashed_value& hashed, std::size_t bit_count) :
+            _mask(bit_count - 1),
+            _hash(detail::mix64(hashed.value)),
+            _delta(detail::mix64(_hash ^ 0x9e3779b97f4a7c15ULL) | 1),
+            _step(0)
+    {
+        LEEK_ASSERT(bit_count != 0 && (bit_count & (bit_count - 1)) == 0,
+                    invalid_argument,
+                    ("The bit count %zu is not a power of 2", bit_count)
+                   );
+    }
+
+    std::size_t operator()()
+    {
+        auto out = _hash & _mask;
+        _hash  += _delta;
+        _delta += ++_step;
+        return std::size_t(out);
+    }
+
+private:
+    std::uint64_t _mask;
+    std::uint64_t _hash;
+    std::uint64_t _delta;
+    std::uint64_t _step;
+};
+
+/** Identifies a hash function inside of serialized filters, so a filter built with one hash is never loaded and then
+ *  queried with another. Specialize this with a unique \c value to serialize filters that use your own hash.
+**/
+template <typename THash>
+struct hash_id;
+
+template <typename T>
+struct hash_id<std::hash<T>> :
+        std::integral_constant<std::uint32_t, 1>
+{ };
+
+template <typename T>
+struct hash_id<hash<T>> :
+        std::integral_constant<std::uint32_t, 2>
+{ };
+
+namespace detail
+{
+
+constexpr std::uint64_t make_mixer_id(std::uint64_t family, std::uint32_t hash, std::size_t block_bits)
+{
+    return (family << 48) | (std::uint64_t(hash) << 32) | std::uint64_t(block_bits);
+}
+
+}
+
+/** Identifies a mixer (including its hash function and block size) inside of serialized filters. Specialize this with
+ *  a unique \c value to serialize filters that use your own mixer. Note that the type \c T being mixed is not part of
+ *  the identity.
+ *
+ *  \see hash_id
+**/
+template <typename TMixer>
+struct mixer_id;
+
+template <typename T, typename THash>
+struct mixer_id<basic_mixer<T, THash, std::minstd_rand>> :
+        std::integral_constant<std::uint64_t, detail::make_mixer_id(1, hash_id<THash>::value, 0)>
+{ };
+
+template <typename T, std::size_t KAlignBits, typename THash>
+struct mixer_id<basic_cache_aligned_mixer<T, KAlignBits, THash, std::minstd_rand>> :
+        std::integral_constant<std::uint64_t, detail::make_mixer_id(2, hash_id<THash>::value, KAlignBits)>
+{ };
+
+template <typename T, typename THash>
+struct mixer_id<basic_double_hash_mixer<T, THash>> :
+        std::integral_constant<std::uint64_t, detail::make_mixer_id(3, hash_id<THash>::value, 0)>
+{ };
+
+template <typename T, std::size_t KAlignBits, typename THash>
+struct mixer_id<basic_cache_aligned_double_hash_mixer<T, KAlignBits, THash>> :
+        std::integral_constant<std::uint64_t, detail::make_mixer_id(4, hash_id<THash>::value, KAlignBits)>
+{ };
+
+template <typename T, typename THash>
+struct mixer_id<basic_register_blocked_mixer<T, THash>> :
+        std::integral_constant<std::uint64_t, detail::make_mixer_id(5, hash_id<THash>::value, 64)>
+{ };
+
+template <typename T, typename THash>
+struct mixer_id<basic_foldable_mixer<T, THash>> :
+        std::integral_constant<std::uint64_t, detail::make_mixer_id(6, hash_id<THash>::value, 0)>
+{ };
+
+/** Can a filter using \c TMixer be folded (see \c basic_bloom_filter::fold)? This holds when the index of each bit
+ *  at \f$m / f\f$ bits is the index at \f$m\f$ bits modulo \f$m / f\f$. Reducing a sequence which does not
+ *  depend on the bit count with \c % has this property, since
+ *  \f$(x \bmod m) \bmod \frac{m}{f} = x \bmod \frac{m}{f}\f$; the multiply-shift \c detail::reduce does not.
+ *  Specialize this for your own mixers which fold.
+**/
+template <typename TMixer>
+struct is_foldable_mixer :
+        std::false_type
+{ };
+
+template <typename T, typename THash>
+struct is_foldable_mixer<basic_mixer<T, THash, std::minstd_rand>> :
+        std::true_type
+{ };
+
+template <typename T, std::size_t KAlignBits, typename THash>
+struct is_foldable_mixer<basic_cache_aligned_mixer<T, KAlignBits, THash, std::minstd_rand>> :
+        std::true_type
+{ };
+
+template <typename T, typename THash>
+struct is_foldable_mixer<basic_foldable_mixer<T, THash>> :
+        std::true_type
+{ };
+
 /** \} **/
 
 }
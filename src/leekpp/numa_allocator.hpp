@@ -0,0 +1,165 @@
+#pragma once
+
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <type_traits>
+
+#if defined(__linux__)
+#   include <sys/mman.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
+namespace leekpp
+{
+
+/** \addtogroup Storage
+ *  \{
+**/
+
+namespace detail
+{
+
+#if defined(__linux__)
+
+/** Ask the kernel to place the pages of [\a ptr, \a ptr + \a bytes) on NUMA node \a node when they are first touched.
+ *  This is \c mbind with \c MPOL_PREFERRED, called directly so there is no dependency on libnuma; the pages fall back
+ *  to other nodes when \a node is out of memory.
+ *
+ *  \returns \c true if the policy was set; \c false if the kernel has no NUMA support, \a node does not exist or the
+ *   call is not allowed (as in many containers). In that case, pages are placed by the usual first-touch policy.
+**/
+inline bool numa_bind(void* ptr, std::size_t bytes, int node)
+{
+#if defined(SYS_mbind)
+    constexpr int         preferred  = 1; // MPOL_PREFERRED from <numaif.h>
+    constexpr std::size_t mask_words = 16;
+    constexpr std::size_t word_bits  = sizeof(unsigned long) * 8;
+
+    if (node < 0 || std::size_t(node) >= mask_words * word_bits)
+        return false;
+    unsigned long mask[mask_words] = {};
+    mask[std::size_t(node) / word_bits] = 1UL << (std::size_t(node) % word_bits);
+    return ::syscall(SYS_mbind, ptr, bytes, preferred, mask, mask_words * word_bits + 1, 0) == 0;
+#else
+    static_cast<void>(ptr);
+    static_cast<void>(bytes);
+    static_cast<void>(node);
+    return false;
+#endif
+}
+
+inline std::size_t page_size()
+{
+    static const long size = ::sysconf(_SC_PAGESIZE);
+    return size > 0 ? std::size_t(size) : 4096;
+}
+
+#endif
+
+}
+
+/** An allocator which places its memory on a chosen NUMA node. Each allocation is mapped separately and bound to the
+ *  node before anything touches it, so the pages land on the node no matter which thread zeroes them.
+ *
+ *  Binding is best-effort: where the kernel does not support or allow \c mbind (or on platforms other than Linux), this
+ *  allocates regular memory, which the first-touch policy places on the node of the thread which zeroes it. See
+ *  \c basic_numa_sharded_bloom_filter, which does that zeroing from a thread on the right node for this reason.
+ *
+ *  Since every allocation is a whole number of pages, this is meant for large arrays such as filter storage (see
+ *  \c numa_storage), not for many small objects.
+ *
+ *  \tparam T The type of value to allocate.
+**/
+template <typename T>
+class numa_allocator
+{
+public:
+    using value_type = T;
+    using size_type  = std::size_t;
+
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+
+    template <typename U>
+    struct rebind
+    {
+        using other = numa_allocator<U>;
+    };
+
+public:
+    /** Create an allocator for node \a node. A negative node means no preference. **/
+    explicit numa_allocator(int node = -1) :
+            _node(node)
+    { }
+
+    template <typename U>
+    numa_allocator(const numa_allocator<U>& src) :
+            _node(src.node())
+    { }
+
+    /** Get the node this allocator places memory on, or -1 for no preference. **/
+    int node() const
+    {
+        return _node;
+    }
+
+    T* allocate(size_type count)
+    {
+        if (count > std::numeric_limits<size_type>::max() / sizeof(T))
+            throw std::bad_array_new_length();
+
+#if defined(__linux__)
+        auto length = mapped_length(count);
+        void* ptr = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (ptr == MAP_FAILED)
+            throw std::bad_alloc();
+        if (_node >= 0)
+            detail::numa_bind(ptr, length, _node);
+        return static_cast<T*>(ptr);
+#else
+        return static_cast<T*>(::operator new(count * sizeof(T)));
+#endif
+    }
+
+    void deallocate(T* ptr, size_type count)
+    {
+#if defined(__linux__)
+        ::munmap(ptr, mapped_length(count));
+#else
+        static_cast<void>(count);
+        ::operator delete(ptr);
+#endif
+    }
+
+private:
+#if defined(__linux__)
+    static std::size_t mapped_length(size_type count)
+    {
+        auto page  = detail::page_size();
+        auto bytes = count == 0 ? 1 : count * sizeof(T);
+        return (bytes + page - 1) / page * page;
+    }
+#endif
+
+private:
+    int _node;
+};
+
+template <typename T, typename U>
+bool operator==(const numa_allocator<T>& a, const numa_allocator<U>& b)
+{
+    return a.node() == b.node();
+}
+
+template <typename T, typename U>
+bool operator!=(const numa_allocator<T>& a, const numa_allocator<U>& b)
+{
+    return !(a == b);
+}
+
+/** \} **/
+
+}
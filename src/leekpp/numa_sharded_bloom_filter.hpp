@@ -0,0 +1,415 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined(__linux__)
+#   include <sched.h>
+#endif
+
+#include "assert.hpp"
+#include "bloom_filter.hpp"
+#include "mixer.hpp"
+#include "storage.hpp"
+
+namespace leekpp
+{
+
+namespace detail
+{
+
+/** Call \a add with each number in a Linux list format string such as <tt>"0-3,8,10-11"</tt>, as found in the
+ *  \c /sys/devices/system/node files.
+**/
+template <typename FAdd>
+void parse_id_list(const std::string& list, FAdd add)
+{
+    const char* pos = list.c_str();
+    while (*pos >= '0' && *pos <= '9')
+    {
+        char* end   = nullptr;
+        auto  first = std::strtoul(pos, &end, 10);
+        auto  last  = first;
+        if (*end == '-')
+            last = std::strtoul(end + 1, &end, 10);
+        for (auto id = first; id <= last; ++id)
+            add(std::size_t(id));
+
+        pos = *end == ',' ? end + 1 : end;
+    }
+}
+
+/** Read the first line of the file at \a path, which is empty if it could not be read. **/
+inline std::string read_first_line(const std::string& path)
+{
+    std::ifstream stream(path);
+    std::string line;
+    std::getline(stream, line);
+    return line;
+}
+
+/** Get the number of NUMA nodes on this machine, which is 1 where that can not be determined. **/
+inline std::size_t numa_node_count()
+{
+    std::size_t count = 1;
+    parse_id_list(read_first_line("/sys/devices/system/node/online"),
+                  [&] (std::size_t node) { count = node + 1 > count ? node + 1 : count; }
+                 );
+    return count;
+}
+
+/** Restrict the calling thread to the CPUs of NUMA node \a node.
+ *
+ *  \returns \c true if the thread was moved; \c false if the node is not known or this is not supported.
+**/
+inline bool bind_thread_to_numa_node(std::size_t node)
+{
+#if defined(__linux__) && defined(CPU_SET)
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    bool any = false;
+    parse_id_list(read_first_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"),
+                  [&] (std::size_t cpu)
+                  {
+                      if (cpu < CPU_SETSIZE)
+                      {
+                          CPU_SET(cpu, &cpus);
+                          any = true;
+                      }
+                  }
+                 );
+    return any && ::sched_setaffinity(0, sizeof cpus, &cpus) == 0;
+#else
+    static_cast<void>(node);
+    return false;
+#endif
+}
+
+/** Call \a func with each node in [0, \a node_count) on a new thread bound to that node (see
+ *  \c bind_thread_to_numa_node), so anything it allocates and touches first lands on the node. If any call throws,
+ *  the first exception is rethrown after all threads have finished.
+**/
+template <typename FWork>
+void run_on_numa_nodes(std::size_t node_count, FWork func)
+{
+    std::vector<std::exception_ptr> errors(node_count);
+    std::vector<std::thread> workers;
+    workers.reserve(node_count);
+    for (std::size_t node = 0; node < node_count; ++node)
+    {
+        workers.emplace_back([&, node]
+                             {
+                                 try
+                                 {
+                                     bind_thread_to_numa_node(node);
+                                     func(node);
+                                 }
+                                 catch (...)
+                                 {
+                                     errors[node] = std::current_exception();
+                                 }
+                             }
+                            );
+    }
+    for (auto& worker : workers)
+        worker.join();
+
+    for (const auto& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+}
+
+}
+
+/** \addtogroup Filter
+ *  \{
+**/
+
+/** Who answers the lookups of \c basic_numa_sharded_bloom_filter::count_many? **/
+enum class numa_lookup
+{
+    /** The calling thread answers every lookup, wherever the shard it reads lives. **/
+    calling_thread,
+    /** The values are hashed on the calling thread, then one thread on each node answers the lookups for its shards,
+     *  so every read is from local memory. Starting the threads costs tens of microseconds, so this is for batches of
+     *  many thousands of values.
+    **/
+    node_threads,
+};
+
+/** A Bloom filter split into shards which each live on one NUMA node of a multi-socket machine. A single large filter
+ *  lives on the node that first touched it, so on a two-node machine, half of all lookups cross the interconnect.
+ *
+ *  Each value is hashed once and routed by the high bits of a remix of its hash to one of \f$S\f$ shards, which is a
+ *  \c basic_bloom_filter with \f$m / S\f$ bits. Shard \f$i\f$ is on node \f$i \bmod N\f$: its storage is allocated with
+ *  a \c numa_allocator for that node and zeroed by a thread bound to that node, so its pages are placed correctly with
+ *  either \c mbind or, where that is not available, the first-touch policy. On a machine with one node, this is an
+ *  ordinary sharded filter.
+ *
+ *  With \c numa_thread_safe_storage (the default), any number of threads can \c insert and \c count at once. A thread
+ *  which only ever looks up values in one node's shards can be bound to that node with
+ *  \c detail::bind_thread_to_numa_node; for batches, \c count_many with \c numa_lookup::node_threads does that for you.
+ *
+ *  \tparam T The type of value this Bloom filter is meant to store.
+ *  \tparam TMixer A mixing function (see \c basic_mixer). It must be constructible from a \c hashed_value.
+ *  \tparam TStorage The storage of each shard. It must be constructible from a bit count and an allocator which is
+ *   constructible from a node number, as \c numa_storage and \c numa_thread_safe_storage are.
+**/
+template <typename T,
+          typename TMixer   = basic_mixer<T>,
+          typename TStorage = numa_thread_safe_storage
+         >
+class basic_numa_sharded_bloom_filter
+{
+public:
+    using value_type     = T;
+    using mixer_type     = TMixer;
+    using storage_type   = TStorage;
+    using filter_type    = basic_bloom_filter<T, TMixer, TStorage>;
+    using allocator_type = typename storage_type::allocator_type;
+    using size_type      = std::size_t;
+
+public:
+    /** Create an instance.
+     *
+     *  \param params The parameters of the filter as a whole. Each shard gets \f$m / S\f$ bits, rounded up to a count
+     *   the mixer supports (if it has \c round_bit_count) and to a multiple of \c mixer_type::block_bits.
+     *  \param shard_count The number of shards (\f$S\f$). Using a multiple of \a node_count gives each node the same
+     *   share of the filter.
+     *  \param node_count The number of NUMA nodes to spread the shards over (\f$N\f$). By default, this is every node
+     *   of this machine.
+     *  \throws std::invalid_argument if either count is 0. If this exception is actually thrown depends on the
+     *   \c LEEK_ASSERT settings.
+    **/
+    explicit basic_numa_sharded_bloom_filter(const bloom_filter_params& params,
+                                             size_type                  shard_count,
+                                             size_type                  node_count = detail::numa_node_count()
+                                            ) :
+            _node_count(node_count)
+    {
+        LEEK_ASSERT(shard_count > 0, invalid_argument, ("shard_count must be at least 1"));
+        LEEK_ASSERT(node_count > 0, invalid_argument, ("node_count must be at least 1"));
+
+        auto shard_bits = detail::round_bit_count<mixer_type>((params.bit_count + shard_count - 1) / shard_count);
+        if (mixer_type::block_bits > 0 && shard_bits % mixer_type::block_bits != 0)
+            shard_bits += mixer_type::block_bits - shard_bits % mixer_type::block_bits;
+        bloom_filter_params shard_params(shard_bits, params.num_hashes);
+
+        // Each node builds its own shards, so the zeroing of their storage is the first touch from that node
+        std::vector<std::vector<filter_type>> node_shards(node_count);
+        detail::run_on_numa_nodes(node_count,
+                                  [&] (size_type node)
+                                  {
+                                      for (auto shard_idx = node; shard_idx < shard_count; shard_idx += node_count)
+                                      {
+                                          storage_type storage(shard_bits, allocator_type(int(node)));
+                                          node_shards[node].emplace_back(shard_params, std::move(storage));
+                                      }
+                                  }
+                                 );
+        _shards.reserve(shard_count);
+        for (size_type shard_idx = 0; shard_idx < shard_count; ++shard_idx)
+            _shards.push_back(std::move(node_shards[shard_idx % node_count][shard_idx / node_count]));
+    }
+
+    /** Create an instance with \a shard_count shards (by default, one per node of this machine), each of which is an
+     *  ideally-sized filter for its share of \a expected_elements.
+    **/
+    static basic_numa_sharded_bloom_filter create_ideal(double      desired_fpr,
+                                                        std::size_t expected_elements,
+                                                        size_type   shard_count = detail::numa_node_count()
+                                                       )
+    {
+        shard_count = shard_count == 0 ? 1 : shard_count;
+        auto shard_elements = (expected_elements + shard_count - 1) / shard_count;
+        auto shard_params   = filter_type::create_ideal(desired_fpr, shard_elements).params();
+        return basic_numa_sharded_bloom_filter(bloom_filter_params(shard_params.bit_count * shard_count,
+                                                                   shard_params.num_hashes
+                                                                  ),
+                                               shard_count
+                                              );
+    }
+
+    basic_numa_sharded_bloom_filter(basic_numa_sharded_bloom_filter&&) = default;
+    basic_numa_sharded_bloom_filter& operator=(basic_numa_sharded_bloom_filter&&) = default;
+
+    /** Get the parameters of the filter as a whole: the bits of every shard and the hashes of each value. **/
+    bloom_filter_params params() const
+    {
+        return bloom_filter_params(_shards.front().params().bit_count * _shards.size(),
+                                   _shards.front().params().num_hashes
+                                  );
+    }
+
+    /** Get the number of shards. **/
+    size_type shard_count() const
+    {
+        return _shards.size();
+    }
+
+    /** Get the number of NUMA nodes the shards are spread over. **/
+    size_type node_count() const
+    {
+        return _node_count;
+    }
+
+    /** Get the shard at \a shard_idx. **/
+    const filter_type& shard(size_type shard_idx) const
+    {
+        return _shards[shard_idx];
+    }
+
+    /** Get the NUMA node which the shard at \a shard_idx lives on. **/
+    size_type shard_node(size_type shard_idx) const
+    {
+        return shard_idx % _node_count;
+    }
+
+    /** Get the index of the shard which values with the hash \a hashed are routed to. **/
+    size_type shard_index(const hashed_value& hashed) const
+    {
+        // The shards' mixers use the hash itself, so route by a differently-mixed hash to keep the two independent
+        return size_type(detail::reduce(detail::mix64(hashed.value ^ 0xd6e8feb86659fd93ULL), _shards.size()));
+    }
+
+    /** Calculate the expected false positive rate of this filter if \a elements distinct values were inserted, assuming
+     *  they are spread evenly over the shards.
+    **/
+    double expected_fpr(std::size_t elements) const
+    {
+        return _shards.front().expected_fpr((elements + _shards.size() - 1) / _shards.size());
+    }
+
+    /** Get the number of bits in this filter which are set to 1. **/
+    size_type set_bits() const
+    {
+        size_type count = 0;
+        for (const auto& shard : _shards)
+            count += shard.set_bits();
+        return count;
+    }
+
+    /** Estimate the number of distinct values which have been inserted into this filter. **/
+    size_type estimated_size() const
+    {
+        size_type count = 0;
+        for (const auto& shard : _shards)
+            count += shard.estimated_size();
+        return count;
+    }
+
+    /** \see basic_bloom_filter::hash_value **/
+    template <typename U>
+    static hashed_value hash_value(const U& x)
+    {
+        return filter_type::hash_value(x);
+    }
+
+    /** Test for the likely presence of \a x in this filter instance.
+     *
+     *  \returns \c 0 if the value is not present in this filter; \c 1 if it looks like the value is present.
+     *  \see basic_bloom_filter::count
+    **/
+    size_type count(const value_type& x) const
+    {
+        return count_hash(hash_value(x));
+    }
+
+    /** Insert the value \a x into the shard it routes to. **/
+    void insert(const value_type& x)
+    {
+        insert_hash(hash_value(x));
+    }
+
+    /** \see basic_bloom_filter::count_hash **/
+    size_type count_hash(const hashed_value& hashed) const
+    {
+        return _shards[shard_index(hashed)].count_hash(hashed);
+    }
+
+    /** \see basic_bloom_filter::insert_hash **/
+    void insert_hash(const hashed_value& hashed)
+    {
+        _shards[shard_index(hashed)].insert_hash(hashed);
+    }
+
+    /** Test each value in the range [\a first, \a last) for likely presence in this filter, writing the result of
+     *  \c count for each value to \a out.
+     *
+     *  \param lookup Who answers the lookups. With \c numa_lookup::node_threads, the results are written by the node
+     *   threads in no particular order, so \a out must be a random-access iterator to distinct elements (not a
+     *   <tt>std::vector<bool></tt>).
+     *  \returns \a out, advanced past the last written result.
+    **/
+    template <typename TForwardIterator, typename TOutputIterator>
+    TOutputIterator count_many(TForwardIterator first,
+                               TForwardIterator last,
+                               TOutputIterator  out,
+                               numa_lookup      lookup = numa_lookup::calling_thread
+                              ) const
+    {
+        if (lookup == numa_lookup::calling_thread || _node_count == 1)
+        {
+            for ( ; first != last; ++first, ++out)
+                *out = count(*first);
+            return out;
+        }
+        return count_many_on_nodes(first, last, out);
+    }
+
+    /** Insert each value in the range [\a first, \a last) into this filter. **/
+    template <typename TInputIterator>
+    void insert_many(TInputIterator first, TInputIterator last)
+    {
+        for ( ; first != last; ++first)
+            insert(*first);
+    }
+
+    /** Reset the contents of this filter to nothing. **/
+    void clear()
+    {
+        for (auto& shard : _shards)
+            shard.clear();
+    }
+
+private:
+    template <typename TForwardIterator, typename TOutputIterator>
+    TOutputIterator count_many_on_nodes(TForwardIterator first, TForwardIterator last, TOutputIterator out) const
+    {
+        std::vector<hashed_value> hashes;
+        std::vector<std::vector<size_type>> node_positions(_node_count);
+        for ( ; first != last; ++first)
+        {
+            hashes.push_back(hash_value(*first));
+            node_positions[shard_node(shard_index(hashes.back()))].push_back(hashes.size() - 1);
+        }
+
+        detail::run_on_numa_nodes(_node_count,
+                                  [&] (size_type node)
+                                  {
+                                      for (auto position : node_positions[node])
+                                          out[position] = count_hash(hashes[position]);
+                                  }
+                                 );
+        return std::next(out, hashes.size());
+    }
+
+private:
+    std::vector<filter_type> _shards;
+    size_type                _node_count;
+};
+
+template <typename T>
+using numa_sharded_bloom_filter = basic_numa_sharded_bloom_filter<T>;
+
+/** \} **/
+
+}
@@ -0,0 +1,295 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <iterator>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "bloom_filter.hpp"
+
+namespace leekpp
+{
+
+namespace detail
+{
+
+/** Get a reasonable default for the number of threads to use, which is never 0. **/
+inline std::size_t default_thread_count()
+{
+    auto count = std::thread::hardware_concurrency();
+    return count == 0 ? 1 : count;
+}
+
+/** Call \a func with each worker index in [0, \a threads) on its own thread, with worker 0 running on the calling
+ *  thread. If any worker throws, the first exception is rethrown after all workers have finished.
+**/
+template <typename FWork>
+void run_parallel(std::size_t threads, FWork func)
+{
+    std::vector<std::exception_ptr> errors(threads);
+    auto guarded = [&] (std::size_t worker)
+                   {
+                       try
+                       {
+                           func(worker);
+                       }
+                       catch (...)
+                       {
+                           errors[worker] = std::current_exception();
+                       }
+                   };
+
+    std::vector<std::thread> workers;
+    workers.reserve(threads);
+    for (std::size_t worker = 1; worker < threads; ++worker)
+        workers.emplace_back(guarded, worker);
+    guarded(0);
+    for (auto& worker : workers)
+        worker.join();
+
+    for (const auto& error : errors)
+        if (error)
+            std::rethrow_exception(error);
+}
+
+/** Split \a block_count blocks of \a block_bytes each into \a parts contiguous ranges which start on cache line
+ *  boundaries, so workers writing to neighboring ranges do not falsely share lines, and on multiples of
+ *  \a unit_blocks, so they do not share any other state of the storage. The boundaries are only where the memory
+ *  really has them if \a lead_blocks is right; get it from \c line_lead_blocks.
+ *
+ *  \param lead_blocks The number of blocks before the first cache line boundary, 0 if the blocks start on one. This
+ *   must be 0 unless \a unit_blocks is 1.
+ *  \param unit_blocks The number of consecutive blocks which must stay in one range (see
+ *   \c storage_partition_blocks).
+ *  \returns The first block of \a part; the range for \a part ends where the range for <tt>part + 1</tt> begins.
+**/
+inline std::size_t partition_begin(std::size_t block_count,
+                                   std::size_t block_bytes,
+                                   std::size_t parts,
+                                   std::size_t part,
+                                   std::size_t lead_blocks = 0,
+                                   std::size_t unit_blocks = 1
+                                  )
+{
+    auto line_blocks = block_bytes < cache_line_bytes ? cache_line_bytes / block_bytes : 1;
+    auto step        = line_blocks;
+    while (step % unit_blocks != 0)
+        step += line_blocks;
+
+    // Count steps from the boundary before the first block, which is step - lead_blocks blocks earlier
+    auto skipped = (step - lead_blocks % step) % step;
+    auto steps   = (block_count + skipped + step - 1) / step;
+    auto begin   = (steps * part / parts) * step;
+    begin = begin > skipped ? begin - skipped : 0;
+    return begin < block_count ? begin : block_count;
+}
+
+/** Get the number of blocks of \a storage before its first cache line boundary, for \c partition_begin. **/
+template <typename TStorage>
+typename std::enable_if<has_contiguous_data<TStorage>::value, std::size_t>::type
+line_lead_blocks(const TStorage& storage)
+{
+    using block_type = typename TStorage::block_type;
+
+    auto offset = std::size_t(reinterpret_cast<std::uintptr_t>(storage.data()) % cache_line_bytes);
+    if (offset == 0 || offset % sizeof(block_type) != 0)
+        return 0;
+    return (cache_line_bytes - offset) / sizeof(block_type);
+}
+
+/** Storage without contiguous data does not expose where its blocks are, so its partitions are aligned to its first
+ *  block, which is right for storage with line-aligned allocations.
+**/
+template <typename TStorage>
+typename std::enable_if<!has_contiguous_data<TStorage>::value, std::size_t>::type
+line_lead_blocks(const TStorage&)
+{
+    return 0;
+}
+
+/** Get where each of the \a parts ranges of \a storage which \c merge_parallel and \c insert_parallel give their
+ *  threads begins, followed by the block count.
+**/
+template <typename TStorage>
+std::vector<std::size_t> partition_bounds(const TStorage& storage, std::size_t parts)
+{
+    using block_type = typename TStorage::block_type;
+
+    auto unit_blocks = storage_partition_blocks<TStorage>::value;
+    auto lead_blocks = unit_blocks == 1 ? line_lead_blocks(storage) : 0;
+    std::vector<std::size_t> out(parts + 1);
+    for (std::size_t part = 0; part <= parts; ++part)
+        out[part] = partition_begin(storage.block_count(), sizeof(block_type), parts, part, lead_blocks, unit_blocks);
+    return out;
+}
+
+/** The number of values each worker hashes per round of \c insert_parallel. The (block, mask) pairs for a round are
+ *  buffered in memory, so this bounds the extra memory to a few MiB per worker.
+**/
+static constexpr std::size_t parallel_build_round = std::size_t(1) << 16;
+
+}
+
+/** \addtogroup Filter
+ *  \{
+**/
+
+/** Add the contents of every filter in [\a first, \a last) to \a dest, using \a threads threads. The block array is
+ *  split into one disjoint range per thread and each thread merges its range from all of the sources, so no
+ *  synchronization is needed between threads, even when \a dest does not use thread-safe storage.
+ *
+ *  \tparam TBloomFilter A \c basic_bloom_filter whose storage declares that threads can write disjoint blocks of it at
+ *   the same time (see \c insert_parallel).
+ *  \tparam TForwardIterator An iterator over filters compatible with \c TBloomFilter (the same value and mixer type,
+ *   with the same parameters).
+ *  \throws std::invalid_argument if a filter in the range is not compatible with \a dest. If this exception is actually
+ *   thrown depends on the \c LEEK_ASSERT settings. This is checked before anything is merged.
+ *
+ *  \see basic_bloom_filter::union_with
+**/
+template <typename TBloomFilter, typename TForwardIterator>
+void merge_parallel(TBloomFilter&    dest,
+                    TForwardIterator first,
+                    TForwardIterator last,
+                    std::size_t      threads = detail::default_thread_count()
+                   )
+{
+    static_assert(detail::storage_partition_blocks<typename TBloomFilter::storage_type>::value > 0,
+                  "The storage of TBloomFilter does not support writes to disjoint blocks from several threads."
+                 );
+
+    for (auto iter = first; iter != last; ++iter)
+        dest.assert_compatible(*iter);
+
+    threads = threads == 0 ? 1 : threads;
+    auto bounds = detail::partition_bounds(dest.data(), threads);
+    detail::run_parallel(threads,
+                         [&] (std::size_t worker)
+                         {
+                             auto begin = bounds[worker];
+                             auto end   = bounds[worker + 1];
+                             if (begin == end)
+                                 return;
+                             for (auto iter = first; iter != last; ++iter)
+                                 detail::union_blocks(dest.data(), iter->data(), begin, end);
+                         }
+                        );
+}
+
+/** Insert every value in [\a first, \a last) into \a dest, using \a threads threads, without any atomic operations.
+ *
+ *  Values are processed in rounds. First, each thread hashes its share of the round's values with
+ *  \c basic_bloom_filter::visit_masks and buckets the resulting (block, mask) pairs by which thread owns the block.
+ *  Each thread owns a disjoint, cache-line-aligned range of blocks (the same split as \c merge_parallel). Then each
+ *  thread applies the pairs destined for its range. Since no two threads ever write the same block, \a dest can use
+ *  plain \c basic_storage, and the result is identical to calling \c insert for each value.
+ *
+ *  \tparam TBloomFilter A \c basic_bloom_filter whose storage can have disjoint blocks written by different threads at
+ *   the same time. Storage declares this with a \c partition_blocks member, the number of consecutive blocks which
+ *   must stay with one thread. \c basic_storage (including the aligned and NUMA variants),
+ *   \c basic_thread_safe_storage, \c basic_contention_aware_storage, \c basic_mapped_storage and both counting
+ *   storages use 1; \c basic_counted_storage uses the value of the storage it wraps, and \c basic_cow_storage uses its
+ *   page size. Other storage fails to compile here.
+ *  \tparam TForwardIterator An iterator over values. A random-access iterator is best, since each round splits the
+ *   range between threads with \c std::next.
+ *
+ *  \see build_parallel
+**/
+template <typename TBloomFilter, typename TForwardIterator>
+void insert_parallel(TBloomFilter&    dest,
+                     TForwardIterator first,
+                     TForwardIterator last,
+                     std::size_t      threads = detail::default_thread_count()
+                    )
+{
+    using block_type = typename TBloomFilter::block_type;
+    using pair_type  = std::pair<std::size_t, block_type>;
+
+    static_assert(detail::storage_partition_blocks<typename TBloomFilter::storage_type>::value > 0,
+                  "The storage of TBloomFilter does not support writes to disjoint blocks from several threads."
+                 );
+
+    // With a single thread, bucketing the pairs is pure overhead
+    if (threads <= 1)
+    {
+        dest.insert_many(first, last);
+        return;
+    }
+
+    auto part_begins = detail::partition_bounds(dest.data(), threads);
+
+    auto owner = [&] (std::size_t block_idx)
+                 {
+                     auto iter = std::upper_bound(part_begins.begin() + 1, part_begins.end(), block_idx);
+                     return std::size_t(iter - part_begins.begin()) - 1;
+                 };
+
+    // pending[worker * threads + part] holds the pairs hashed by worker which belong to the blocks owned by part
+    std::vector<std::vector<pair_type>> pending(threads * threads);
+
+    auto remaining = std::size_t(std::distance(first, last));
+    while (remaining > 0)
+    {
+        auto round_size = std::min(remaining, detail::parallel_build_round * threads);
+        detail::run_parallel(threads,
+                             [&] (std::size_t worker)
+                             {
+                                 auto worker_first = std::next(first, round_size * worker / threads);
+                                 auto worker_last  = std::next(first, round_size * (worker + 1) / threads);
+                                 auto* buckets     = &pending[worker * threads];
+                                 auto add          = [&] (std::size_t block_idx, block_type mask)
+                                                     {
+                                                         buckets[owner(block_idx)].emplace_back(block_idx, mask);
+                                                     };
+                                 for ( ; worker_first != worker_last; ++worker_first)
+                                     dest.visit_masks(*worker_first, add);
+                             }
+                            );
+        detail::run_parallel(threads,
+                             [&] (std::size_t part)
+                             {
+                                 for (std::size_t worker = 0; worker < threads; ++worker)
+                                 {
+                                     auto& bucket = pending[worker * threads + part];
+                                     for (const auto& pair : bucket)
+                                         dest.data().set_mask(pair.first, pair.second);
+                                     bucket.clear();
+                                 }
+                             }
+                            );
+        dest.record_inserts(round_size);
+
+        std::advance(first, round_size);
+        remaining -= round_size;
+    }
+}
+
+/** Create a filter with \a params containing every value in [\a first, \a last), using \a threads threads. With
+ *  \c bloom_filter or \c cache_aligned_bloom_filter, this builds a plain (non-atomic) filter at close to \a threads
+ *  times the speed of inserting in a loop.
+ *
+ *  \code
+ *  auto filter = leekpp::build_parallel<leekpp::bloom_filter<std::uint64_t>>(keys.begin(), keys.end(), params);
+ *  \endcode
+ *
+ *  \see insert_parallel
+**/
+template <typename TBloomFilter, typename TForwardIterator>
+TBloomFilter build_parallel(TForwardIterator           first,
+                            TForwardIterator           last,
+                            const bloom_filter_params& params,
+                            std::size_t                threads = detail::default_thread_count()
+                           )
+{
+    TBloomFilter filter(params);
+    insert_parallel(filter, first, last, threads);
+    return filter;
+}
+
+/** \} **/
+
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+#include "bloom_filter.hpp"
+#include "stats.hpp"
+#include "storage.hpp"
+
+namespace leekpp
+{
+
+/** \addtogroup Filter
+ *  \{
+**/
+
+/** Publishes a filter to readers with read-copy-update: readers take a wait-free \c snapshot of the current filter, and
+ *  a writer replaces the filter with one it built on the side, so readers never wait for a rebuild or a \c clear and
+ *  never see a half-built filter.
+ *
+ *  Old filters are reclaimed with a two-phase epoch scheme. A reader adds itself to the reader count of the current
+ *  epoch's parity (split over \a KShards cache lines, like \c basic_sharded_stats) and then loads the filter pointer,
+ *  which is one atomic add and two loads, with no retry loop. After swapping in a new filter, the writer flips the
+ *  epoch and waits for the count of the old parity to drain, twice, so every reader which could have loaded the old
+ *  pointer has finished with it before the old filter is returned or destroyed. Readers which arrive during the wait
+ *  use the other parity, so the writer is never starved.
+ *
+ *  Only writers wait. A writer waits for the snapshots which were taken before it published, so a thread must not hold
+ *  a \c snapshot while it publishes.
+ *
+ *  \tparam TFilter The filter to publish, such as a \c basic_bloom_filter. With \c cow_storage (see
+ *   \c published_cow_bloom_filter), \c update only duplicates the pages it changes.
+ *  \tparam KShards The number of reader count shards.
+**/
+template <typename    TFilter,
+          std::size_t KShards = 16
+         >
+class basic_published_filter
+{
+public:
+    using filter_type = TFilter;
+    using size_type   = std::size_t;
+
+    static_assert(KShards > 0, "There must be at least one shard");
+
+    /** A read-only view of the filter which was current when it was taken. The filter lives at least as long as the
+     *  snapshot; writers which publish a replacement wait for it to be released, so keep it short.
+    **/
+    class snapshot
+    {
+    public:
+        snapshot(snapshot&& src) noexcept :
+                _filter(src._filter),
+                _readers(src._readers)
+        {
+            src._readers = nullptr;
+        }
+
+        snapshot(const snapshot&) = delete;
+        snapshot& operator=(const snapshot&) = delete;
+
+        ~snapshot()
+        {
+            if (_readers)
+                _readers->fetch_sub(1, std::memory_order_release);
+        }
+
+        const filter_type& operator*() const
+        {
+            return *_filter;
+        }
+
+        const filter_type* operator->() const
+        {
+            return _filter;
+        }
+
+    private:
+        friend class basic_published_filter;
+
+        snapshot(const filter_type* filter, std::atomic<size_type>* readers) :
+                _filter(filter),
+                _readers(readers)
+        { }
+
+    private:
+        const filter_type*      _filter;
+        std::atomic<size_type>* _readers;
+    };
+
+public:
+    /** Publish \a initial as the first filter. **/
+    explicit basic_published_filter(filter_type initial) :
+            _current(new filter_type(std::move(initial))),
+            _epoch(0)
+    { }
+
+    basic_published_filter(const basic_published_filter&) = delete;
+    basic_published_filter& operator=(const basic_published_filter&) = delete;
+
+    /** Destroy the current filter. No snapshots may be alive. **/
+    ~basic_published_filter()
+    {
+        delete _current.load(std::memory_order_relaxed);
+    }
+
+    /** Take a snapshot of the current filter. This is wait-free. **/
+    snapshot read() const
+    {
+        auto& readers = _readers[_epoch.load() & 1][detail::thread_shard_index() % KShards].count;
+        readers.fetch_add(1);
+        return snapshot(_current.load(), &readers);
+    }
+
+    /** Test for the likely presence of \a x in the current filter.
+     *
+     *  \see basic_bloom_filter::count
+    **/
+    template <typename U>
+    size_type count(const U& x) const
+    {
+        return read()->count(x);
+    }
+
+    /** Make \a next the current filter. Readers which start after this see \a next; the ones which started before keep
+     *  the previous filter until they finish, which this waits for.
+     *
+     *  \returns The previous filter, which no reader can see any more. Reuse it to build the next replacement without
+     *   allocating.
+    **/
+    filter_type publish(filter_type next)
+    {
+        std::lock_guard<std::mutex> lock(_write_mutex);
+        return publish_locked(std::move(next));
+    }
+
+    /** Publish a copy of the current filter after calling \a modify with it. Updates are serialized with each other and
+     *  with \c publish, so none of them are lost. Copying a filter with \c basic_storage copies every block; with
+     *  \c cow_storage, only the pages \a modify writes to are duplicated.
+     *
+     *  \tparam FModify A function called as \c modify(filter_type&).
+    **/
+    template <typename FModify>
+    void update(FModify modify)
+    {
+        std::lock_guard<std::mutex> lock(_write_mutex);
+        filter_type next(*_current.load(std::memory_order_relaxed));
+        modify(next);
+        publish_locked(std::move(next));
+    }
+
+    /** Publish an empty filter with the same parameters as the current one. **/
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(_write_mutex);
+        publish_locked(filter_type(_current.load(std::memory_order_relaxed)->params()));
+    }
+
+private:
+    filter_type publish_locked(filter_type next)
+    {
+        std::unique_ptr<filter_type> previous(_current.exchange(new filter_type(std::move(next))));
+        wait_for_readers();
+        return std::move(*previous);
+    }
+
+    /** Wait for every reader which might have loaded the previous filter pointer. Draining one parity is not enough: a
+     *  reader could have loaded the epoch before the last flip and only now add itself to the other parity's count.
+     *  Draining both parities after the swap catches every reader which started before it.
+    **/
+    void wait_for_readers()
+    {
+        for (int phase = 0; phase < 2; ++phase)
+        {
+            auto drained = _epoch.fetch_add(1) & 1;
+            for (const auto& readers : _readers[drained])
+                while (readers.count.load() != 0)
+                    std::this_thread::yield();
+        }
+    }
+
+private:
+    struct alignas(64) reader_count
+    {
+        std::atomic<size_type> count{ 0 };
+    };
+
+private:
+    std::atomic<filter_type*> _current;
+    std::atomic<size_type>    _epoch;
+    mutable reader_count      _readers[2][KShards];
+    std::mutex                _write_mutex;
+};
+
+template <typename T>
+using published_bloom_filter = basic_published_filter<bloom_filter<T>>;
+
+template <typename T>
+using published_cow_bloom_filter = basic_published_filter<cow_bloom_filter<T>>;
+
+/** \} **/
+
+}
@@ -0,0 +1,220 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "assert.hpp"
+#include "bloom_filter.hpp"
+
+namespace leekpp
+{
+
+/** \addtogroup Filter
+ *  \{
+**/
+
+/** A Bloom filter which grows as values are inserted, so it does not need to know how many values it will hold ahead
+ *  of time. This is the scalable Bloom filter of Almeida, Baquero, Preguiça and Hutchison in
+ *  [Scalable Bloom Filters](https://doi.org/10.1016/j.ipl.2006.10.007).
+ *
+ *  The filter is a chain of \c basic_bloom_filter stages. Values are always inserted into the newest stage and, once
+ *  \c bloom_filter_params::estimated_count says the newest stage is at its capacity, a new stage is added. Stage
+ *  \f$i\f$ has a capacity of \f$n_0 s^i\f$ and a target FPR of \f$p_0 = P (1 - r)\f$ multiplied by \f$r^i\f$, where
+ *  \f$P\f$ is the desired FPR, \f$s\f$ is the \c growth and \f$r\f$ is the \c tightening ratio. Since the per-stage
+ *  targets are a geometric series, the FPR of the whole chain stays below \f$P\f$ no matter how many stages are added.
+ *
+ *  Lookups check the newest (and largest) stage first, since that is where recently inserted values live, and stop at
+ *  the first stage which tests positively.
+ *
+ *  This class is \e not thread-safe, even with thread-safe storage, since adding a stage modifies the chain.
+ *
+ *  \tparam T The type of value this Bloom filter is meant to store.
+ *  \tparam TMixer A mixing function (see \c basic_mixer).
+ *  \tparam TStorage A block-based container to store the elements (see \c basic_storage).
+**/
+template <typename T,
+          typename TMixer   = basic_mixer<T>,
+          typename TStorage = basic_storage<>
+         >
+class basic_scalable_bloom_filter
+{
+public:
+    using value_type  = T;
+    using filter_type = basic_bloom_filter<T, TMixer, TStorage>;
+    using size_type   = std::size_t;
+
+public:
+    /** Create an instance.
+     *
+     *  \param desired_fpr The upper bound on the false positive rate of the filter as a whole.
+     *  \param initial_capacity The number of values the first stage should hold.
+     *  \param growth How much larger the capacity of each stage is than the one before it (\f$s\f$). Using 2 grows
+     *   quickly; smaller values use memory more tightly when the final size is close to \a initial_capacity.
+     *  \param tightening How much smaller the FPR of each stage is than the one before it (\f$r\f$).
+     *  \throws std::invalid_argument if any of the parameters are out of range. If this exception is actually thrown
+     *   depends on the \c LEEK_ASSERT settings.
+    **/
+    explicit basic_scalable_bloom_filter(double      desired_fpr,
+                                         std::size_t initial_capacity,
+                                         double      growth     = 2.0,
+                                         double      tightening = 0.5
+                                        ) :
+            _desired_fpr(desired_fpr),
+            _initial_capacity(initial_capacity),
+            _growth(growth),
+            _tightening(tightening)
+    {
+        LEEK_ASSERT(0.0 < desired_fpr && desired_fpr < 1.0,
+                    invalid_argument,
+                    ("desired_fpr=%f is not in range (0.0..1.0)", desired_fpr)
+                   );
+        LEEK_ASSERT(growth >= 1.0,
+                    invalid_argument,
+                    ("growth=%f must be at least 1.0", growth)
+                   );
+        LEEK_ASSERT(0.0 < tightening && tightening < 1.0,
+                    invalid_argument,
+                    ("tightening=%f is not in range (0.0..1.0)", tightening)
+                   );
+        clear();
+    }
+
+    /** Create an instance whose first stage holds \a expected_elements with the default growth and tightening. This
+     *  mirrors \c basic_bloom_filter::create_ideal, but \a expected_elements is only a starting point.
+    **/
+    static basic_scalable_bloom_filter create_ideal(double desired_fpr, std::size_t expected_elements)
+    {
+        return basic_scalable_bloom_filter(desired_fpr, expected_elements);
+    }
+
+    /** Get the stages of this filter, from oldest to newest. **/
+    const std::vector<filter_type>& stages() const
+    {
+        return _stages;
+    }
+
+    /** Get the capacity of the newest stage. Once this many values are estimated to be in the newest stage, the next
+     *  insert adds a new stage.
+    **/
+    size_type capacity() const
+    {
+        return _capacity;
+    }
+
+    /** Estimate the number of distinct values inserted into this filter. **/
+    size_type estimated_count() const
+    {
+        size_type count = 0;
+        for (const auto& stage : _stages)
+            count += stage.estimated_size();
+        return count;
+    }
+
+    /** Calculate the expected false positive rate of this filter as it is now. This is never above the
+     *  \c desired_fpr the filter was created with.
+    **/
+    double expected_fpr() const
+    {
+        double all_negative = 1.0;
+        for (const auto& stage : _stages)
+            all_negative *= 1.0 - stage.expected_fpr(stage.estimated_size());
+        return 1.0 - all_negative;
+    }
+
+    /** Test for the likely presence of \a x in this filter instance.
+     *
+     *  \returns \c 0 if the value is not present in this filter; \c 1 if it looks like the value is present.
+     *  \see basic_bloom_filter::count
+    **/
+    size_type count(const value_type& x) const
+    {
+        for (auto iter = _stages.rbegin(); iter != _stages.rend(); ++iter)
+            if (iter->count(x))
+                return 1;
+        return 0;
+    }
+
+    /** Insert the value \a x into this filter, adding a new stage if the newest stage is full. **/
+    void insert(const value_type& x)
+    {
+        _stages.back().insert(x);
+        if (++_inserts_since_check >= _check_interval)
+        {
+            _inserts_since_check = 0;
+            const auto& newest = _stages.back();
+            if (newest.estimated_size() >= _capacity)
+                add_stage();
+        }
+    }
+
+    /** Reset this filter to a single empty stage. **/
+    void clear()
+    {
+        _stages.clear();
+        _capacity = 0;
+        _stage_fpr = _desired_fpr * (1.0 - _tightening);
+        add_stage();
+    }
+
+private:
+    void add_stage()
+    {
+        if (_stages.empty())
+        {
+            _capacity = _initial_capacity;
+        }
+        else
+        {
+            _capacity = size_type(double(_capacity) * _growth);
+            _stage_fpr *= _tightening;
+        }
+        _stages.emplace_back(stage_params(_stage_fpr, _capacity));
+
+        // Counting the set bits is O(m), so only do it a few dozen times over the life of a stage. This lets a stage
+        // overshoot its capacity by about 3%, which is well within the slack of the geometric FPR bound.
+        _check_interval      = _capacity / 32 == 0 ? 1 : _capacity / 32;
+        _inserts_since_check = 0;
+    }
+
+    /** Get the parameters for a stage which meets \a stage_fpr at \a capacity. This starts from
+     *  \c bloom_filter_params::create_ideal, but blocking mixers do a bit worse than that model, so the bit count is
+     *  grown until the mixer's own model meets the target. Otherwise the sum over stages could exceed the desired FPR.
+     *  Like \c basic_bloom_filter::create_ideal, each bit count tried is one the mixer supports.
+    **/
+    static bloom_filter_params stage_params(double stage_fpr, size_type capacity)
+    {
+        constexpr size_type block_bits = filter_type::mixer_type::block_bits;
+
+        auto params = bloom_filter_params::create_ideal(stage_fpr, capacity);
+        for (;;)
+        {
+            params.bit_count = detail::round_bit_count<typename filter_type::mixer_type>(params.bit_count);
+            if (block_bits > 0 && params.bit_count % block_bits != 0)
+                params.bit_count += block_bits - (params.bit_count % block_bits);
+
+            auto fpr = block_bits == 0 ? params.expected_fpr(capacity)
+                                       : params.expected_blocked_fpr(capacity, block_bits);
+            if (fpr <= stage_fpr)
+                return params;
+            params.bit_count += params.bit_count / 32 + 1;
+        }
+    }
+
+private:
+    double                   _desired_fpr;
+    size_type                _initial_capacity;
+    double                   _growth;
+    double                   _tightening;
+    std::vector<filter_type> _stages;
+    size_type                _capacity;
+    double                   _stage_fpr;
+    size_type                _check_interval;
+    size_type                _inserts_since_check;
+};
+
+template <typename T>
+using scalable_bloom_filter = basic_scalable_bloom_filter<T>;
+
+/** \} **/
+
+}
@@ -0,0 +1,595 @@
+#pragma once
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "bloom_filter.hpp"
+#include "mapped_storage.hpp"
+#include "mixer.hpp"
+
+namespace leekpp
+{
+
+/** \addtogroup Serialization
+ *  \{
+ *
+ *  Filters are serialized in a compact binary format: a fixed 64-byte header followed by the raw block array in native
+ *  byte order. The header records the \c bloom_filter_params, the block width, the \c mixer_id of the filter, a byte
+ *  order marker and a checksum of the header and the block array, all of which are checked when loading. Before
+ *  anything is allocated, the block count is also checked against the bytes the input has left, where that is known
+ *  (buffers, regular files and seekable streams). Since the payload is the block array itself, saving and loading are
+ *  bulk copies, and a saved file can be mapped directly with \c load_mapped.
+ *
+ *  | Offset | Size | Field                                                         |
+ *  |-------:|-----:|:--------------------------------------------------------------|
+ *  |      0 |    8 | Magic bytes `LEEKBLOM`                                        |
+ *  |      8 |    4 | Format version (currently 2)                                  |
+ *  |     12 |    4 | Byte order marker `0x01020304`                                |
+ *  |     16 |    8 | `bloom_filter_params::bit_count`                              |
+ *  |     24 |    8 | `bloom_filter_params::num_hashes`                             |
+ *  |     32 |    8 | Number of blocks in the payload                               |
+ *  |     40 |    4 | Size of a block in bytes                                      |
+ *  |     44 |    4 | Reserved (0)                                                  |
+ *  |     48 |    8 | `mixer_id` of the filter's mixer                              |
+ *  |     56 |    8 | Checksum of the header (with this field as 0) and the payload |
+**/
+
+/** Thrown when serialized data cannot be loaded, either because it is malformed or because it describes a filter
+ *  which is not compatible with the requested type. Unlike most errors in this library, this is not controlled by the
+ *  \c LEEK_ASSERT settings, since the input is not under the control of the program.
+**/
+class serialization_error :
+        public std::runtime_error
+{
+public:
+    using std::runtime_error::runtime_error;
+};
+
+namespace detail
+{
+
+static constexpr char          serialized_magic[8]   = { 'L', 'E', 'E', 'K', 'B', 'L', 'O', 'M' };
+static constexpr std::uint32_t serialized_version    = 2;
+static constexpr std::uint32_t serialized_byte_order = 0x01020304;
+
+struct serialized_header
+{
+    char          magic[8];
+    std::uint32_t version;
+    std::uint32_t byte_order;
+    std::uint64_t bit_count;
+    std::uint64_t num_hashes;
+    std::uint64_t block_count;
+    std::uint32_t block_bytes;
+    std::uint32_t reserved;
+    std::uint64_t mixer;
+    std::uint64_t checksum;
+};
+
+static_assert(sizeof(serialized_header) == 64, "serialized_header must not have padding");
+
+/** A 64-bit checksum in the style of xxHash64: four independent lanes consume 32-byte stripes, so it runs at close to
+ *  memory bandwidth. Input can be split across any number of \c update calls.
+**/
+class checksum_state
+{
+public:
+    checksum_state() :
+            _lanes{ prime1 + prime2, prime2, 0, 0 - prime1 },
+            _length(0),
+            _buffered(0)
+    { }
+
+    void update(const void* data, std::size_t size)
+    {
+        auto bytes = static_cast<const unsigned char*>(data);
+        _length += size;
+
+        if (_buffered != 0)
+        {
+            auto take = size < sizeof _buffer - _buffered ? size : sizeof _buffer - _buffered;
+            std::memcpy(_buffer + _buffered, bytes, take);
+            _buffered += take;
+            bytes     += take;
+            size      -= take;
+            if (_buffered < sizeof _buffer)
+                return;
+            consume(_buffer);
+            _buffered = 0;
+        }
+
+        for ( ; size >= sizeof _buffer; bytes += sizeof _buffer, size -= sizeof _buffer)
+            consume(bytes);
+
+        std::memcpy(_buffer, bytes, size);
+        _buffered = size;
+    }
+
+    std::uint64_t digest() const
+    {
+        auto out = rotate_left(_lanes[0], 1) + rotate_left(_lanes[1], 7)
+                 + rotate_left(_lanes[2], 12) + rotate_left(_lanes[3], 18);
+        out ^= _length;
+        for (std::size_t idx = 0; idx < _buffered; ++idx)
+            out = rotate_left(out ^ (_buffer[idx] * prime1), 11) * prime2;
+        return mix64(out);
+    }
+
+private:
+    static constexpr std::uint64_t prime1 = 0x9e3779b185ebca87ULL;
+    static constexpr std::uint64_t prime2 = 0xc2b2ae3d27d4eb4fULL;
+
+    void consume(const unsigned char* stripe)
+    {
+        std::uint64_t words[4];
+        std::memcpy(words, stripe, sizeof words);
+        for (std::size_t lane = 0; lane < 4; ++lane)
+            _lanes[lane] = rotate_left(_lanes[lane] + words[lane] * prime2, 31) * prime1;
+    }
+
+private:
+    std::uint64_t _lanes[4];
+    std::uint64_t _length;
+    unsigned char _buffer[32];
+    std::size_t   _buffered;
+};
+
+/** The number of blocks copied at a time for storage without contiguous data. **/
+static constexpr std::size_t serialization_chunk_blocks = 4096;
+
+template <typename TStorage, typename FVisit>
+typename std::enable_if<has_contiguous_data<TStorage>::value>::type
+for_each_block_chunk(const TStorage& storage, FVisit visit)
+{
+    visit(storage.data(), std::size_t(storage.block_count()));
+}
+
+template <typename TStorage, typename FVisit>
+typename std::enable_if<!has_contiguous_data<TStorage>::value>::type
+for_each_block_chunk(const TStorage& storage, FVisit visit)
+{
+    typename TStorage::block_type buffer[serialization_chunk_blocks];
+    for (std::size_t first = 0; first < storage.block_count(); first += serialization_chunk_blocks)
+    {
+        std::size_t count = 0;
+        for ( ; count < serialization_chunk_blocks && first + count < storage.block_count(); ++count)
+            buffer[count] = storage[first + count];
+        visit(buffer, count);
+    }
+}
+
+template <typename TStorage, typename TSource>
+typename std::enable_if<has_contiguous_data<TStorage>::value>::type
+read_blocks(TStorage& storage, TSource& source)
+{
+    source.read(storage.data(), storage.block_count() * sizeof(typename TStorage::block_type));
+}
+
+template <typename TStorage, typename TSource>
+typename std::enable_if<!has_contiguous_data<TStorage>::value>::type
+read_blocks(TStorage& storage, TSource& source)
+{
+    typename TStorage::block_type buffer[serialization_chunk_blocks];
+    for (std::size_t first = 0; first < storage.block_count(); first += serialization_chunk_blocks)
+    {
+        std::size_t count = storage.block_count() - first;
+        count = count < serialization_chunk_blocks ? count : serialization_chunk_blocks;
+        source.read(buffer, count * sizeof buffer[0]);
+        for (std::size_t idx = 0; idx < count; ++idx)
+            storage.set_mask(first + idx, buffer[idx]);
+    }
+}
+
+/** Compute the checksum of \a header (with its \c checksum field as 0) followed by the blocks of \a storage. Covering
+ *  the header means a corrupted \c num_hashes or \c bit_count is caught, not just a corrupted block.
+**/
+template <typename TStorage>
+std::uint64_t checksum_filter(serialized_header header, const TStorage& storage)
+{
+    header.checksum = 0;
+    checksum_state state;
+    state.update(&header, sizeof header);
+    for_each_block_chunk(storage,
+                         [&] (const typename TStorage::block_type* blocks, std::size_t count)
+                         {
+                             state.update(blocks, count * sizeof *blocks);
+                         }
+                        );
+    return state.digest();
+}
+
+template <typename TBloomFilter>
+serialized_header make_header(const TBloomFilter& filter, const char (&magic)[8] = serialized_magic)
+{
+    serialized_header header;
+    std::memcpy(header.magic, magic, sizeof header.magic);
+    header.version     = serialized_version;
+    header.byte_order  = serialized_byte_order;
+    header.bit_count   = filter.params().bit_count;
+    header.num_hashes  = filter.params().num_hashes;
+    header.block_count = filter.data().block_count();
+    header.block_bytes = sizeof(typename TBloomFilter::block_type);
+    header.reserved    = 0;
+    header.mixer       = mixer_id<typename TBloomFilter::mixer_type>::value;
+    header.checksum    = 0;
+    header.checksum    = checksum_filter(header, filter.data());
+    return header;
+}
+
+template <typename TBloomFilter>
+void validate_header(const serialized_header& header, const char (&magic)[8] = serialized_magic)
+{
+    using block_type = typename TBloomFilter::block_type;
+
+    if (std::memcmp(header.magic, magic, sizeof header.magic) != 0)
+        throw serialization_error("Input is not a serialized leekpp filter");
+    if (header.byte_order != serialized_byte_order)
+        throw serialization_error("Filter was serialized on a machine with a different byte order");
+    if (header.version != serialized_version)
+        throw serialization_error("Unsupported serialization version " + std::to_string(header.version));
+    if (header.mixer != mixer_id<typename TBloomFilter::mixer_type>::value)
+        throw serialization_error("Filter was serialized with a different mixer");
+    if (header.block_bytes != sizeof(block_type))
+        throw serialization_error("Filter was serialized with a block size of " + std::to_string(header.block_bytes));
+    if (header.bit_count == 0 || header.block_count != basic_storage<block_type>::block_count(header.bit_count))
+        throw serialization_error("Filter header has an inconsistent bit and block count");
+    if (header.num_hashes == 0)
+        throw serialization_error("Filter header has no hashes");
+}
+
+/** Throw if \a source is known to have fewer than \a min_bytes left, so a corrupt header can not make the loader
+ *  allocate a filter far larger than its input.
+**/
+template <typename TSource>
+void check_remaining(const TSource& source, std::uint64_t min_bytes)
+{
+    if (source.remaining() < min_bytes)
+        throw serialization_error("Filter header describes more data than the input has");
+}
+
+/** The plain payload is exactly \c block_count blocks. **/
+inline std::uint64_t payload_bytes(const serialized_header& header)
+{
+    auto max_blocks = std::numeric_limits<std::uint64_t>::max() / header.block_bytes;
+    return header.block_count > max_blocks ? std::numeric_limits<std::uint64_t>::max()
+                                           : header.block_count * header.block_bytes;
+}
+
+/** Get the number of bytes left in the regular file \a fd after its current position, or the maximum value when that
+ *  is not known (for pipes and sockets).
+**/
+inline std::uint64_t fd_remaining(int fd)
+{
+    struct stat info;
+    auto position = ::lseek(fd, 0, SEEK_CUR);
+    if (position < 0 || ::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode))
+        return std::numeric_limits<std::uint64_t>::max();
+    return info.st_size > position ? std::uint64_t(info.st_size - position) : 0;
+}
+
+class stream_sink
+{
+public:
+    explicit stream_sink(std::ostream& os) :
+            _os(os)
+    { }
+
+    void write(const void* data, std::size_t size)
+    {
+        if (!_os.write(static_cast<const char*>(data), std::streamsize(size)))
+            throw serialization_error("Failed to write to stream");
+    }
+
+private:
+    std::ostream& _os;
+};
+
+class stream_source
+{
+public:
+    explicit stream_source(std::istream& is) :
+            _is(is)
+    { }
+
+    void read(void* data, std::size_t size)
+    {
+        if (!_is.read(static_cast<char*>(data), std::streamsize(size)))
+            throw serialization_error("Unexpected end of input stream");
+    }
+
+    /** Get the bytes left in a seekable stream, or the maximum value for one which can not seek. **/
+    std::uint64_t remaining() const
+    {
+        auto position = _is.tellg();
+        if (position < 0)
+            return std::numeric_limits<std::uint64_t>::max();
+        _is.seekg(0, std::ios::end);
+        auto end = _is.tellg();
+        _is.seekg(position);
+        if (end < 0)
+        {
+            _is.clear();
+            return std::numeric_limits<std::uint64_t>::max();
+        }
+        return end > position ? std::uint64_t(end - position) : 0;
+    }
+
+private:
+    std::istream& _is;
+};
+
+class fd_sink
+{
+public:
+    explicit fd_sink(int fd) :
+            _fd(fd)
+    { }
+
+    void write(const void* data, std::size_t size)
+    {
+        auto bytes = static_cast<const char*>(data);
+        while (size > 0)
+        {
+            auto written = ::write(_fd, bytes, size);
+            if (written < 0 && errno == EINTR)
+                continue;
+            if (written < 0)
+                throw std::system_error(errno, std::generic_category(), "Failed to write filter");
+            bytes += written;
+            size  -= std::size_t(written);
+        }
+    }
+
+private:
+    int _fd;
+};
+
+class fd_source
+{
+public:
+    explicit fd_source(int fd) :
+            _fd(fd)
+    { }
+
+    void read(void* data, std::size_t size)
+    {
+        auto bytes = static_cast<char*>(data);
+        while (size > 0)
+        {
+            auto got = ::read(_fd, bytes, size);
+            if (got < 0 && errno == EINTR)
+                continue;
+            if (got < 0)
+                throw std::system_error(errno, std::generic_category(), "Failed to read filter");
+            if (got == 0)
+                throw serialization_error("Unexpected end of file");
+            bytes += got;
+            size  -= std::size_t(got);
+        }
+    }
+
+    std::uint64_t remaining() const
+    {
+        return fd_remaining(_fd);
+    }
+
+private:
+    int _fd;
+};
+
+class buffer_sink
+{
+public:
+    buffer_sink(void* buffer, std::size_t size) :
+            _position(static_cast<char*>(buffer)),
+            _remaining(size)
+    { }
+
+    void write(const void* data, std::size_t size)
+    {
+        if (size > _remaining)
+            throw serialization_error("Buffer is too small for the serialized filter");
+        std::memcpy(_position, data, size);
+        _position  += size;
+        _remaining -= size;
+    }
+
+private:
+    char*       _position;
+    std::size_t _remaining;
+};
+
+class buffer_source
+{
+public:
+    buffer_source(const void* buffer, std::size_t size) :
+            _position(static_cast<const char*>(buffer)),
+            _remaining(size)
+    { }
+
+    void read(void* data, std::size_t size)
+    {
+        if (size > _remaining)
+            throw serialization_error("Unexpected end of buffer");
+        std::memcpy(data, _position, size);
+        _position  += size;
+        _remaining -= size;
+    }
+
+    std::uint64_t remaining() const
+    {
+        return _remaining;
+    }
+
+private:
+    const char* _position;
+    std::size_t _remaining;
+};
+
+template <typename TSink, typename TBloomFilter>
+void save_to(TSink& sink, const TBloomFilter& filter)
+{
+    auto header = make_header(filter);
+    sink.write(&header, sizeof header);
+    for_each_block_chunk(filter.data(),
+                         [&] (const typename TBloomFilter::block_type* blocks, std::size_t count)
+                         {
+                             sink.write(blocks, count * sizeof *blocks);
+                         }
+                        );
+}
+
+template <typename TBloomFilter, typename TSource>
+TBloomFilter load_from(TSource& source)
+{
+    serialized_header header;
+    source.read(&header, sizeof header);
+    validate_header<TBloomFilter>(header);
+    check_remaining(source, payload_bytes(header));
+
+    TBloomFilter filter(bloom_filter_params(header.bit_count, header.num_hashes));
+    read_blocks(filter.data(), source);
+    if (checksum_filter(header, filter.data()) != header.checksum)
+        throw serialization_error("Filter checksum does not match its contents");
+    return filter;
+}
+
+}
+
+/** Get the number of bytes \c save will write for \a filter. **/
+template <typename T, typename TMixer, typename TStorage, typename TStats>
+std::size_t serialized_size(const basic_bloom_filter<T, TMixer, TStorage, TStats>& filter)
+{
+    return sizeof(detail::serialized_header) + filter.data().block_count() * sizeof(typename TStorage::block_type);
+}
+
+/** Write \a filter to the stream \a os.
+ *
+ *  \throws serialization_error if the stream fails.
+**/
+template <typename T, typename TMixer, typename TStorage, typename TStats>
+void save(std::ostream& os, const basic_bloom_filter<T, TMixer, TStorage, TStats>& filter)
+{
+    detail::stream_sink sink(os);
+    detail::save_to(sink, filter);
+}
+
+/** Write \a filter to the file descriptor \a fd at its current position.
+ *
+ *  \throws std::system_error if writing fails.
+**/
+template <typename T, typename TMixer, typename TStorage, typename TStats>
+void save(int fd, const basic_bloom_filter<T, TMixer, TStorage, TStats>& filter)
+{
+    detail::fd_sink sink(fd);
+    detail::save_to(sink, filter);
+}
+
+/** Write \a filter to the \a buffer of \a size bytes.
+ *
+ *  \returns The number of bytes written, which is \c serialized_size of \a filter.
+ *  \throws serialization_error if \a size is smaller than \c serialized_size of \a filter.
+**/
+template <typename T, typename TMixer, typename TStorage, typename TStats>
+std::size_t save(void* buffer, std::size_t size, const basic_bloom_filter<T, TMixer, TStorage, TStats>& filter)
+{
+    if (size < serialized_size(filter))
+        throw serialization_error("Buffer is too small for the serialized filter");
+    detail::buffer_sink sink(buffer, size);
+    detail::save_to(sink, filter);
+    return serialized_size(filter);
+}
+
+/** Read a filter of type \c TBloomFilter from the stream \a is.
+ *
+ *  \throws serialization_error if the input is malformed, does not match its checksum or was saved from a filter with
+ *   a different \c mixer_type or \c block_type.
+**/
+template <typename TBloomFilter>
+TBloomFilter load(std::istream& is)
+{
+    detail::stream_source source(is);
+    return detail::load_from<TBloomFilter>(source);
+}
+
+/** Read a filter of type \c TBloomFilter from the file descriptor \a fd at its current position.
+ *
+ *  \throws serialization_error under the same conditions as loading from a stream.
+ *  \throws std::system_error if reading fails.
+**/
+template <typename TBloomFilter>
+TBloomFilter load(int fd)
+{
+    detail::fd_source source(fd);
+    return detail::load_from<TBloomFilter>(source);
+}
+
+/** Read a filter of type \c TBloomFilter from the \a buffer of \a size bytes.
+ *
+ *  \throws serialization_error under the same conditions as loading from a stream.
+**/
+template <typename TBloomFilter>
+TBloomFilter load(const void* buffer, std::size_t size)
+{
+    detail::buffer_source source(buffer, size);
+    return detail::load_from<TBloomFilter>(source);
+}
+
+/** Open a file written by \c save as a filter backed by \c basic_mapped_storage. Only the header is read, so this is
+ *  O(1) no matter how large the filter is. Since checking the checksum would require reading every page, it is only
+ *  done if \a verify_checksum is set. Changes made through a \c map_mode::read_write mapping do not update the
+ *  checksum, so do not verify the checksum of files you modify this way.
+ *
+ *  \tparam TBloomFilter A \c basic_bloom_filter whose \c storage_type is a \c basic_mapped_storage.
+ *  \throws serialization_error under the same conditions as loading from a stream.
+ *  \throws std::system_error if the file cannot be opened or mapped.
+**/
+template <typename TBloomFilter>
+TBloomFilter load_mapped(const std::string& path, map_mode mode = map_mode::read_only, bool verify_checksum = false)
+{
+    using storage_type = typename TBloomFilter::storage_type;
+
+    detail::serialized_header header;
+    {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(), "Failed to open " + path);
+        try
+        {
+            detail::fd_source source(fd);
+            source.read(&header, sizeof header);
+            detail::validate_header<TBloomFilter>(header);
+            detail::check_remaining(source, detail::payload_bytes(header));
+        }
+        catch (...)
+        {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+    }
+
+    TBloomFilter filter(bloom_filter_params(header.bit_count, header.num_hashes),
+                        storage_type::open(path, header.bit_count, mode, sizeof header)
+                       );
+    if (verify_checksum && detail::checksum_filter(header, filter.data()) != header.checksum)
+        throw serialization_error("Filter checksum does not match its contents");
+    return filter;
+}
+
+/** \} **/
+
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+/** \addtogroup Configuration
+ *  \{
+**/
+
+/** \def LEEK_USE_AVX2
+ *  If set to \c 1, AVX2 intrinsics are used for bulk operations over storage and for \c basic_split_block_bloom_filter.
+ *  By default, this is enabled when the compiler targets a CPU with AVX2 (for example, with \c -mavx2 or
+ *  \c -march=native). If set to \c 0, portable scalar implementations are used instead.
+**/
+#ifndef LEEK_USE_AVX2
+#   if defined(__AVX2__)
+#       define LEEK_USE_AVX2 1
+#   else
+#       define LEEK_USE_AVX2 0
+#   endif
+#endif
+
+/** \} **/
+
+#if LEEK_USE_AVX2
+#   include <immintrin.h>
+#endif
+
+namespace leekpp
+{
+namespace detail
+{
+
+/** Count the set bits in \a x. **/
+inline unsigned popcount(std::uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return unsigned(__builtin_popcountll(x));
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0f0f0f0f0f0f0f0fULL;
+    return unsigned((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/** Get the index of the lowest set bit of \a x, which must not be 0. **/
+inline unsigned count_trailing_zeros(std::uint64_t x)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return unsigned(__builtin_ctzll(x));
+#else
+    return popcount((x & (0 - x)) - 1);
+#endif
+}
+
+/** Count the set bits in the \a size bytes at \a src. **/
+inline std::size_t popcount_bytes(const void* src, std::size_t size)
+{
+    auto        in    = static_cast<const unsigned char*>(src);
+    std::size_t count = 0;
+#if LEEK_USE_AVX2
+    // Mula's method: look up the count of each nibble with a byte shuffle, then sum the bytes with SAD
+    const auto table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+                                       );
+    const auto low_nibbles = _mm256_set1_epi8(0x0f);
+    auto       totals      = _mm256_setzero_si256();
+    for ( ; size >= 32; in += 32, size -= 32)
+    {
+        auto block  = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+        auto counts = _mm256_add_epi8(_mm256_shuffle_epi8(table, _mm256_and_si256(block, low_nibbles)),
+                                      _mm256_shuffle_epi8(table, _mm256_and_si256(_mm256_srli_epi16(block, 4),
+                                                                                   low_nibbles
+                                                                                  )
+                                                         )
+                                     );
+        totals = _mm256_add_epi64(totals, _mm256_sad_epu8(counts, _mm256_setzero_si256()));
+    }
+    std::uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), totals);
+    count = std::size_t(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+#endif
+    for ( ; size >= 32; in += 32, size -= 32)
+    {
+        std::uint64_t words[4];
+        std::memcpy(words, in, sizeof words);
+        count += popcount(words[0]) + popcount(words[1]) + popcount(words[2]) + popcount(words[3]);
+    }
+    for ( ; size > 0; ++in, --size)
+        count += popcount(*in);
+    return count;
+}
+
+/** The set bit counts of two equally-sized bit arrays and of their union, from \c popcount_pair_bytes. **/
+struct popcount_pair
+{
+    std::size_t first;
+    std::size_t second;
+    std::size_t either;
+};
+
+/** Count the set bits in \a lhs, in \a rhs and in <tt>lhs | rhs</tt> over \a size bytes in a single pass, without
+ *  materializing the union.
+**/
+inline popcount_pair popcount_pair_bytes(const void* lhs, const void* rhs, std::size_t size)
+{
+    auto          a   = static_cast<const unsigned char*>(lhs);
+    auto          b   = static_cast<const unsigned char*>(rhs);
+    popcount_pair out = { 0, 0, 0 };
+#if LEEK_USE_AVX2
+    const auto table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                        0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4
+                                       );
+    const auto low_nibbles = _mm256_set1_epi8(0x0f);
+    auto byte_counts = [&] (__m256i block)
+                       {
+                           auto low  = _mm256_and_si256(block, low_nibbles);
+                           auto high = _mm256_and_si256(_mm256_srli_epi16(block, 4), low_nibbles);
+                           return _mm256_add_epi8(_mm256_shuffle_epi8(table, low), _mm256_shuffle_epi8(table, high));
+                       };
+    auto first  = _mm256_setzero_si256();
+    auto second = _mm256_setzero_si256();
+    auto either = _mm256_setzero_si256();
+    for ( ; size >= 32; a += 32, b += 32, size -= 32)
+    {
+        auto x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a));
+        auto y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b));
+        first  = _mm256_add_epi64(first,  _mm256_sad_epu8(byte_counts(x), _mm256_setzero_si256()));
+        second = _mm256_add_epi64(second, _mm256_sad_epu8(byte_counts(y), _mm256_setzero_si256()));
+        either = _mm256_add_epi64(either, _mm256_sad_epu8(byte_counts(_mm256_or_si256(x, y)), _mm256_setzero_si256()));
+    }
+    auto sum_lanes = [] (__m256i totals)
+                     {
+                         std::uint64_t lanes[4];
+                         _mm256_storeu_si256(reinterpret_cast<__m256i*>(lanes), totals);
+                         return std::size_t(lanes[0] + lanes[1] + lanes[2] + lanes[3]);
+                     };
+    out.first  = sum_lanes(first);
+    out.second = sum_lanes(second);
+    out.either = sum_lanes(either);
+#endif
+    for ( ; size >= 8; a += 8, b += 8, size -= 8)
+    {
+        std::uint64_t x, y;
+        std::memcpy(&x, a, sizeof x);
+        std::memcpy(&y, b, sizeof y);
+        out.first  += popcount(x);
+        out.second += popcount(y);
+        out.either += popcount(x | y);
+    }
+    for ( ; size > 0; ++a, ++b, --size)
+    {
+        out.first  += popcount(*a);
+        out.second += popcount(*b);
+        out.either += popcount(*a | *b);
+    }
+    return out;
+}
+
+/** Apply \c FWordOp to each 64-bit word of \a dst and \a src and \c FByteOp to the leftover bytes. The word loop works
+ *  on local copies so the compiler knows the arrays do not alias within an iteration, which lets it vectorize.
+**/
+template <typename FWordOp, typename FByteOp>
+void combine_bytes_scalar(unsigned char*       dst,
+                          const unsigned char* src,
+                          std::size_t          size,
+                          FWordOp              word_op,
+                          FByteOp              byte_op
+                         )
+{
+    std::size_t idx = 0;
+    for ( ; idx + 32 <= size; idx += 32)
+    {
+        std::uint64_t lhs[4], rhs[4];
+        std::memcpy(lhs, dst + idx, sizeof lhs);
+        std::memcpy(rhs, src + idx, sizeof rhs);
+        for (std::size_t word = 0; word < 4; ++word)
+            lhs[word] = word_op(lhs[word], rhs[word]);
+        std::memcpy(dst + idx, lhs, sizeof lhs);
+    }
+    for ( ; idx < size; ++idx)
+        dst[idx] = byte_op(dst[idx], src[idx]);
+}
+
+/** Compute <tt>dst |= src</tt> over \a size bytes. **/
+inline void or_bytes(void* dst, const void* src, std::size_t size)
+{
+    auto out = static_cast<unsigned char*>(dst);
+    auto in  = static_cast<const unsigned char*>(src);
+#if LEEK_USE_AVX2
+    for ( ; size >= 32; out += 32, in += 32, size -= 32)
+    {
+        auto lhs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out));
+        auto rhs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_or_si256(lhs, rhs));
+    }
+#endif
+    combine_bytes_scalar(out, in, size,
+                         [] (std::uint64_t a, std::uint64_t b) { return a | b; },
+                         [] (unsigned char a, unsigned char b) { return static_cast<unsigned char>(a | b); }
+                        );
+}
+
+/** Compute <tt>dst &= src</tt> over \a size bytes. **/
+inline void and_bytes(void* dst, const void* src, std::size_t size)
+{
+    auto out = static_cast<unsigned char*>(dst);
+    auto in  = static_cast<const unsigned char*>(src);
+#if LEEK_USE_AVX2
+    for ( ; size >= 32; out += 32, in += 32, size -= 32)
+    {
+        auto lhs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(out));
+        auto rhs = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), _mm256_and_si256(lhs, rhs));
+    }
+#endif
+    combine_bytes_scalar(out, in, size,
+                         [] (std::uint64_t a, std::uint64_t b) { return a & b; },
+                         [] (unsigned char a, unsigned char b) { return static_cast<unsigned char>(a & b); }
+                        );
+}
+
+}
+}
@@ -0,0 +1,224 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include "assert.hpp"
+#include "bloom_filter.hpp"
+
+namespace leekpp
+{
+
+/** \addtogroup Filter
+ *  \{
+**/
+
+/** When does a \c basic_sliding_window_bloom_filter start a new generation? **/
+enum class window_rotation
+{
+    /** Whenever the current generation has had its capacity inserted into it, so the window is a number of values. **/
+    on_capacity,
+    /** Only when \c rotate is called, such as from a timer, so the window is whatever the caller measures it in. **/
+    manual,
+};
+
+/** A Bloom filter which only remembers recent values, for deduplicating a stream over a sliding window. It is a ring
+ *  of \c basic_bloom_filter generations: values are inserted into the current generation, lookups check every live
+ *  generation and \c rotate retires the oldest generation and starts a new one. Memory is a fixed
+ *  \f$(g + 1) m\f$ bits and each operation touches a fixed number of bits, however long the stream is.
+ *
+ *  With \f$g\f$ live generations of capacity \f$c\f$ and \c window_rotation::on_capacity, a value is remembered for at
+ *  least the next \f$(g - 1) c\f$ inserts and at most \f$g c\f$. Each generation is sized for an FPR of \f$P / g\f$, so
+ *  a full window stays below the desired FPR \f$P\f$.
+ *
+ *  The ring has one generation more than the window. That spare generation is cleared when it is retired, which is
+ *  \f$O(m)\f$, but not used again until the next rotation, so rotating is a single store to publish the next
+ *  generation and writers are never stopped. With \c thread_safe_storage (see
+ *  \c thread_safe_sliding_window_bloom_filter), any number of threads can \c insert and \c count while another
+ *  rotates. A thread which is still inserting into a generation after it has been rotated out of the window \e twice
+ *  can have its insert cleared, which is not an issue for any reasonable generation size.
+ *
+ *  \tparam T The type of value this Bloom filter is meant to store.
+ *  \tparam TMixer A mixing function (see \c basic_mixer). It must be constructible from a \c hashed_value.
+ *  \tparam TStorage A block-based container to store the elements (see \c basic_storage).
+**/
+template <typename T,
+          typename TMixer   = basic_mixer<T>,
+          typename TStorage = basic_storage<>
+         >
+class basic_sliding_window_bloom_filter
+{
+public:
+    using value_type  = T;
+    using filter_type = basic_bloom_filter<T, TMixer, TStorage>;
+    using size_type   = std::size_t;
+
+public:
+    /** Create an instance.
+     *
+     *  \param desired_fpr The upper bound on the false positive rate with every live generation full.
+     *  \param generation_capacity The number of values each generation is sized for.
+     *  \param generation_count The number of generations a lookup checks (\f$g\f$).
+     *  \param rotation When to start a new generation.
+     *  \throws std::invalid_argument if any of the parameters are out of range. If this exception is actually thrown
+     *   depends on the \c LEEK_ASSERT settings.
+    **/
+    explicit basic_sliding_window_bloom_filter(double          desired_fpr,
+                                               std::size_t     generation_capacity,
+                                               std::size_t     generation_count,
+                                               window_rotation rotation = window_rotation::on_capacity
+                                              ) :
+            _generation_capacity(generation_capacity),
+            _rotation(rotation),
+            _current(0),
+            _inserted(0)
+    {
+        LEEK_ASSERT(generation_count > 0, invalid_argument, ("generation_count must be at least 1"));
+        auto params = filter_type::create_ideal(desired_fpr / generation_count, generation_capacity).params();
+        _generations.reserve(generation_count + 1);
+        for (size_type idx = 0; idx <= generation_count; ++idx)
+            _generations.emplace_back(params);
+    }
+
+    /** Create an instance which always remembers at least the last \a window_elements values, with 4 generations which
+     *  each hold a third of the window.
+    **/
+    static basic_sliding_window_bloom_filter create_ideal(double desired_fpr, std::size_t window_elements)
+    {
+        return basic_sliding_window_bloom_filter(desired_fpr, (window_elements + 2) / 3, 4);
+    }
+
+    /** Moving is not thread-safe: no other thread may use \a src while it is moved from. **/
+    basic_sliding_window_bloom_filter(basic_sliding_window_bloom_filter&& src) :
+            _generations(std::move(src._generations)),
+            _generation_capacity(src._generation_capacity),
+            _rotation(src._rotation),
+            _current(src._current.load()),
+            _inserted(src._inserted.load())
+    { }
+
+    basic_sliding_window_bloom_filter(const basic_sliding_window_bloom_filter&) = delete;
+    basic_sliding_window_bloom_filter& operator=(const basic_sliding_window_bloom_filter&) = delete;
+
+    /** Get every generation in the ring, including the spare which is not part of the window. **/
+    const std::vector<filter_type>& generations() const
+    {
+        return _generations;
+    }
+
+    /** Get the number of generations a lookup checks. **/
+    size_type generation_count() const
+    {
+        return _generations.size() - 1;
+    }
+
+    /** Get the number of values each generation is sized for. **/
+    size_type generation_capacity() const
+    {
+        return _generation_capacity;
+    }
+
+    /** Estimate the number of distinct values in the window. **/
+    size_type estimated_count() const
+    {
+        size_type count = 0;
+        for_each_live([&] (const filter_type& generation) { count += generation.estimated_size(); return false; });
+        return count;
+    }
+
+    /** Calculate the expected false positive rate of this filter as it is now. **/
+    double expected_fpr() const
+    {
+        double all_negative = 1.0;
+        for_each_live([&] (const filter_type& generation)
+                      {
+                          all_negative *= 1.0 - generation.expected_fpr(generation.estimated_size());
+                          return false;
+                      }
+                     );
+        return 1.0 - all_negative;
+    }
+
+    /** Test for the likely presence of \a x in the window. The value is hashed once and the same probe is used for
+     *  each generation, newest first.
+     *
+     *  \returns \c 0 if the value is not present in this filter; \c 1 if it looks like the value is present.
+     *  \see basic_bloom_filter::count
+    **/
+    size_type count(const value_type& x) const
+    {
+        auto probe = _generations.front().probe(filter_type::hash_value(x));
+        return for_each_live([&] (const filter_type& generation) { return generation.count_probe(probe) != 0; })
+               ? 1 : 0;
+    }
+
+    /** Insert the value \a x into the current generation, rotating first if it is at capacity and this filter uses
+     *  \c window_rotation::on_capacity.
+    **/
+    void insert(const value_type& x)
+    {
+        _generations[_current.load(std::memory_order_acquire)].insert(x);
+        if (_rotation == window_rotation::on_capacity
+            && _inserted.fetch_add(1, std::memory_order_relaxed) + 1 == _generation_capacity
+           )
+            rotate();
+    }
+
+    /** Start a new generation and retire the oldest one from the window. This is safe to call while other threads
+     *  insert and count, but only one rotation runs at a time.
+    **/
+    void rotate()
+    {
+        std::lock_guard<std::mutex> lock(_rotate_mutex);
+        auto next = (_current.load(std::memory_order_relaxed) + 1) % _generations.size();
+        _current.store(next, std::memory_order_release);
+        _inserted.store(0, std::memory_order_relaxed);
+        _generations[(next + 1) % _generations.size()].clear();
+    }
+
+    /** Reset this filter to nothing. Unlike \c rotate, this is not safe to call while other threads use the filter. **/
+    void clear()
+    {
+        for (auto& generation : _generations)
+            generation.clear();
+        _current.store(0, std::memory_order_relaxed);
+        _inserted.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    /** Call \a f with each live generation, newest first, until it returns \c true.
+     *
+     *  \returns \c true if \a f did.
+    **/
+    template <typename FFunction>
+    bool for_each_live(FFunction f) const
+    {
+        auto slots   = _generations.size();
+        auto current = _current.load(std::memory_order_acquire);
+        for (size_type age = 0; age + 1 < slots; ++age)
+            if (f(_generations[(current + slots - age) % slots]))
+                return true;
+        return false;
+    }
+
+private:
+    std::vector<filter_type> _generations;
+    size_type                _generation_capacity;
+    window_rotation          _rotation;
+    std::atomic<size_type>   _current;
+    std::atomic<size_type>   _inserted;
+    std::mutex               _rotate_mutex;
+};
+
+template <typename T>
+using sliding_window_bloom_filter = basic_sliding_window_bloom_filter<T>;
+
+template <typename T, typename TMixer = basic_mixer<T>>
+using thread_safe_sliding_window_bloom_filter = basic_sliding_window_bloom_filter<T, TMixer, thread_safe_storage>;
+
+/** \} **/
+
+}
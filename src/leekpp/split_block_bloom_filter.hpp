@@ -0,0 +1,292 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+
+#include "assert.hpp"
+#include "bloom_filter.hpp"
+#include "mixer.hpp"
+#include "simd.hpp"
+#include "storage.hpp"
+
+namespace leekpp
+{
+
+namespace detail
+{
+
+/** The odd multipliers used to select one bit in each of the eight words of a split block. These are the same salts
+ *  used by Apache Parquet and Impala.
+**/
+static constexpr std::uint32_t split_block_salts[8] =
+{
+    0x47b6137bU, 0x44974d91U, 0x8824ad5bU, 0xa2b7289dU,
+    0x705495c7U, 0x2df1424bU, 0x9efc4947U, 0x5c6bfb31U,
+};
+
+/** Calculate the expected FPR of a split block filter of \a bit_count bits with \a elements in it. This is the same
+ *  Poisson model as \c bloom_filter_params::expected_blocked_fpr, but each of the 8 bits lands in its own 32-bit word.
+**/
+inline double split_block_fpr(std::size_t bit_count, std::size_t elements)
+{
+    auto per_word = std::log(1.0 - 1.0 / 32.0);
+    return poisson_expectation(256.0 * elements / bit_count,
+                               [&] (std::size_t i) { return std::pow(1.0 - std::exp(per_word * i), 8.0); }
+                              );
+}
+
+}
+
+/** \addtogroup Filter
+ *  \{
+**/
+
+/** A Bloom filter where every element lives in a single 256-bit block made of eight 32-bit words, with exactly one bit
+ *  set in each word. This is the "split block" layout used by Apache Parquet and Impala, with the same salts. All 8 bit
+ *  positions are derived from a single 32-bit key by multiplying with 8 odd constants, so insertion and lookup are a
+ *  handful of vector instructions (see \c LEEK_USE_AVX2) with no loops or branches.
+ *
+ *  The filters are \e not bit-compatible with Parquet's: the hash is remixed with \c detail::mix64 before use (so a
+ *  weak \a THash is fine) and the block is picked with a 64-bit multiply-shift of the remixed hash, where Parquet uses
+ *  the upper 32 bits of the raw xxHash64.
+ *
+ *  The price of this speed is a higher FPR than \c basic_bloom_filter for the same number of bits, since \f$k\f$ is
+ *  fixed at 8 and a block is small. \c create_ideal accounts for this by adding bits until the split block FPR reaches
+ *  the goal, which usually costs 10-30% more space than the \c bloom_filter_params::create_ideal sizing.
+ *
+ *  \tparam T The type of value this Bloom filter is meant to store.
+ *  \tparam THash Function to use to transform a \c T into an integer. The result does not need to be well-mixed.
+ *  \tparam TStorage A block-based container of \c std::uint32_t blocks which provides contiguous access through
+ *   \c data() (see \c basic_storage).
+ *
+ *  \see https://github.com/apache/parquet-format/blob/master/BloomFilter.md
+**/
+template <typename T,
+          typename THash    = hash<T>,
+          typename TStorage = basic_storage<std::uint32_t>
+         >
+class basic_split_block_bloom_filter :
+        private THash
+{
+public:
+    using value_type   = T;
+    using hash_type    = THash;
+    using storage_type = TStorage;
+    using block_type   = typename storage_type::block_type;
+    using size_type    = std::size_t;
+
+    /** The number of bits in a split block. **/
+    static constexpr size_type block_bits = 256;
+
+    /** The number of bits set per element. **/
+    static constexpr size_type num_hashes = 8;
+
+    static_assert(sizeof(block_type) == 4, "storage_type::block_type must be a 32-bit integer");
+
+public:
+    /** Create an instance using \a params.
+     *
+     *  \throws std::invalid_argument if \c params.bit_count is not a non-zero multiple of \c block_bits or
+     *   \c params.num_hashes is not \c num_hashes. If this exception is actually thrown depends on the \c LEEK_ASSERT
+     *   settings.
+    **/
+    explicit basic_split_block_bloom_filter(const bloom_filter_params& params, const hash_type& hash = hash_type()) :
+            THash(hash),
+            _data(params.bit_count),
+            _params(params)
+    {
+        LEEK_ASSERT(params.bit_count != 0 && params.bit_count % block_bits == 0,
+                    invalid_argument,
+                    ("The bit count %zu is not a multiple of the split block size %zu",
+                     params.bit_count,
+                     size_type(block_bits)
+                    )
+                   );
+        LEEK_ASSERT(params.num_hashes == num_hashes,
+                    invalid_argument,
+                    ("A split block filter always uses %zu hashes, not %zu", size_type(num_hashes), params.num_hashes)
+                   );
+        clear();
+    }
+
+    /** Creates the smallest \c basic_split_block_bloom_filter whose \c expected_fpr for \a expected_elements is no
+     *  worse than \a desired_fpr.
+    **/
+    static basic_split_block_bloom_filter create_ideal(double desired_fpr, std::size_t expected_elements)
+    {
+        auto guess = bloom_filter_params::create_ideal(desired_fpr, expected_elements);
+        auto fpr_of = [&] (size_type blocks)
+                      {
+                          return detail::split_block_fpr(blocks * block_bits, expected_elements);
+                      };
+
+        // Find an upper bound on the block count by growing the standard sizing, then binary search down to the
+        // smallest count which meets the goal.
+        size_type low  = 0;
+        size_type high = guess.bit_count / block_bits + 1;
+        while (fpr_of(high) > desired_fpr)
+        {
+            low  = high;
+            high = high + high / 4 + 1;
+        }
+        while (high - low > 1)
+        {
+            auto mid = low + (high - low) / 2;
+            if (fpr_of(mid) > desired_fpr)
+                low = mid;
+            else
+                high = mid;
+        }
+
+        return basic_split_block_bloom_filter(bloom_filter_params(high * block_bits, num_hashes));
+    }
+
+    /** Get the parameters used for this Bloom filter. \c num_hashes is always 8. **/
+    const bloom_filter_params& params() const
+    {
+        return _params;
+    }
+
+    /** Get the contents of this Bloom filter. **/
+    const storage_type& data() const
+    {
+        return _data;
+    }
+
+    /** Calculate the expected false positive rate of this filter if \a elements distinct values were inserted. This is
+     *  higher than \c bloom_filter_params::expected_fpr predicts for the same parameters.
+     *
+     *  \see bloom_filter_params::expected_blocked_fpr
+    **/
+    double expected_fpr(std::size_t elements) const
+    {
+        return detail::split_block_fpr(_params.bit_count, elements);
+    }
+
+    /** Test for the likely presence of \a x in this filter instance.
+     *
+     *  \returns \c 0 if the value is not present in this filter; \c 1 if it looks like the value is present.
+     *  \see basic_bloom_filter::count
+    **/
+    size_type count(const value_type& x) const
+    {
+        auto hash = detail::mix64(THash::operator()(x));
+        return count_impl(_data.data() + word_offset(hash), std::uint32_t(hash));
+    }
+
+    /** Insert the value \a x into this filter. Inserting the same value multiple times has no effect. **/
+    void insert(const value_type& x)
+    {
+        auto hash = detail::mix64(THash::operator()(x));
+        insert_impl(_data.data() + word_offset(hash), std::uint32_t(hash));
+    }
+
+    /** Hash \a x ahead of time for \c count_hash and \c insert_hash. Like \c basic_bloom_filter::hash_value, this is
+     *  static and uses a default-constructed \c hash_type, so the result matches \c count and \c insert only on filters
+     *  which were constructed with a \c hash_type that hashes like the default one.
+    **/
+    template <typename U>
+    static hashed_value hash_value(const U& x)
+    {
+        return hashed_value{ std::uint64_t(hash_type()(x)) };
+    }
+
+    /** Test for the likely presence of the value \a hashed was created from. **/
+    size_type count_hash(const hashed_value& hashed) const
+    {
+        auto hash = detail::mix64(hashed.value);
+        return count_impl(_data.data() + word_offset(hash), std::uint32_t(hash));
+    }
+
+    /** Insert the value \a hashed was created from. **/
+    void insert_hash(const hashed_value& hashed)
+    {
+        auto hash = detail::mix64(hashed.value);
+        insert_impl(_data.data() + word_offset(hash), std::uint32_t(hash));
+    }
+
+    /** Test for the likely presence of a value equivalent to \a x, without converting \a x to a \c value_type.
+     *
+     *  \see basic_bloom_filter::count(const U&) const
+    **/
+    template <typename U>
+    auto count(const U& x) const
+            -> typename std::enable_if<detail::is_heterogeneous_key<basic_split_block_bloom_filter, T, U>::value,
+                                       size_type
+                                      >::type
+    {
+        auto hash = detail::mix64(THash::operator()(x));
+        return count_impl(_data.data() + word_offset(hash), std::uint32_t(hash));
+    }
+
+    /** Insert a value equivalent to \a x, without converting \a x to a \c value_type. **/
+    template <typename U>
+    auto insert(const U& x)
+            -> typename std::enable_if<detail::is_heterogeneous_key<basic_split_block_bloom_filter, T, U>::value>::type
+    {
+        auto hash = detail::mix64(THash::operator()(x));
+        insert_impl(_data.data() + word_offset(hash), std::uint32_t(hash));
+    }
+
+    /** Reset the contents of this filter to nothing. **/
+    void clear()
+    {
+        _data.clear();
+    }
+
+private:
+    /** The block is selected with the high bits of \a hash, while the key for bits within the block is the low 32. **/
+    size_type word_offset(std::uint64_t hash) const
+    {
+        return size_type(detail::reduce(hash, _params.bit_count / block_bits)) * (block_bits / 32);
+    }
+
+#if LEEK_USE_AVX2
+    static __m256i make_mask(std::uint32_t key)
+    {
+        const __m256i salts = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(detail::split_block_salts));
+        __m256i shifts = _mm256_srli_epi32(_mm256_mullo_epi32(_mm256_set1_epi32(int(key)), salts), 27);
+        return _mm256_sllv_epi32(_mm256_set1_epi32(1), shifts);
+    }
+
+    static size_type count_impl(const block_type* block, std::uint32_t key)
+    {
+        __m256i contents = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+        return size_type(_mm256_testc_si256(contents, make_mask(key)));
+    }
+
+    static void insert_impl(block_type* block, std::uint32_t key)
+    {
+        __m256i* dest = reinterpret_cast<__m256i*>(block);
+        _mm256_storeu_si256(dest, _mm256_or_si256(_mm256_loadu_si256(dest), make_mask(key)));
+    }
+#else
+    static size_type count_impl(const block_type* block, std::uint32_t key)
+    {
+        // Accumulate instead of returning early so the compiler is free to vectorize the loop
+        block_type missing = 0;
+        for (size_type word = 0; word < 8; ++word)
+            missing |= ~block[word] & (block_type(1) << ((key * detail::split_block_salts[word]) >> 27));
+        return missing == 0 ? 1 : 0;
+    }
+
+    static void insert_impl(block_type* block, std::uint32_t key)
+    {
+        for (size_type word = 0; word < 8; ++word)
+            block[word] |= block_type(1) << ((key * detail::split_block_salts[word]) >> 27);
+    }
+#endif
+
+private:
+    storage_type        _data;
+    bloom_filter_params _params;
+};
+
+template <typename T>
+using split_block_bloom_filter = basic_split_block_bloom_filter<T>;
+
+/** \} **/
+
+}
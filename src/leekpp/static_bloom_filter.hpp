@@ -0,0 +1,345 @@
+#pragma once
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+
+#include "assert.hpp"
+#include "bloom_filter.hpp"
+#include "mixer.hpp"
+#include "simd.hpp"
+
+namespace leekpp
+{
+
+namespace detail
+{
+
+static constexpr double constexpr_ln2 = 0.693147180559945309417232121458176568;
+
+/** The sum of \f$\frac{y^{2i+1}}{2i+1}\f$ from \a n up, where \a term is \f$y^n\f$ and \a y2 is \f$y^2\f$. **/
+constexpr double constexpr_log_series(double y2, double term, int n)
+{
+    return n >= 60 ? 0.0 : term / n + constexpr_log_series(y2, term * y2, n + 2);
+}
+
+/** \f$\ln(x) + exponent \ln 2\f$ for \a x in [1, 2). **/
+constexpr double constexpr_log_reduced(double x, int exponent)
+{
+    return 2.0 * constexpr_log_series(((x - 1.0) / (x + 1.0)) * ((x - 1.0) / (x + 1.0)), (x - 1.0) / (x + 1.0), 1)
+         + exponent * constexpr_ln2;
+}
+
+/** The natural log of \a x, which must be positive, usable in constant expressions (\c std::log is not
+ *  \c constexpr). \a x is scaled into [1, 2) by powers of 2 (16 at a time while it is far out, to keep the recursion
+ *  shallow), where the series \f$\ln x = 2 \sum \frac{y^{2i+1}}{2i+1}\f$ with \f$y = \frac{x-1}{x+1}\f$ converges to
+ *  full \c double precision in 30 terms.
+**/
+constexpr double constexpr_log(double x, int exponent = 0)
+{
+    return x >= 65536.0     ? constexpr_log(x / 65536.0, exponent + 16)
+         : x < 1.0 / 65536.0 ? constexpr_log(x * 65536.0, exponent - 16)
+         : x >= 2.0          ? constexpr_log(x / 2.0, exponent + 1)
+         : x < 1.0           ? constexpr_log(x * 2.0, exponent - 1)
+         :                     constexpr_log_reduced(x, exponent);
+}
+
+/** Call a function a fixed number of times, with the loop unrolled. **/
+template <std::size_t KCount>
+struct unrolled
+{
+    template <typename FFunction>
+    static void for_each(FFunction& f)
+    {
+        f();
+        unrolled<KCount - 1>::for_each(f);
+    }
+
+    /** Stops at the first call which returns \c false. **/
+    template <typename FFunction>
+    static bool all_of(FFunction& f)
+    {
+        return f() && unrolled<KCount - 1>::all_of(f);
+    }
+};
+
+template <>
+struct unrolled<0>
+{
+    template <typename FFunction>
+    static void for_each(FFunction&)
+    { }
+
+    template <typename FFunction>
+    static bool all_of(FFunction&)
+    {
+        return true;
+    }
+};
+
+constexpr std::size_t round_up_bits(std::size_t bit_count, std::size_t block_bits)
+{
+    return block_bits == 0 || bit_count % block_bits == 0 ? bit_count : bit_count + block_bits - bit_count % block_bits;
+}
+
+/** \a num_hashes comes from the unrounded \a bit_count, like \c basic_bloom_filter::create_ideal. **/
+constexpr bloom_filter_params static_ideal_params_for(std::size_t bit_count,
+                                                      std::size_t expected_elements,
+                                                      std::size_t block_bits
+                                                     )
+{
+    return bloom_filter_params(round_up_bits(bit_count, block_bits),
+                               std::size_t(constexpr_ln2 * double(bit_count) / expected_elements + 0.5)
+                              );
+}
+
+}
+
+/** \addtogroup Configuration
+ *  \{
+**/
+
+/** Compile-time version of \c basic_bloom_filter::create_ideal, for the template arguments of a
+ *  \c static_bloom_filter. The number of hashes is computed from the ideal bit count, which is then rounded up to a
+ *  multiple of \a block_bits, so the result matches \c create_ideal of a filter whose mixer has those \c block_bits.
+ *
+ *  \code
+ *  constexpr auto params = leekpp::static_ideal_params(0.01, 1000);
+ *  leekpp::static_bloom_filter<int, params.bit_count, params.num_hashes> filter;
+ *  \endcode
+ *
+ *  \throws std::invalid_argument if \a desired_fpr is not in (0, 1) or \a expected_elements is 0. In a constant
+ *   expression, this is a compile error instead. Since \c LEEK_ASSERT can not be used in a constant expression, this
+ *   is thrown whatever its settings.
+**/
+constexpr bloom_filter_params static_ideal_params(double      desired_fpr,
+                                                  std::size_t expected_elements,
+                                                  std::size_t block_bits = 0
+                                                 )
+{
+    return !(0.0 < desired_fpr && desired_fpr < 1.0)
+         ? throw std::invalid_argument("static_ideal_params: desired_fpr is not in range (0.0..1.0)")
+         : expected_elements == 0
+         ? throw std::invalid_argument("static_ideal_params: expected_elements must not be 0")
+         : detail::static_ideal_params_for(std::size_t(-double(expected_elements) * detail::constexpr_log(desired_fpr)
+                                                       / (detail::constexpr_ln2 * detail::constexpr_ln2)
+                                                      ),
+                                           expected_elements,
+                                           block_bits
+                                          );
+}
+
+/** \} **/
+
+/** \addtogroup Filter
+ *  \{
+**/
+
+/** A Bloom filter whose bit count and number of hashes are template arguments instead of runtime values. The blocks are
+ *  a \c std::array inside of the object, so a \c static_bloom_filter can live on the stack or inline in another object,
+ *  with no allocation and no pointer to follow.
+ *
+ *  Since \a KBits is a constant, the mixer's reduction into the bit range is a multiply by a constant (or a mask, when
+ *  \a KBits is a power of 2) instead of a division, and the \a KHashes probes of \c count and \c insert are fully
+ *  unrolled. For a given \a TMixer, the bits set are exactly those of a \c basic_bloom_filter with the same parameters
+ *  and \c std::uint64_t blocks.
+ *
+ *  \tparam T The type of value this Bloom filter is meant to store.
+ *  \tparam KBits \f$m\f$ -- the number of bits. When \a TMixer is blocking, this must be a multiple of its
+ *   \c block_bits.
+ *  \tparam KHashes \f$k\f$ -- the number of bits to set per value.
+ *  \tparam TMixer A mixing function (see \c basic_mixer). The default generates all of its indices from one hash with
+ *   no division.
+ *
+ *  \see static_ideal_params
+**/
+template <typename    T,
+          std::size_t KBits,
+          std::size_t KHashes,
+          typename    TMixer = basic_double_hash_mixer<T>
+         >
+class static_bloom_filter
+{
+public:
+    using value_type = T;
+    using mixer_type = TMixer;
+    using block_type = std::uint64_t;
+    using size_type  = std::size_t;
+
+    static constexpr size_type bit_count   = KBits;
+    static constexpr size_type num_hashes  = KHashes;
+    static constexpr size_type block_count = (KBits + 63) / 64;
+
+    static_assert(KBits > 0, "A static_bloom_filter needs at least one bit");
+    static_assert(KHashes > 0, "A static_bloom_filter needs at least one hash");
+    static_assert(mixer_type::block_bits == 0 || KBits % mixer_type::block_bits == 0,
+                  "KBits must be a multiple of mixer_type::block_bits"
+                 );
+    static_assert(mixer_type::block_bits % 64 == 0, "mixer_type::block_bits must be a multiple of the 64-bit block");
+
+public:
+    /** Create an empty filter. **/
+    constexpr static_bloom_filter() noexcept :
+            _blocks{}
+    { }
+
+    /** Get the parameters of this filter type. **/
+    static constexpr bloom_filter_params params()
+    {
+        return bloom_filter_params(KBits, KHashes);
+    }
+
+    /** Get the contents of this Bloom filter. **/
+    const std::array<block_type, block_count>& data() const
+    {
+        return _blocks;
+    }
+
+    /** Calculate the expected false positive rate of this filter if \a elements distinct values were inserted.
+     *
+     *  \see basic_bloom_filter::expected_fpr
+    **/
+    double expected_fpr(std::size_t elements) const
+    {
+        return mixer_type::block_bits == 0 ? params().expected_fpr(elements)
+                                           : params().expected_blocked_fpr(elements, mixer_type::block_bits);
+    }
+
+    /** Get the number of bits in this filter which are set to 1. **/
+    size_type set_bits() const
+    {
+        return detail::popcount_bytes(_blocks.data(), sizeof _blocks);
+    }
+
+    /** Estimate the number of distinct values which have been inserted into this filter.
+     *
+     *  \see bloom_filter_params::estimated_count
+    **/
+    size_type estimated_size() const
+    {
+        return params().estimated_count(set_bits());
+    }
+
+    /** Test for the likely presence of \a x in this filter instance.
+     *
+     *  \returns \c 0 if the value is not present in this filter; \c 1 if it looks like the value is present.
+     *  \see basic_bloom_filter::count
+    **/
+    size_type count(const value_type& x) const
+    {
+        mixer_type mixer(x, KBits);
+        return count_impl(mixer);
+    }
+
+    /** Insert the value \a x into this filter. Inserting the same value multiple times has no effect. **/
+    void insert(const value_type& x)
+    {
+        mixer_type mixer(x, KBits);
+        insert_impl(mixer);
+    }
+
+    /** \see basic_bloom_filter::count(const U&) const **/
+    template <typename U>
+    auto count(const U& x) const
+            -> typename std::enable_if<detail::is_heterogeneous_key<mixer_type, value_type, U>::value, size_type>::type
+    {
+        mixer_type mixer(x, KBits);
+        return count_impl(mixer);
+    }
+
+    /** \see basic_bloom_filter::insert(const U&) **/
+    template <typename U>
+    auto insert(const U& x)
+            -> typename std::enable_if<detail::is_heterogeneous_key<mixer_type, value_type, U>::value>::type
+    {
+        mixer_type mixer(x, KBits);
+        insert_impl(mixer);
+    }
+
+    /** \see basic_bloom_filter::hash_value **/
+    template <typename U>
+    static hashed_value hash_value(const U& x)
+    {
+        return hashed_value{ std::uint64_t(typename mixer_type::hash_type()(x)) };
+    }
+
+    /** \see basic_bloom_filter::count_hash **/
+    size_type count_hash(const hashed_value& hashed) const
+    {
+        mixer_type mixer(hashed, KBits);
+        return count_impl(mixer);
+    }
+
+    /** \see basic_bloom_filter::insert_hash **/
+    void insert_hash(const hashed_value& hashed)
+    {
+        mixer_type mixer(hashed, KBits);
+        insert_impl(mixer);
+    }
+
+    /** Add everything in \a other to this filter. Since the parameters are part of the type, the filters are always
+     *  compatible.
+    **/
+    static_bloom_filter& union_with(const static_bloom_filter& other)
+    {
+        detail::or_bytes(_blocks.data(), other._blocks.data(), sizeof _blocks);
+        return *this;
+    }
+
+    /** Reset the contents of this filter to nothing. **/
+    void clear()
+    {
+        _blocks.fill(0);
+    }
+
+private:
+    template <typename UMixer>
+    typename std::enable_if<!detail::has_block_mask<UMixer>::value, size_type>::type
+    count_impl(UMixer& mixer) const
+    {
+        auto probe = [&] ()
+                     {
+                         auto bit_idx = mixer();
+                         return ((_blocks[bit_idx / 64] >> (bit_idx % 64)) & 1) != 0;
+                     };
+        return detail::unrolled<KHashes>::all_of(probe) ? 1 : 0;
+    }
+
+    template <typename UMixer>
+    typename std::enable_if<!detail::has_block_mask<UMixer>::value>::type
+    insert_impl(UMixer& mixer)
+    {
+        auto set = [&] ()
+                   {
+                       auto bit_idx = mixer();
+                       _blocks[bit_idx / 64] |= block_type(1) << (bit_idx % 64);
+                   };
+        detail::unrolled<KHashes>::for_each(set);
+    }
+
+    template <typename UMixer>
+    typename std::enable_if<detail::has_block_mask<UMixer>::value, size_type>::type
+    count_impl(UMixer& mixer) const
+    {
+        auto mask = block_type(mixer.block_mask(KHashes));
+        return (_blocks[mixer.base_offset() / 64] & mask) == mask ? 1 : 0;
+    }
+
+    template <typename UMixer>
+    typename std::enable_if<detail::has_block_mask<UMixer>::value>::type
+    insert_impl(UMixer& mixer)
+    {
+        auto mask = block_type(mixer.block_mask(KHashes));
+        _blocks[mixer.base_offset() / 64] |= mask;
+    }
+
+private:
+    std::array<block_type, block_count> _blocks;
+};
+
+/** \} **/
+
+}
@@ -0,0 +1,198 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace leekpp
+{
+
+/** \addtogroup Statistics
+ *  \{
+ *
+ *  A \e statistics policy counts the operations on a \c basic_bloom_filter. The filter derives from its policy, so
+ *  the default \c no_stats takes no space, and calls the recording functions from \c const lookups, so a policy keeps
+ *  its counters in \c mutable or atomic members.
+ *
+ *  ### Requirements
+ *
+ *   - `S` is a \e statistics policy type
+ *   - `s` is a (possibly \c const) instance of `S`
+ *   - `n` and `p` are counts
+ *
+ *  | Expression                 | Notes                                                                           |
+ *  |:--------------------------:|:--------------------------------------------------------------------------------|
+ *  | `s.record_inserts(n)`      | `n` values were inserted.                                                       |
+ *  | `s.record_queries(n, p)`   | `n` values were looked up, of which `p` tested positively.                      |
+ *  | `s.counters()` -> `filter_counters` | Get the totals so far.                                                 |
+ *  | `s.reset_counters()`       | Set the totals back to 0.                                                       |
+**/
+
+/** The operation totals kept by a statistics policy. **/
+struct filter_counters
+{
+    /** The number of values inserted, including repeats. **/
+    std::uint64_t inserts;
+
+    /** The number of lookups. **/
+    std::uint64_t queries;
+
+    /** The number of lookups which tested positively. **/
+    std::uint64_t positives;
+};
+
+/** The statistics policy which keeps nothing. Every recording function is an empty inline function, so a filter using
+ *  it compiles to the same code as one without statistics.
+**/
+struct no_stats
+{
+    void record_inserts(std::size_t) const
+    { }
+
+    void record_queries(std::size_t, std::size_t) const
+    { }
+
+    filter_counters counters() const
+    {
+        return filter_counters{ 0, 0, 0 };
+    }
+
+    void reset_counters()
+    { }
+};
+
+namespace detail
+{
+
+/** Get a small number which is different for each of the first threads to ask, so threads spread over shards. **/
+inline std::size_t thread_shard_index()
+{
+    static std::atomic<std::size_t> next_index(0);
+    static thread_local const std::size_t index = next_index.fetch_add(1, std::memory_order_relaxed);
+    return index;
+}
+
+}
+
+/** A statistics policy which keeps relaxed atomic counters split over \a KShards cache lines. Each thread records to
+ *  the shard picked by the order in which it first recorded anything, so with up to \a KShards threads, no two
+ *  threads write the same cache line and recording is an uncontended atomic add. \c counters sums the shards with
+ *  relaxed loads, so reading the totals never blocks or slows writers; a total read while other threads record is a
+ *  little behind, but never torn.
+ *
+ *  \tparam KShards The number of counter shards. Use at least the number of threads which use the filter at once.
+**/
+template <std::size_t KShards = 16>
+class basic_sharded_stats
+{
+public:
+    static_assert(KShards > 0, "There must be at least one shard");
+
+public:
+    basic_sharded_stats() = default;
+
+    /** Copies the totals into the first shard of this instance. **/
+    basic_sharded_stats(const basic_sharded_stats& src)
+    {
+        auto totals = src.counters();
+        _shards[0].inserts.store(totals.inserts, std::memory_order_relaxed);
+        _shards[0].queries.store(totals.queries, std::memory_order_relaxed);
+        _shards[0].positives.store(totals.positives, std::memory_order_relaxed);
+    }
+
+    basic_sharded_stats& operator=(const basic_sharded_stats& src)
+    {
+        auto totals = src.counters();
+        reset_counters();
+        _shards[0].inserts.store(totals.inserts, std::memory_order_relaxed);
+        _shards[0].queries.store(totals.queries, std::memory_order_relaxed);
+        _shards[0].positives.store(totals.positives, std::memory_order_relaxed);
+        return *this;
+    }
+
+    void record_inserts(std::size_t count) const
+    {
+        local().inserts.fetch_add(count, std::memory_order_relaxed);
+    }
+
+    void record_queries(std::size_t count, std::size_t positives) const
+    {
+        auto& shard = local();
+        shard.queries.fetch_add(count, std::memory_order_relaxed);
+        if (positives != 0)
+            shard.positives.fetch_add(positives, std::memory_order_relaxed);
+    }
+
+    filter_counters counters() const
+    {
+        filter_counters out = { 0, 0, 0 };
+        for (const auto& shard : _shards)
+        {
+            out.inserts   += shard.inserts.load(std::memory_order_relaxed);
+            out.queries   += shard.queries.load(std::memory_order_relaxed);
+            out.positives += shard.positives.load(std::memory_order_relaxed);
+        }
+        return out;
+    }
+
+    void reset_counters()
+    {
+        for (auto& shard : _shards)
+        {
+            shard.inserts.store(0, std::memory_order_relaxed);
+            shard.queries.store(0, std::memory_order_relaxed);
+            shard.positives.store(0, std::memory_order_relaxed);
+        }
+    }
+
+private:
+    struct alignas(64) shard
+    {
+        std::atomic<std::uint64_t> inserts{ 0 };
+        std::atomic<std::uint64_t> queries{ 0 };
+        std::atomic<std::uint64_t> positives{ 0 };
+    };
+
+    shard& local() const
+    {
+        return _shards[detail::thread_shard_index() % KShards];
+    }
+
+private:
+    mutable shard _shards[KShards];
+};
+
+/** \see basic_sharded_stats **/
+using sharded_stats = basic_sharded_stats<>;
+
+/** A point-in-time view of a filter for exporting to a metrics system, from \c basic_bloom_filter::snapshot. **/
+struct filter_stats
+{
+    /** The operation totals from the statistics policy (all 0 with \c no_stats). **/
+    filter_counters counters;
+
+    /** The number of bits which are set to 1. **/
+    std::size_t set_bits;
+
+    /** The estimated number of distinct values inserted (see \c bloom_filter_params::estimated_count). **/
+    std::size_t estimated_size;
+
+    /** The FPR the filter's model predicts for \c estimated_size values. **/
+    double expected_fpr;
+
+    /** The FPR measured from the current fill of the filter. When this drifts above \c expected_fpr, the values or hash
+     *  are not as well-distributed as the model assumes. With a blocking mixer, the fill of individual blocks is not
+     *  known, so this is the same as \c expected_fpr.
+    **/
+    double estimated_fpr;
+
+    /** Get the fraction of lookups which tested positively. **/
+    double hit_ratio() const
+    {
+        return counters.queries == 0 ? 0.0 : double(counters.positives) / double(counters.queries);
+    }
+};
+
+/** \} **/
+
+}
@@ -1,13 +1,68 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cstdint>
+#include <memory>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
+#include "aligned_allocator.hpp"
+#include "numa_allocator.hpp"
+#include "simd.hpp"
+
 namespace leekpp
 {
 
+namespace detail
+{
+
+/** Hint to the CPU that the cache line containing \a addr will be needed soon. **/
+inline void prefetch(const void* addr)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(addr);
+#else
+    static_cast<void>(addr);
+#endif
+}
+
+/** Does \c TStorage provide its blocks as a contiguous array through \c data()? Bulk operations use this to work on
+ *  the whole array at once instead of going block by block.
+**/
+template <typename TStorage>
+class has_contiguous_data
+{
+    template <typename UStorage>
+    static auto check(const UStorage* storage)
+            -> decltype(static_cast<const typename UStorage::block_type*>(storage->data()), std::true_type());
+
+    static std::false_type check(...);
+
+public:
+    static constexpr bool value = decltype(check(static_cast<const TStorage*>(nullptr)))::value;
+};
+
+/** The number of consecutive blocks of \c TStorage which share state, so threads which write at the same time must own
+ *  whole runs of them (see \c insert_parallel). This is \c TStorage::partition_blocks, or 0 if there is no such member,
+ *  which means the storage has not declared that threads can write disjoint blocks of it at all.
+**/
+template <typename TStorage>
+class storage_partition_blocks
+{
+    template <typename UStorage>
+    static std::integral_constant<std::size_t, UStorage::partition_blocks> check(const UStorage*);
+
+    static std::integral_constant<std::size_t, 0> check(...);
+
+public:
+    static constexpr std::size_t value = decltype(check(static_cast<const TStorage*>(nullptr)))::value;
+};
+
+}
+
 /** \addtogroup Storage
  *  \{
  *
@@ -28,8 +83,12 @@ namespace leekpp
  *  | `S(bc)`             | Create a storage with at least `bc` bits.                                                  |
  *  | `S::block_type`     | Member type of `B`.                                                                        |
  *  | `s[bi]` -> `b`      | Load the block at `bi`.                                                                    |
+ *  | `s.prefetch(bi)`    | Hint that the block at `bi` will be accessed soon. This is allowed to do nothing.          |
  *  | `s.set_mask(bi, m)` | Add the provided mask `m` to the block at `bi` (using a form of `or`).                     |
+ *  | `s.and_mask(bi, m)` | Keep only the bits of the block at `bi` which are in `m`. (Optional, for intersections)    |
+ *  | `s.clear_mask(bi, m)` | Undo a `set_mask(bi, m)`. (Optional, for \c basic_bloom_filter::erase)                  |
  *  | `s.clear()`         | Reset the contents of this storage to 0.                                                   |
+ *  | `s.set_bit_count()` | The number of set bits, kept up to date. (Optional, for \c basic_bloom_filter::set_bits)   |
 **/
 
 /** Provides dynamically-allocated block storage.
@@ -49,6 +108,9 @@ public:
     using allocator_type       = typename backing_storage_type::allocator_type;
 
     static_assert(std::is_integral<block_type>::value, "TBlock must be an integral type.");
+
+    /** Blocks share no state, so threads can write disjoint blocks at the same time. **/
+    static constexpr size_type partition_blocks = 1;
     
 public:
     static constexpr size_type block_count(size_type bit_count)
@@ -75,11 +137,33 @@ public:
     {
         return _storage[idx];
     }
+
+    /** Get a pointer to the contiguous array of \c block_count blocks. **/
+    block_type* data()
+    {
+        return _storage.data();
+    }
+
+    /** \copydoc data **/
+    const block_type* data() const
+    {
+        return _storage.data();
+    }
+
+    void prefetch(size_type idx) const
+    {
+        detail::prefetch(&_storage[idx]);
+    }
     
     void set_mask(size_type block_idx, const block_type& mask)
     {
         _storage.at(block_idx) |= mask;
     }
+
+    void and_mask(size_type block_idx, const block_type& mask)
+    {
+        _storage.at(block_idx) &= mask;
+    }
     
     void clear()
     {
@@ -94,6 +178,25 @@ private:
 /** \see basic_storage **/
 using storage = basic_storage<>;
 
+/** A \c basic_storage whose block array is aligned to \a KAlignment bytes (a cache line by default), so that each
+ *  group of a \c basic_cache_aligned_mixer lies on a single cache line.
+ *
+ *  \see aligned_allocator
+**/
+template <typename    TBlock     = std::size_t,
+          std::size_t KAlignment = 64,
+          page_mode   KPages     = page_mode::normal
+         >
+using basic_aligned_storage = basic_storage<TBlock,
+                                            std::vector<TBlock, aligned_allocator<TBlock, KAlignment, KPages>>
+                                           >;
+
+/** \see basic_aligned_storage **/
+using aligned_storage = basic_aligned_storage<>;
+
+/** Cache line-aligned storage which is backed by transparent huge pages once it is large enough to use them. **/
+using huge_page_storage = basic_aligned_storage<std::size_t, 64, page_mode::transparent_huge>;
+
 /** Similar to \c basic_storage, but bit operations are performed in a thread-safe manner.
  *
  *  \tparam TBlock The type of block to store. This must be an integral type.
@@ -112,14 +215,17 @@ public:
 
     static_assert(std::is_integral<block_type>::value, "TBlock must be an integral type.");
 
+    static constexpr size_type partition_blocks = 1;
+
 public:
     static constexpr size_type block_count(size_type bit_count)
     {
         return basic_storage<block_type>::block_count(bit_count);
     }
 
+    // std::atomic is not copyable, so the blocks are value-initialized (to 0) instead of copied from a zero block.
     explicit basic_thread_safe_storage(size_type bit_count, const allocator_type& alloc = allocator_type()) :
-            _storage(block_count(bit_count), block_type(0), alloc),
+            _storage(block_count(bit_count), alloc),
             _bit_count(bit_count)
     { }
 
@@ -138,11 +244,21 @@ public:
         return _storage[idx].load(std::memory_order_relaxed);
     }
 
+    void prefetch(size_type idx) const
+    {
+        detail::prefetch(&_storage[idx]);
+    }
+
     void set_mask(size_type block_idx, const block_type& mask)
     {
         _storage.at(block_idx).fetch_or(mask, std::memory_order_relaxed);
     }
 
+    void and_mask(size_type block_idx, const block_type& mask)
+    {
+        _storage.at(block_idx).fetch_and(mask, std::memory_order_relaxed);
+    }
+
     void clear()
     {
         for (auto& block : _storage)
@@ -157,6 +273,318 @@ private:
 /** Simple thread-safe storage. **/
 using thread_safe_storage = basic_thread_safe_storage<>;
 
+/** Storage whose block array lives on the NUMA node given to its allocator, as in
+ *  <tt>numa_storage(bit_count, numa_allocator<std::size_t>(node))</tt>.
+ *
+ *  \see numa_allocator
+**/
+using numa_storage = basic_storage<std::size_t, std::vector<std::size_t, numa_allocator<std::size_t>>>;
+
+/** Thread-safe storage whose block array lives on the NUMA node given to its allocator. **/
+using numa_thread_safe_storage = basic_thread_safe_storage<std::size_t,
+                                                           std::vector<std::atomic<std::size_t>,
+                                                                       numa_allocator<std::atomic<std::size_t>>
+                                                                      >
+                                                          >;
+
+/** Similar to \c basic_thread_safe_storage, but \c set_mask loads the block first and skips the atomic
+ *  read-modify-write when every bit of the mask is already set.
+ *
+ *  An unconditional \c fetch_or takes exclusive ownership of the cache line, even when it changes nothing, so many
+ *  threads inserting into the same filter spend their time passing lines back and forth between cores. Once a filter
+ *  is a reasonable fraction full, most masks are already fully set and a plain load -- which lets every core keep a
+ *  shared copy of the line -- is all that is needed. The cost is an extra load when the bits are \e not set, which is
+ *  why this is not the behavior of \c basic_thread_safe_storage: for filters which are mostly empty or only written by
+ *  a single thread, the unconditional \c fetch_or is slightly faster.
+ *
+ *  \tparam TBlock The type of block to store. This must be an integral type.
+ *  \tparam TBackingStorage The "real" type to store data in.
+**/
+template <typename TBlock          = std::size_t,
+          typename TBackingStorage = std::vector<std::atomic<TBlock>>
+         >
+class basic_contention_aware_storage :
+        public basic_thread_safe_storage<TBlock, TBackingStorage>
+{
+public:
+    using base_type  = basic_thread_safe_storage<TBlock, TBackingStorage>;
+    using block_type = typename base_type::block_type;
+    using size_type  = typename base_type::size_type;
+
+public:
+    using base_type::base_type;
+
+    void set_mask(size_type block_idx, const block_type& mask)
+    {
+        if (((*this)[block_idx] & mask) != mask)
+            base_type::set_mask(block_idx, mask);
+    }
+};
+
+/** \see basic_contention_aware_storage **/
+using contention_aware_storage = basic_contention_aware_storage<>;
+
+/** Wraps another storage and keeps a running count of its set bits, so \c basic_bloom_filter::set_bits and
+ *  \c basic_bloom_filter::estimated_size are constant-time instead of a pass over every block. Each \c set_mask loads
+ *  the block first to count the bits it newly sets; with blocks in the cache (the common case right after the mixer
+ *  touches them) that costs a few cycles per insert.
+ *
+ *  The blocks are only reachable through the storage interface -- there is no \c data() -- so bulk operations such as
+ *  \c basic_bloom_filter::union_with and loading go block by block through \c set_mask and keep the count exact. The
+ *  count is atomic (updated with relaxed adds), so threads which write disjoint blocks, as \c insert_parallel and
+ *  \c merge_parallel do, keep it exact. Threads writing the same block at once can count a bit twice, so this should
+ *  not wrap a thread-safe storage which is shared by concurrent \c insert calls.
+ *
+ *  \tparam TStorage The storage to keep the blocks in.
+**/
+template <typename TStorage = basic_storage<>>
+class basic_counted_storage
+{
+public:
+    using storage_type = TStorage;
+    using block_type   = typename storage_type::block_type;
+    using size_type    = typename storage_type::size_type;
+
+    static constexpr size_type partition_blocks = detail::storage_partition_blocks<storage_type>::value;
+
+public:
+    static constexpr size_type block_count(size_type bit_count)
+    {
+        return storage_type::block_count(bit_count);
+    }
+
+    explicit basic_counted_storage(size_type bit_count) :
+            _storage(bit_count),
+            _set_bits(0)
+    { }
+
+    /** Take over the already-populated \a storage, counting the bits that are set in it. **/
+    explicit basic_counted_storage(storage_type storage) :
+            _storage(std::move(storage)),
+            _set_bits(0)
+    {
+        size_type set_bits = 0;
+        for (size_type block_idx = 0; block_idx < _storage.block_count(); ++block_idx)
+            set_bits += detail::popcount(std::uint64_t(_storage[block_idx]));
+        _set_bits.store(set_bits, std::memory_order_relaxed);
+    }
+
+    // std::atomic is not copyable, so the count is copied by value
+    basic_counted_storage(const basic_counted_storage& src) :
+            _storage(src._storage),
+            _set_bits(src.set_bit_count())
+    { }
+
+    basic_counted_storage(basic_counted_storage&& src) :
+            _storage(std::move(src._storage)),
+            _set_bits(src.set_bit_count())
+    { }
+
+    basic_counted_storage& operator=(const basic_counted_storage& src)
+    {
+        _storage = src._storage;
+        _set_bits.store(src.set_bit_count(), std::memory_order_relaxed);
+        return *this;
+    }
+
+    basic_counted_storage& operator=(basic_counted_storage&& src)
+    {
+        _storage = std::move(src._storage);
+        _set_bits.store(src.set_bit_count(), std::memory_order_relaxed);
+        return *this;
+    }
+
+    size_type bit_count() const
+    {
+        return _storage.bit_count();
+    }
+
+    size_type block_count() const
+    {
+        return _storage.block_count();
+    }
+
+    block_type operator[](size_type idx) const
+    {
+        return _storage[idx];
+    }
+
+    void prefetch(size_type idx) const
+    {
+        _storage.prefetch(idx);
+    }
+
+    void set_mask(size_type block_idx, const block_type& mask)
+    {
+        auto added = block_type(mask & ~_storage[block_idx]);
+        _storage.set_mask(block_idx, mask);
+        _set_bits.fetch_add(detail::popcount(std::uint64_t(added)), std::memory_order_relaxed);
+    }
+
+    template <typename UStorage = storage_type>
+    auto and_mask(size_type block_idx, const block_type& mask)
+            -> decltype(std::declval<UStorage&>().and_mask(block_idx, mask), void())
+    {
+        auto removed = block_type(_storage[block_idx] & ~mask);
+        _storage.and_mask(block_idx, mask);
+        _set_bits.fetch_sub(detail::popcount(std::uint64_t(removed)), std::memory_order_relaxed);
+    }
+
+    /** Forwarded when \c storage_type supports it. For a storage like \c counting_storage, a bit only clears when its
+     *  last reference goes, so the block is compared before and after.
+    **/
+    template <typename UStorage = storage_type>
+    auto clear_mask(size_type block_idx, const block_type& mask)
+            -> decltype(std::declval<UStorage&>().clear_mask(block_idx, mask), void())
+    {
+        auto before = _storage[block_idx];
+        _storage.clear_mask(block_idx, mask);
+        _set_bits.fetch_sub(detail::popcount(std::uint64_t(before & ~_storage[block_idx])), std::memory_order_relaxed);
+    }
+
+    void clear()
+    {
+        _storage.clear();
+        _set_bits.store(0, std::memory_order_relaxed);
+    }
+
+    /** Get the number of bits which are set to 1. **/
+    size_type set_bit_count() const
+    {
+        return _set_bits.load(std::memory_order_relaxed);
+    }
+
+    /** Get the wrapped storage. **/
+    const storage_type& storage() const
+    {
+        return _storage;
+    }
+
+private:
+    storage_type           _storage;
+    std::atomic<size_type> _set_bits;
+};
+
+/** \see basic_counted_storage **/
+using counted_storage = basic_counted_storage<>;
+
+/** Storage which keeps its blocks in fixed-size pages which copies share until one of them writes. Copying the storage
+ *  copies a pointer per page instead of the bit array, and the first write to a shared page duplicates just that page,
+ *  so copying a large filter to make a small change (as \c basic_published_filter::update does) costs
+ *  \f$O(m / P)\f$ plus one page per touched page instead of \f$O(m)\f$. Writes which would not change a block do not
+ *  duplicate its page, so re-inserting values which are already present copies nothing.
+ *
+ *  Every page starts out as a single shared page of zeros, so an empty filter takes one pointer per page and \c clear
+ *  is a pass over the pointers.
+ *
+ *  Sharing is tracked by the reference counts of the pages, so a copy may be read from any thread, but only the one
+ *  copy being written may be written to -- this is not thread-safe storage. Duplicating a page replaces the pointer
+ *  every block of the page is reached through, so \c partition_blocks makes \c insert_parallel and \c merge_parallel
+ *  give each thread whole pages.
+ *
+ *  \tparam TBlock The type of block to store. This must be an integral type.
+ *  \tparam KPageBlocks The number of blocks in a page. The default is 4 KiB of 64-bit blocks.
+**/
+template <typename    TBlock      = std::size_t,
+          std::size_t KPageBlocks = 512
+         >
+class basic_cow_storage
+{
+public:
+    using block_type = TBlock;
+    using size_type  = std::size_t;
+
+    static constexpr size_type page_blocks = KPageBlocks;
+
+    /** Blocks of the same page must not be written by different threads at once. **/
+    static constexpr size_type partition_blocks = KPageBlocks;
+
+    static_assert(std::is_integral<block_type>::value, "TBlock must be an integral type.");
+    static_assert(KPageBlocks > 0, "A page needs at least one block");
+
+public:
+    static constexpr size_type block_count(size_type bit_count)
+    {
+        return basic_storage<block_type>::block_count(bit_count);
+    }
+
+    explicit basic_cow_storage(size_type bit_count) :
+            _pages((block_count(bit_count) + KPageBlocks - 1) / KPageBlocks, zero_page()),
+            _bit_count(bit_count)
+    { }
+
+    size_type bit_count() const
+    {
+        return _bit_count;
+    }
+
+    size_type block_count() const
+    {
+        return block_count(_bit_count);
+    }
+
+    block_type operator[](size_type idx) const
+    {
+        return (*_pages[idx / KPageBlocks])[idx % KPageBlocks];
+    }
+
+    void prefetch(size_type idx) const
+    {
+        detail::prefetch(&(*_pages[idx / KPageBlocks])[idx % KPageBlocks]);
+    }
+
+    void set_mask(size_type block_idx, const block_type& mask)
+    {
+        if (((*this)[block_idx] & mask) != mask)
+            writable_block(block_idx) |= mask;
+    }
+
+    void and_mask(size_type block_idx, const block_type& mask)
+    {
+        if (((*this)[block_idx] & mask) != (*this)[block_idx])
+            writable_block(block_idx) &= mask;
+    }
+
+    void clear()
+    {
+        std::fill(_pages.begin(), _pages.end(), zero_page());
+    }
+
+    /** Get the number of pages which this storage does not share with any copy (or with the zero page). **/
+    size_type unshared_page_count() const
+    {
+        return size_type(std::count_if(_pages.begin(),
+                                       _pages.end(),
+                                       [] (const std::shared_ptr<page_type>& page) { return page.use_count() == 1; }
+                                      )
+                        );
+    }
+
+private:
+    using page_type = std::array<block_type, KPageBlocks>;
+
+    static const std::shared_ptr<page_type>& zero_page()
+    {
+        static const std::shared_ptr<page_type> page = std::make_shared<page_type>();
+        return page;
+    }
+
+    block_type& writable_block(size_type block_idx)
+    {
+        auto& page = _pages.at(block_idx / KPageBlocks);
+        if (page.use_count() != 1)
+            page = std::make_shared<page_type>(*page);
+        return (*page)[block_idx % KPageBlocks];
+    }
+
+private:
+    std::vector<std::shared_ptr<page_type>> _pages;
+    size_type                               _bit_count;
+};
+
+/** \see basic_cow_storage **/
+using cow_storage = basic_cow_storage<>;
+
 /** \} **/
 
 }
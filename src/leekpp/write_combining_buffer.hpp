@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "bloom_filter.hpp"
+
+namespace leekpp
+{
+
+/** \addtogroup Filter
+ *  \{
+**/
+
+/** A per-thread buffer for inserting into a shared filter. Masks are accumulated in a small direct-mapped table keyed
+ *  by block index and only written to the filter's storage when a slot is needed by a different block or on \c flush.
+ *  Inserts which hit the same block while it is buffered are combined into a single \c set_mask, so with a thread-safe
+ *  storage, each thread issues far fewer atomic operations on shared cache lines.
+ *
+ *  \code
+ *  auto filter = leekpp::contention_aware_bloom_filter<std::size_t>::create_ideal(0.01, n);
+ *  // on each thread:
+ *  leekpp::write_combining_buffer<decltype(filter)> buffer(filter);
+ *  for (auto x : my_values)
+ *      buffer.insert(x);
+ *  buffer.flush();
+ *  \endcode
+ *
+ *  Values sitting in the buffer are \e not visible through the filter until they are flushed, so \c count can have
+ *  false negatives for them in the meantime. The buffer is flushed when destroyed. A buffer must only be used by one
+ *  thread, but any number of buffers can feed the same filter as long as its storage is thread-safe.
+ *
+ *  \tparam TBloomFilter A \c basic_bloom_filter.
+ *  \tparam KSlots The number of blocks which can be buffered at once. This must be a power of 2. The default of 1024
+ *   keeps the table (16 KiB) well within the L1 cache.
+**/
+template <typename TBloomFilter,
+          std::size_t KSlots = 1024
+         >
+class write_combining_buffer
+{
+public:
+    using filter_type = TBloomFilter;
+    using value_type  = typename filter_type::value_type;
+    using block_type  = typename filter_type::block_type;
+    using size_type   = std::size_t;
+
+    static_assert(KSlots > 0 && (KSlots & (KSlots - 1)) == 0, "KSlots must be a power of 2");
+
+public:
+    explicit write_combining_buffer(filter_type& filter) :
+            _filter(filter),
+            _slots(KSlots)
+    { }
+
+    write_combining_buffer(const write_combining_buffer&) = delete;
+    write_combining_buffer& operator=(const write_combining_buffer&) = delete;
+
+    ~write_combining_buffer()
+    {
+        flush();
+    }
+
+    /** Buffer the insertion of \a x into the filter. The filter's statistics count it right away, not on \c flush. **/
+    void insert(const value_type& x)
+    {
+        _filter.visit_masks(x, [this] (size_type block_idx, block_type mask) { add(block_idx, mask); });
+        _filter.record_inserts(1);
+    }
+
+    /** Buffer the insertion of each value in the range [\a first, \a last). **/
+    template <typename TInputIterator>
+    void insert_many(TInputIterator first, TInputIterator last)
+    {
+        for ( ; first != last; ++first)
+            insert(*first);
+    }
+
+    /** Write every buffered mask to the filter. **/
+    void flush()
+    {
+        for (auto& slot : _slots)
+        {
+            if (slot.block_idx != empty_slot)
+                _filter.data().set_mask(slot.block_idx, slot.mask);
+            slot.block_idx = empty_slot;
+        }
+    }
+
+private:
+    static constexpr size_type empty_slot = ~size_type(0);
+
+    struct slot_type
+    {
+        size_type  block_idx = empty_slot;
+        block_type mask      = block_type(0);
+    };
+
+    void add(size_type block_idx, block_type mask)
+    {
+        auto& slot = _slots[block_idx & (KSlots - 1)];
+        if (slot.block_idx == block_idx)
+        {
+            slot.mask |= mask;
+            return;
+        }
+
+        if (slot.block_idx != empty_slot)
+            _filter.data().set_mask(slot.block_idx, slot.mask);
+        slot.block_idx = block_idx;
+        slot.mask      = mask;
+    }
+
+private:
+    filter_type&           _filter;
+    std::vector<slot_type> _slots;
+};
+
+/** \} **/
+
+}
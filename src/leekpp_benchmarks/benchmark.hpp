@@ -0,0 +1,146 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__linux__)
+#   include <linux/perf_event.h>
+#   include <sys/ioctl.h>
+#   include <sys/syscall.h>
+#   include <unistd.h>
+#endif
+
+namespace leekpp_benchmarks
+{
+
+/** Get how long it takes to run \a func, in seconds. **/
+template <typename FWork>
+double time_seconds(FWork func)
+{
+    auto start = std::chrono::steady_clock::now();
+    func();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count();
+}
+
+/** Get the thread counts to measure scaling with: powers of 2 below \a max_threads, then \a max_threads itself. **/
+inline std::vector<std::size_t> thread_counts(std::size_t max_threads)
+{
+    std::vector<std::size_t> out;
+    for (std::size_t threads = 1; threads < max_threads; threads *= 2)
+        out.push_back(threads);
+    out.push_back(max_threads);
+    return out;
+}
+
+/** Get the value at \a fraction (in [0, 1]) of the way through the sorted \a samples, which are reordered. **/
+inline double percentile(std::vector<double>& samples, double fraction)
+{
+    if (samples.empty())
+        return 0.0;
+    auto idx = std::size_t(fraction * (samples.size() - 1));
+    std::nth_element(samples.begin(), samples.begin() + idx, samples.end());
+    return samples[idx];
+}
+
+/** Hardware event counters for the calling thread, through \c perf_event_open. Only events in user space are counted.
+ *  When the counters are not available (not Linux, no PMU in a virtual machine, or \c perf_event_paranoid forbids it),
+ *  \c available is \c false and everything else does nothing.
+**/
+class perf_counters
+{
+public:
+    enum event
+    {
+        cache_misses,
+        branch_misses,
+        event_count
+    };
+
+public:
+    perf_counters()
+    {
+        for (int idx = 0; idx < event_count; ++idx)
+            _fds[idx] = -1;
+#if defined(__linux__)
+        const std::uint64_t configs[event_count] = { PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+        for (int idx = 0; idx < event_count; ++idx)
+        {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof attr);
+            attr.type           = PERF_TYPE_HARDWARE;
+            attr.size           = sizeof attr;
+            attr.config         = configs[idx];
+            attr.disabled       = 1;
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            _fds[idx] = int(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        }
+#endif
+    }
+
+    perf_counters(const perf_counters&) = delete;
+    perf_counters& operator=(const perf_counters&) = delete;
+
+    ~perf_counters()
+    {
+#if defined(__linux__)
+        for (int fd : _fds)
+            if (fd >= 0)
+                ::close(fd);
+#endif
+    }
+
+    bool available() const
+    {
+        for (int fd : _fds)
+            if (fd < 0)
+                return false;
+        return true;
+    }
+
+    void start()
+    {
+#if defined(__linux__)
+        if (!available())
+            return;
+        for (int fd : _fds)
+        {
+            ::ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ::ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    void stop()
+    {
+#if defined(__linux__)
+        if (!available())
+            return;
+        for (int fd : _fds)
+            ::ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+#endif
+    }
+
+    /** Get the count of \a which since the last \c start. **/
+    std::uint64_t value(event which) const
+    {
+        std::uint64_t out = 0;
+#if defined(__linux__)
+        if (available() && ::read(_fds[which], &out, sizeof out) != ssize_t(sizeof out))
+            out = 0;
+#else
+        static_cast<void>(which);
+#endif
+        return out;
+    }
+
+private:
+    int _fds[event_count];
+};
+
+}
@@ -0,0 +1,58 @@
+/** Measure how fast \c build_parallel constructs a filter as the number of threads grows, against inserting in a loop.
+ *
+ *  Usage: benchmark_build_parallel [element_count] [max_threads]
+**/
+#include "benchmark.hpp"
+
+#include <leekpp/parallel.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+template <typename TBloomFilter>
+void run_filter(const char* name, const std::vector<std::uint64_t>& values, std::size_t max_threads)
+{
+    auto params = TBloomFilter::create_ideal(0.01, values.size()).params();
+
+    auto insert_loop  = [&]
+                        {
+                            TBloomFilter filter(params);
+                            for (auto x : values)
+                                filter.insert(x);
+                        };
+    auto loop_seconds = leekpp_benchmarks::time_seconds(insert_loop);
+    std::printf("# %s\n", name);
+    std::printf("%-8s %12s %10s\n", "threads", "Mkeys/s", "speedup");
+    std::printf("%-8s %12.2f %10.2f\n", "loop", values.size() / loop_seconds / 1e6, 1.0);
+
+    for (std::size_t threads : leekpp_benchmarks::thread_counts(max_threads))
+    {
+        auto build   = [&] { leekpp::build_parallel<TBloomFilter>(values.begin(), values.end(), params, threads); };
+        auto seconds = leekpp_benchmarks::time_seconds(build);
+        std::printf("%-8zu %12.2f %10.2f\n", threads, values.size() / seconds / 1e6, loop_seconds / seconds);
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t element_count = argc > 1 ? std::stoull(argv[1]) : 50000000;
+    std::size_t max_threads   = argc > 2 ? std::stoull(argv[2]) : leekpp::detail::default_thread_count();
+
+    std::mt19937_64 rng(element_count);
+    std::vector<std::uint64_t> values(element_count);
+    for (auto& x : values)
+        x = rng();
+
+    run_filter<leekpp::bloom_filter<std::uint64_t>>("bloom_filter", values, max_threads);
+    run_filter<leekpp::cache_aligned_bloom_filter<std::uint64_t>>("cache_aligned_bloom_filter", values, max_threads);
+    return 0;
+}
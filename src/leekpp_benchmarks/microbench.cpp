@@ -0,0 +1,393 @@
+/** Measure insert and lookup cost for each mixer and storage combination, with filter sizes sweeping from
+ *  L1-resident to DRAM-resident.
+ *
+ *  Usage: benchmark_microbench [options]
+ *
+ *  | Option              | Default  | Notes                                                                       |
+ *  |:--------------------|:---------|:----------------------------------------------------------------------------|
+ *  | `--format csv|json` | `csv`    | CSV with a header row, or one JSON object per line.                         |
+ *  | `--min-bytes N`     | 16384    | The smallest filter to measure. Sizes grow by 4x up to `--max-bytes`.       |
+ *  | `--max-bytes N`     | 2^28     |                                                                             |
+ *  | `--ops N`           | 2^22     | Operations per measurement, split between the threads.                      |
+ *  | `--threads N`       | all      | The multi-threaded runs use this many threads. 1 skips them.                |
+ *  | `--config NAME`     |          | Only run configurations whose name contains `NAME`.                         |
+ *
+ *  Each filter is sized for 1% FPR at the given size in bits (counting storage uses 4 times the memory). The
+ *  workloads are \c insert starting from an empty filter, then (after filling it to capacity) \c count and
+ *  \c count_many on values which were inserted (\c hit) or not (\c miss). Multi-threaded runs only include inserts
+ *  for thread-safe storage.
+ *
+ *  Operations are timed in batches of \c batch_size, so the latency percentiles are of the per-operation average
+ *  within a batch, and include a share of the clock reads (a fraction of a nanosecond). Cache and branch misses come
+ *  from \c perf_event_open and are left empty (CSV) or \c null (JSON) where it is not available; they include the
+ *  benchmark's own key generation.
+**/
+#include "benchmark.hpp"
+
+#include <leekpp/counting_storage.hpp>
+#include <leekpp/parallel.hpp>
+#include <leekpp/split_block_bloom_filter.hpp>
+
+#include <atomic>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace
+{
+
+static constexpr std::size_t batch_size = 32;
+
+struct options
+{
+    bool        json      = false;
+    std::size_t min_bytes = std::size_t(1) << 14;
+    std::size_t max_bytes = std::size_t(1) << 28;
+    std::size_t ops       = std::size_t(1) << 22;
+    std::size_t threads   = leekpp::detail::default_thread_count();
+    std::string config;
+};
+
+struct result
+{
+    const char* config;
+    const char* workload;
+    std::size_t filter_bits;
+    std::size_t threads;
+    std::size_t ops;
+    double      seconds;
+    double      p50_ns;
+    double      p90_ns;
+    double      p99_ns;
+    bool        has_counters;
+    double      cache_misses;
+    double      branch_misses;
+};
+
+void print_header(const options& opts)
+{
+    if (!opts.json)
+        std::printf("config,workload,filter_bits,threads,ops,mops_per_sec,p50_ns,p90_ns,p99_ns,"
+                    "cache_misses_per_op,branch_misses_per_op\n"
+                   );
+}
+
+void print_result(const options& opts, const result& res)
+{
+    auto mops = res.ops / res.seconds / 1e6;
+    if (opts.json)
+    {
+        std::printf("{\"config\":\"%s\",\"workload\":\"%s\",\"filter_bits\":%zu,\"threads\":%zu,\"ops\":%zu,"
+                    "\"mops_per_sec\":%.3f,\"p50_ns\":%.3f,\"p90_ns\":%.3f,\"p99_ns\":%.3f,",
+                    res.config, res.workload, res.filter_bits, res.threads, res.ops,
+                    mops, res.p50_ns, res.p90_ns, res.p99_ns
+                   );
+        if (res.has_counters)
+            std::printf("\"cache_misses_per_op\":%.4f,\"branch_misses_per_op\":%.4f}\n",
+                        res.cache_misses,
+                        res.branch_misses
+                       );
+        else
+            std::printf("\"cache_misses_per_op\":null,\"branch_misses_per_op\":null}\n");
+    }
+    else
+    {
+        std::printf("%s,%s,%zu,%zu,%zu,%.3f,%.3f,%.3f,%.3f,",
+                    res.config, res.workload, res.filter_bits, res.threads, res.ops,
+                    mops, res.p50_ns, res.p90_ns, res.p99_ns
+                   );
+        if (res.has_counters)
+            std::printf("%.4f,%.4f\n", res.cache_misses, res.branch_misses);
+        else
+            std::printf(",\n");
+    }
+    std::fflush(stdout);
+}
+
+/** The \a idx-th key of a workload. Keys below the number of inserted values are in the filter. **/
+inline std::uint64_t key_of(std::uint64_t idx)
+{
+    return leekpp::detail::mix64(idx ^ 0x5bd1e9955bd1e995ULL);
+}
+
+template <typename TFilter>
+class has_count_many
+{
+    template <typename UFilter>
+    static auto check(const UFilter* filter)
+            -> decltype(filter->count_many(static_cast<const std::uint64_t*>(nullptr),
+                                           static_cast<const std::uint64_t*>(nullptr),
+                                           static_cast<std::size_t*>(nullptr)
+                                          ),
+                        std::true_type()
+                       );
+
+    static std::false_type check(...);
+
+public:
+    static constexpr bool value = decltype(check(static_cast<const TFilter*>(nullptr)))::value;
+};
+
+/** Keeps lookup results observable, so they are not optimized away. **/
+std::atomic<std::size_t> result_sink(0);
+
+struct thread_samples
+{
+    std::vector<double> batch_ns;
+    std::uint64_t       cache_misses  = 0;
+    std::uint64_t       branch_misses = 0;
+    bool                has_counters  = false;
+};
+
+/** Run \a ops operations in batches on the calling thread. Each batch gets \c batch_size keys: sequential from
+ *  \a key_first when \a key_range is 0, otherwise random from [\a key_first, \a key_first + \a key_range).
+**/
+template <typename FBatch>
+void run_batches(thread_samples& out,
+                 std::size_t     ops,
+                 std::uint64_t   key_first,
+                 std::uint64_t   key_range,
+                 std::uint64_t   seed,
+                 FBatch          batch
+                )
+{
+    out.batch_ns.reserve(ops / batch_size + 1);
+    leekpp_benchmarks::perf_counters counters;
+    out.has_counters = counters.available();
+
+    std::uint64_t keys[batch_size];
+    std::uint64_t next = 0;
+    counters.start();
+    for (std::size_t done = 0; done < ops; done += batch_size)
+    {
+        for (auto& key : keys)
+        {
+            auto idx = key_range == 0 ? next : leekpp::detail::reduce(leekpp::detail::mix64(seed + next), key_range);
+            key = key_of(key_first + idx);
+            ++next;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        batch(keys);
+        std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+        out.batch_ns.push_back(elapsed.count() / batch_size);
+    }
+    counters.stop();
+    out.cache_misses  = counters.value(leekpp_benchmarks::perf_counters::cache_misses);
+    out.branch_misses = counters.value(leekpp_benchmarks::perf_counters::branch_misses);
+}
+
+/** Run a workload on \a threads threads and print the result. \a make_batch is called on each worker to get the
+ *  function which runs a batch of keys, so workers can keep their own state.
+**/
+template <typename FMakeBatch>
+void run_workload(const options& opts,
+                  const char*    config,
+                  const char*    workload,
+                  std::size_t    filter_bits,
+                  std::size_t    threads,
+                  std::uint64_t  key_first,
+                  std::uint64_t  key_range,
+                  FMakeBatch     make_batch
+                 )
+{
+    std::vector<thread_samples> samples(threads);
+    auto per_thread = (opts.ops / threads + batch_size - 1) / batch_size * batch_size;
+    auto work       = [&] (std::size_t worker)
+                      {
+                          // Sequential keys are split between workers; random keys use a different seed per worker
+                          auto first = key_range == 0 ? key_first + worker * per_thread : key_first;
+                          run_batches(samples[worker], per_thread, first, key_range, worker << 40, make_batch());
+                      };
+    auto seconds = leekpp_benchmarks::time_seconds([&] { leekpp::detail::run_parallel(threads, work); });
+
+    result res;
+    res.config       = config;
+    res.workload     = workload;
+    res.filter_bits  = filter_bits;
+    res.threads      = threads;
+    res.ops          = per_thread * threads;
+    res.seconds      = seconds;
+    res.has_counters = true;
+
+    std::vector<double> batch_ns;
+    double cache_misses  = 0;
+    double branch_misses = 0;
+    for (const auto& sample : samples)
+    {
+        batch_ns.insert(batch_ns.end(), sample.batch_ns.begin(), sample.batch_ns.end());
+        cache_misses     += sample.cache_misses;
+        branch_misses    += sample.branch_misses;
+        res.has_counters &= sample.has_counters;
+    }
+    res.p50_ns        = leekpp_benchmarks::percentile(batch_ns, 0.50);
+    res.p90_ns        = leekpp_benchmarks::percentile(batch_ns, 0.90);
+    res.p99_ns        = leekpp_benchmarks::percentile(batch_ns, 0.99);
+    res.cache_misses  = cache_misses / res.ops;
+    res.branch_misses = branch_misses / res.ops;
+    print_result(opts, res);
+}
+
+template <typename TFilter>
+typename std::enable_if<has_count_many<TFilter>::value>::type
+run_count_many(const options& opts,
+               const char*    config,
+               const TFilter& filter,
+               std::size_t    threads,
+               std::size_t    inserted
+              )
+{
+    auto make_batch = [&]
+                      {
+                          return [&] (const std::uint64_t* keys)
+                                 {
+                                     std::size_t counts[batch_size];
+                                     filter.count_many(keys, keys + batch_size, counts);
+                                     std::size_t found = 0;
+                                     for (auto count : counts)
+                                         found += count;
+                                     result_sink.fetch_add(found, std::memory_order_relaxed);
+                                 };
+                      };
+    auto bits = filter.params().bit_count;
+    run_workload(opts, config, "count_many_hit", bits, threads, 0, inserted, make_batch);
+    run_workload(opts, config, "count_many_miss", bits, threads, inserted, inserted, make_batch);
+}
+
+template <typename TFilter>
+typename std::enable_if<!has_count_many<TFilter>::value>::type
+run_count_many(const options&, const char*, const TFilter&, std::size_t, std::size_t)
+{ }
+
+template <typename TFilter>
+void run_filter_size(const options& opts, const char* config, bool thread_safe_insert, std::size_t bytes)
+{
+    // The ideal filter for 1% FPR uses about 9.585 bits per value
+    auto capacity = std::size_t(bytes * 8 / 9.585);
+    auto filter   = TFilter::create_ideal(0.01, capacity);
+    auto bits     = filter.params().bit_count;
+
+    std::vector<std::size_t> thread_options{ 1 };
+    if (opts.threads > 1)
+        thread_options.push_back(opts.threads);
+
+    auto make_insert = [&]
+                       {
+                           return [&] (const std::uint64_t* keys)
+                                  {
+                                      for (std::size_t idx = 0; idx < batch_size; ++idx)
+                                          filter.insert(keys[idx]);
+                                  };
+                       };
+    auto make_count  = [&]
+                       {
+                           return [&] (const std::uint64_t* keys)
+                                  {
+                                      std::size_t found = 0;
+                                      for (std::size_t idx = 0; idx < batch_size; ++idx)
+                                          found += filter.count(keys[idx]);
+                                      result_sink.fetch_add(found, std::memory_order_relaxed);
+                                  };
+                       };
+
+    for (auto threads : thread_options)
+    {
+        if (threads > 1 && !thread_safe_insert)
+            continue;
+        filter.clear();
+        run_workload(opts, config, "insert", bits, threads, 0, 0, make_insert);
+    }
+
+    // Fill the filter to capacity, so lookups see a realistic density of set bits
+    filter.clear();
+    for (std::size_t idx = 0; idx < capacity; ++idx)
+        filter.insert(key_of(idx));
+
+    for (auto threads : thread_options)
+    {
+        run_workload(opts, config, "count_hit", bits, threads, 0, capacity, make_count);
+        run_workload(opts, config, "count_miss", bits, threads, capacity, capacity, make_count);
+        run_count_many(opts, config, filter, threads, capacity);
+    }
+}
+
+template <typename TFilter>
+void run_config(const options& opts, const char* config, bool thread_safe_insert)
+{
+    if (std::string(config).find(opts.config) == std::string::npos)
+        return;
+    for (auto bytes = opts.min_bytes; bytes <= opts.max_bytes; bytes *= 4)
+        run_filter_size<TFilter>(opts, config, thread_safe_insert, bytes);
+}
+
+bool parse_options(int argc, char** argv, options& opts)
+{
+    for (int idx = 1; idx < argc; ++idx)
+    {
+        std::string arg = argv[idx];
+        if (idx + 1 >= argc)
+            return false;
+        std::string value = argv[++idx];
+        if (arg == "--format" && (value == "csv" || value == "json"))
+            opts.json = value == "json";
+        else if (arg == "--min-bytes")
+            opts.min_bytes = std::stoull(value);
+        else if (arg == "--max-bytes")
+            opts.max_bytes = std::stoull(value);
+        else if (arg == "--ops")
+            opts.ops = std::stoull(value);
+        else if (arg == "--threads")
+            opts.threads = std::stoull(value);
+        else if (arg == "--config")
+            opts.config = value;
+        else
+            return false;
+    }
+    return opts.min_bytes > 0 && opts.ops > 0 && opts.threads > 0;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    options opts;
+    if (!parse_options(argc, argv, opts))
+    {
+        std::fprintf(stderr,
+                     "Usage: %s [--format csv|json] [--min-bytes N] [--max-bytes N] [--ops N] [--threads N] "
+                     "[--config NAME]\n",
+                     argv[0]
+                    );
+        return 1;
+    }
+
+    using key = std::uint64_t;
+    print_header(opts);
+    run_config<leekpp::bloom_filter<key>>(opts, "basic_mixer/storage", false);
+    run_config<leekpp::basic_bloom_filter<key, leekpp::basic_cache_aligned_mixer<key>>>
+            (opts, "cache_aligned_mixer/storage", false);
+    run_config<leekpp::cache_aligned_bloom_filter<key>>(opts, "cache_aligned_mixer/aligned_storage", false);
+    run_config<leekpp::basic_bloom_filter<key, leekpp::basic_cache_aligned_mixer<key>, leekpp::huge_page_storage>>
+            (opts, "cache_aligned_mixer/huge_page_storage", false);
+    run_config<leekpp::double_hash_bloom_filter<key>>(opts, "double_hash_mixer/storage", false);
+    run_config<leekpp::cache_aligned_double_hash_bloom_filter<key>>(opts,
+                                                                    "cache_aligned_double_hash_mixer/aligned_storage",
+                                                                    false
+                                                                   );
+    run_config<leekpp::register_blocked_bloom_filter<key>>(opts, "register_blocked_mixer/storage", false);
+    run_config<leekpp::split_block_bloom_filter<key>>(opts, "split_block", false);
+    run_config<leekpp::thread_safe_bloom_filter<key>>(opts, "basic_mixer/thread_safe_storage", true);
+    run_config<leekpp::thread_safe_bloom_filter<key, leekpp::basic_cache_aligned_mixer<key>>>
+            (opts, "cache_aligned_mixer/thread_safe_storage", true);
+    run_config<leekpp::contention_aware_bloom_filter<key>>(opts, "basic_mixer/contention_aware_storage", true);
+    run_config<leekpp::contention_aware_bloom_filter<key, leekpp::basic_cache_aligned_mixer<key>>>
+            (opts, "cache_aligned_mixer/contention_aware_storage", true);
+    run_config<leekpp::counting_bloom_filter<key>>(opts, "basic_mixer/counting_storage", false);
+    run_config<leekpp::thread_safe_counting_bloom_filter<key>>(opts, "basic_mixer/thread_safe_counting_storage", true);
+    return 0;
+}
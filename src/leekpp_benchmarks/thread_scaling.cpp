@@ -0,0 +1,90 @@
+/** Measure how insert throughput into a shared filter scales with the number of writer threads, comparing plain
+ *  \c thread_safe_storage, \c contention_aware_storage and both of those fed through a \c write_combining_buffer.
+ *
+ *  Usage: benchmark_thread_scaling [element_count] [max_threads]
+ *
+ *  Each configuration inserts \c element_count values split evenly between the threads into an empty filter sized for
+ *  them ("fill"), then inserts all of them again ("refill"), which is the case where the bits are already set.
+**/
+#include "benchmark.hpp"
+
+#include <leekpp/parallel.hpp>
+#include <leekpp/write_combining_buffer.hpp>
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+namespace
+{
+
+struct direct_inserter
+{
+    template <typename TBloomFilter>
+    static void run(TBloomFilter& filter, std::size_t first, std::size_t last, std::size_t stride)
+    {
+        for (std::size_t x = first; x < last; x += stride)
+            filter.insert(x);
+    }
+};
+
+struct buffered_inserter
+{
+    template <typename TBloomFilter>
+    static void run(TBloomFilter& filter, std::size_t first, std::size_t last, std::size_t stride)
+    {
+        leekpp::write_combining_buffer<TBloomFilter> buffer(filter);
+        for (std::size_t x = first; x < last; x += stride)
+            buffer.insert(x);
+    }
+};
+
+template <typename TInserter, typename TBloomFilter>
+double run_pass(TBloomFilter& filter, std::size_t element_count, std::size_t threads)
+{
+    auto work    = [&] (std::size_t worker) { TInserter::run(filter, worker, element_count, threads); };
+    auto seconds = leekpp_benchmarks::time_seconds([&] { leekpp::detail::run_parallel(threads, work); });
+    return element_count / seconds / 1e6;
+}
+
+template <typename TBloomFilter, typename TInserter>
+void run_config(const char* name, std::size_t element_count, std::size_t threads)
+{
+    auto filter = TBloomFilter::create_ideal(0.01, element_count);
+    auto fill   = run_pass<TInserter>(filter, element_count, threads);
+    auto refill = run_pass<TInserter>(filter, element_count, threads);
+    std::printf("%-40s %8zu %12.2f %12.2f\n", name, threads, fill, refill);
+}
+
+template <typename TMixer>
+void run_mixer(const char* mixer_name, std::size_t element_count, std::size_t max_threads)
+{
+    using thread_safe_filter      = leekpp::thread_safe_bloom_filter<std::size_t, TMixer>;
+    using contention_aware_filter = leekpp::contention_aware_bloom_filter<std::size_t, TMixer>;
+
+    std::printf("# %s\n", mixer_name);
+    std::printf("%-40s %8s %12s %12s\n", "storage", "threads", "fill Mop/s", "refill Mop/s");
+    for (std::size_t threads : leekpp_benchmarks::thread_counts(max_threads))
+    {
+        run_config<thread_safe_filter, direct_inserter>("thread_safe", element_count, threads);
+        run_config<contention_aware_filter, direct_inserter>("contention_aware", element_count, threads);
+        run_config<thread_safe_filter, buffered_inserter>("thread_safe+write_combining", element_count, threads);
+        run_config<contention_aware_filter, buffered_inserter>("contention_aware+write_combining",
+                                                               element_count,
+                                                               threads
+                                                              );
+    }
+}
+
+}
+
+int main(int argc, char** argv)
+{
+    std::size_t element_count = argc > 1 ? std::stoull(argv[1]) : 10000000;
+    std::size_t max_threads   = argc > 2 ? std::stoull(argv[2]) : leekpp::detail::default_thread_count();
+
+    run_mixer<leekpp::basic_mixer<std::size_t>>("basic_mixer", element_count, max_threads);
+    run_mixer<leekpp::basic_cache_aligned_mixer<std::size_t>>("basic_cache_aligned_mixer", element_count, max_threads);
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <leekpp/storage_io.hpp>
 
 #include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <iterator>
 #include <random>
@@ -18,6 +19,8 @@ namespace leekpp_tests
 class random_sequence_device
 {
 public:
+    using result_type = std::uint_least32_t;
+
     random_sequence_device& base()
     {
         return *this;
@@ -36,6 +39,23 @@ private:
     std::random_device _rng;
 };
 
+/** Build a static filter (such as \c leekpp::basic_binary_fuse_filter) from the complete set of \a values. **/
+template <typename TBloomFilter, typename TValues>
+auto build_accuracy_filter(double, const TValues& values, int)
+        -> decltype(TBloomFilter(values.begin(), values.end()))
+{
+    return TBloomFilter(values.begin(), values.end());
+}
+
+template <typename TBloomFilter, typename TValues>
+TBloomFilter build_accuracy_filter(double goal_fpr, const TValues& values, long)
+{
+    auto filter = TBloomFilter::create_ideal(goal_fpr, values.size());
+    for (const auto& x : values)
+        filter.insert(x);
+    return filter;
+}
+
 template <typename TBloomFilter>
 void run_accuracy_test(double goal_fpr = 0.05, std::size_t element_count = 1000000, double tolerance_factor = 0.1)
 {
@@ -46,17 +66,13 @@ void run_accuracy_test(double goal_fpr = 0.05, std::size_t element_count = 10000
     std::uniform_int_distribution<value_type> dist;
 
     std::set<value_type> lossless;
-    bloom_filter         filter = bloom_filter::create_ideal(goal_fpr, element_count);
+    while (lossless.size() < element_count)
+        lossless.insert(dist(rng));
+
+    bloom_filter filter = build_accuracy_filter<bloom_filter>(goal_fpr, lossless, 0);
     // Minor adjustment in FPR -- since bloom_filter_params::num_hashes is discrete, it will never perfectly hit the
     // original goal_fpr, so this aligns our new goal to be more accurate.
-    goal_fpr = filter.params().expected_fpr(element_count);
-
-    while (lossless.size() < element_count)
-    {
-        auto next = dist(rng);
-        lossless.insert(next);
-        filter.insert(next);
-    }
+    goal_fpr = filter.expected_fpr(element_count);
 
     // Everything we inserted must appear in the filter
     for (value_type x : lossless)
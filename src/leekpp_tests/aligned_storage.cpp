@@ -0,0 +1,69 @@
+#include "test.hpp"
+
+#include <leekpp/bloom_filter.hpp>
+#include <leekpp/storage.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+template <typename TStorage>
+void run_alignment_test(std::size_t alignment)
+{
+    // Sizes on both sides of a huge page, which take different allocation paths
+    const std::size_t bit_counts[] = { 64, 512, 4096 + 64, std::size_t(1) << 20, (std::size_t(1) << 24) + 512 };
+    for (std::size_t bit_count : bit_counts)
+    {
+        TStorage storage(bit_count);
+        TEST_ASSERT(reinterpret_cast<std::uintptr_t>(storage.data()) % alignment == 0);
+        for (std::size_t idx = 0; idx < storage.block_count(); ++idx)
+            TEST_ASSERT(storage[idx] == 0);
+
+        storage.set_mask(storage.block_count() - 1, 1);
+        TEST_ASSERT(storage[storage.block_count() - 1] == 1);
+        storage.clear();
+        TEST_ASSERT(storage[storage.block_count() - 1] == 0);
+    }
+}
+
+template <typename TStorage>
+void run_filter_test()
+{
+    using mixer_type     = leekpp::basic_cache_aligned_mixer<std::size_t>;
+    using aligned_filter = leekpp::basic_bloom_filter<std::size_t, mixer_type, TStorage>;
+    using plain_filter   = leekpp::basic_bloom_filter<std::size_t, mixer_type>;
+
+    // Large enough to be backed by huge pages when they are asked for
+    auto aligned = aligned_filter::create_ideal(0.01, 1000000);
+    plain_filter plain(aligned.params());
+    for (std::size_t x = 0; x < 1000000; x += 3)
+    {
+        aligned.insert(x);
+        plain.insert(x);
+    }
+
+    for (std::size_t idx = 0; idx < plain.data().block_count(); ++idx)
+        TEST_ASSERT(aligned.data()[idx] == plain.data()[idx]);
+
+    // Copies get their own aligned allocation
+    auto copy = aligned;
+    TEST_ASSERT(reinterpret_cast<std::uintptr_t>(copy.data().data()) % 64 == 0);
+    TEST_ASSERT(copy.count(3) == 1);
+}
+
+void run_test()
+{
+    run_alignment_test<leekpp::aligned_storage>(64);
+    run_alignment_test<leekpp::basic_aligned_storage<std::uint64_t, 4096>>(4096);
+    run_alignment_test<leekpp::huge_page_storage>(64);
+    run_alignment_test<leekpp::basic_aligned_storage<std::size_t, 64, leekpp::page_mode::explicit_huge>>(64);
+
+    run_filter_test<leekpp::aligned_storage>();
+    run_filter_test<leekpp::huge_page_storage>();
+    run_filter_test<leekpp::basic_aligned_storage<std::size_t, 64, leekpp::page_mode::explicit_huge>>();
+}
+
+}
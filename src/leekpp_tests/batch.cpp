@@ -0,0 +1,57 @@
+#include "test.hpp"
+
+#include <leekpp/bloom_filter.hpp>
+
+#include <cstddef>
+#include <random>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+template <typename TBloomFilter>
+void run_batch_test(std::size_t element_count = 100000)
+{
+    using value_type = typename TBloomFilter::value_type;
+
+    std::mt19937_64 rng(element_count);
+    std::vector<value_type> inserted(element_count);
+    for (auto& x : inserted)
+        x = rng();
+
+    // insert_many must set exactly the same bits as insert
+    auto single = TBloomFilter::create_ideal(0.05, element_count);
+    auto batched = TBloomFilter::create_ideal(0.05, element_count);
+    for (const auto& x : inserted)
+        single.insert(x);
+    batched.insert_many(inserted.begin(), inserted.end());
+    for (std::size_t block_idx = 0; block_idx < single.data().block_count(); ++block_idx)
+        TEST_ASSERT(single.data()[block_idx] == batched.data()[block_idx]);
+
+    // count_many must agree with count, including on values which were never inserted
+    std::vector<value_type> queries(inserted.begin(), inserted.end());
+    for (std::size_t idx = 0; idx < element_count; ++idx)
+        queries.push_back(rng());
+
+    std::vector<std::size_t> counts(queries.size() + 1, 42);
+    auto end = batched.count_many(queries.begin(), queries.end(), counts.begin());
+    TEST_ASSERT(end == counts.begin() + queries.size());
+    TEST_ASSERT(counts.back() == 42);
+    for (std::size_t idx = 0; idx < queries.size(); ++idx)
+        TEST_ASSERT(counts[idx] == batched.count(queries[idx]));
+    for (std::size_t idx = 0; idx < element_count; ++idx)
+        TEST_ASSERT(counts[idx] == 1);
+}
+
+void run_test()
+{
+    run_batch_test<leekpp::bloom_filter<std::size_t>>();
+    run_batch_test<leekpp::cache_aligned_bloom_filter<std::size_t>>();
+    run_batch_test<leekpp::thread_safe_bloom_filter<std::size_t>>();
+    run_batch_test<leekpp::register_blocked_bloom_filter<std::size_t>>();
+
+    // Ranges which do not fill the final window
+    run_batch_test<leekpp::bloom_filter<std::size_t>>(37);
+}
+
+}
@@ -0,0 +1,80 @@
+#include "accuracy.hpp"
+#include "test.hpp"
+
+#include <leekpp/binary_fuse_filter.hpp>
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+void test_sizes()
+{
+    // Small key counts have a single segment and are where construction is most likely to need another seed
+    for (std::size_t key_count = 0; key_count < 2000; key_count += key_count < 100 ? 1 : 97)
+    {
+        std::vector<std::size_t> keys;
+        for (std::size_t x = 0; x < key_count; ++x)
+            keys.push_back(x * 31 + key_count);
+
+        leekpp::binary_fuse8_filter<std::size_t> filter(keys.begin(), keys.end());
+        TEST_ASSERT(filter.params().key_count == key_count);
+        for (auto x : keys)
+            TEST_ASSERT(filter.count(x) == 1);
+    }
+
+    std::vector<std::size_t> keys;
+    for (std::size_t x = 0; x < 1000000; ++x)
+        keys.push_back(x);
+    leekpp::binary_fuse8_filter<std::size_t> filter(keys.begin(), keys.end());
+    TEST_ASSERT(filter.bits_per_key() < 9.1);
+}
+
+void test_duplicates()
+{
+    std::vector<std::size_t> keys;
+    for (std::size_t x = 0; x < 50000; ++x)
+        keys.push_back(x % 20000);
+
+    leekpp::binary_fuse16_filter<std::size_t> filter(keys.begin(), keys.end());
+    for (std::size_t x = 0; x < 20000; ++x)
+        TEST_ASSERT(filter.count(x) == 1);
+}
+
+void test_strings()
+{
+    std::vector<std::string> keys;
+    for (std::size_t idx = 0; idx < 10000; ++idx)
+        keys.push_back("binary fuse key " + std::to_string(idx));
+
+    leekpp::binary_fuse8_filter<std::string> filter(keys.begin(), keys.end());
+    for (const auto& key : keys)
+    {
+        TEST_ASSERT(filter.count(key) == 1);
+        TEST_ASSERT(filter.count(std::string_view(key)) == 1);
+        TEST_ASSERT(filter.count_hash(leekpp::binary_fuse8_filter<std::string>::hash_value(key.c_str())) == 1);
+    }
+
+    // A filter over an existing storage gives the same answers
+    leekpp::binary_fuse8_filter<std::string> reopened(filter.params(), filter.data());
+    for (std::size_t idx = 0; idx < 20000; ++idx)
+    {
+        auto key = "binary fuse key " + std::to_string(idx);
+        TEST_ASSERT(reopened.count(key) == filter.count(key));
+    }
+}
+
+void run_test()
+{
+    test_sizes();
+    test_duplicates();
+    test_strings();
+    run_accuracy_test<leekpp::binary_fuse8_filter<std::size_t>>();
+    // Only about 15 false positives are expected at this FPR, so just check it is not far above it
+    run_accuracy_test<leekpp::binary_fuse16_filter<std::size_t>>(0.0001, 1000000, 1.0);
+}
+
+}
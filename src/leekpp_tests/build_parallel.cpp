@@ -0,0 +1,161 @@
+#include "test.hpp"
+
+#include <leekpp/counting_storage.hpp>
+#include <leekpp/parallel.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <random>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+template <typename TBloomFilter, typename TContainer>
+void run_build_test(const TContainer& values, std::size_t threads)
+{
+    auto params = TBloomFilter::create_ideal(0.01, values.size() + 1).params();
+
+    TBloomFilter sequential(params);
+    for (const auto& x : values)
+        sequential.insert(x);
+
+    auto parallel = leekpp::build_parallel<TBloomFilter>(values.begin(), values.end(), params, threads);
+    TEST_ASSERT(parallel.params().bit_count == params.bit_count);
+    for (std::size_t block_idx = 0; block_idx < sequential.data().block_count(); ++block_idx)
+        TEST_ASSERT(parallel.data()[block_idx] == sequential.data()[block_idx]);
+}
+
+template <typename TBloomFilter>
+void run_build_tests()
+{
+    std::mt19937_64 rng(7);
+    // Larger than a single round for the thread counts below, so the buffers are reused
+    std::vector<std::size_t> values(300000);
+    for (auto& x : values)
+        x = rng();
+
+    for (std::size_t threads : { 1, 3, 4, 8 })
+        run_build_test<TBloomFilter>(values, threads);
+
+    // Fewer values (and blocks) than threads
+    run_build_test<TBloomFilter>(std::vector<std::size_t>{ 1, 2, 3 }, 8);
+    run_build_test<TBloomFilter>(std::vector<std::size_t>{}, 4);
+
+    // Non-random-access iterators work too
+    run_build_test<TBloomFilter>(std::list<std::size_t>(values.begin(), values.begin() + 1000), 4);
+}
+
+/** Workers update the running count of \c counted_storage at the same time, which must stay exact. **/
+void run_counted_test()
+{
+    using filter_type = leekpp::counted_bloom_filter<std::size_t>;
+
+    std::mt19937_64 rng(11);
+    std::vector<std::size_t> values(300000);
+    for (auto& x : values)
+        x = rng();
+
+    auto params = filter_type::create_ideal(0.01, values.size()).params();
+    for (std::size_t threads : { 2, 4 })
+    {
+        auto filter = leekpp::build_parallel<filter_type>(values.begin(), values.end(), params, threads);
+        std::size_t popcount = 0;
+        for (std::size_t block_idx = 0; block_idx < filter.data().block_count(); ++block_idx)
+            popcount += leekpp::detail::popcount(std::uint64_t(filter.data()[block_idx]));
+        TEST_ASSERT(filter.set_bits() == popcount);
+
+        leekpp::merge_parallel(filter, &filter, &filter + 1, threads);
+        TEST_ASSERT(filter.set_bits() == popcount);
+    }
+}
+
+/** Copy-on-write storage duplicates a whole page on its first write, so threads must never share a page, even when the
+ *  filter shares every page with a copy.
+**/
+void run_cow_test()
+{
+    using filter_type = leekpp::cow_bloom_filter<std::size_t>;
+
+    std::mt19937_64 rng(13);
+    std::vector<std::size_t> values(200000);
+    for (auto& x : values)
+        x = rng();
+    auto middle = values.begin() + values.size() / 2;
+
+    filter_type original(filter_type::create_ideal(0.01, values.size()).params());
+    original.insert_many(values.begin(), middle);
+    filter_type expected(original);
+    expected.insert_many(middle, values.end());
+    std::vector<filter_type::block_type> original_blocks;
+    for (std::size_t block_idx = 0; block_idx < original.data().block_count(); ++block_idx)
+        original_blocks.push_back(original.data()[block_idx]);
+
+    for (std::size_t threads : { 2, 3, 8 })
+    {
+        filter_type copy(original);
+        leekpp::insert_parallel(copy, middle, values.end(), threads);
+        for (std::size_t block_idx = 0; block_idx < copy.data().block_count(); ++block_idx)
+            TEST_ASSERT(copy.data()[block_idx] == expected.data()[block_idx]);
+
+        filter_type merged(original);
+        leekpp::merge_parallel(merged, &expected, &expected + 1, threads);
+        for (std::size_t block_idx = 0; block_idx < merged.data().block_count(); ++block_idx)
+            TEST_ASSERT(merged.data()[block_idx] == expected.data()[block_idx]);
+    }
+    for (std::size_t block_idx = 0; block_idx < original.data().block_count(); ++block_idx)
+        TEST_ASSERT(original.data()[block_idx] == original_blocks[block_idx]);
+}
+
+/** Every boundary between partitions must fall on a cache line, counting from the first line boundary in memory. **/
+void run_partition_test()
+{
+    for (std::size_t lead_blocks = 0; lead_blocks < 8; ++lead_blocks)
+    {
+        for (std::size_t block_count : { 1, 7, 100, 1000 })
+        {
+            std::size_t previous = 0;
+            for (std::size_t part = 0; part <= 5; ++part)
+            {
+                auto begin = leekpp::detail::partition_begin(block_count, 8, 5, part, lead_blocks);
+                TEST_ASSERT(begin >= previous);
+                TEST_ASSERT(begin == 0 || begin == block_count || (begin + 8 - lead_blocks) % 8 == 0);
+                previous = begin;
+            }
+            TEST_ASSERT(previous == block_count);
+        }
+    }
+
+    // Partitions of storage which shares state between blocks keep each run of those blocks together
+    for (std::size_t part = 0; part <= 3; ++part)
+        TEST_ASSERT(leekpp::detail::partition_begin(100000, 8, 3, part, 0, 512) % 512 == 0
+                    || part == 3
+                   );
+    TEST_ASSERT(leekpp::detail::storage_partition_blocks<leekpp::cow_storage>::value == 512);
+    TEST_ASSERT(leekpp::detail::storage_partition_blocks<leekpp::storage>::value == 1);
+    TEST_ASSERT(leekpp::detail::storage_partition_blocks<leekpp::counting_storage>::value == 1);
+    TEST_ASSERT(leekpp::detail::storage_partition_blocks<leekpp::basic_counted_storage<leekpp::cow_storage>>::value
+                == 512
+               );
+    // Storage which does not declare it is safe to write from several threads is rejected at compile time
+    TEST_ASSERT(leekpp::detail::storage_partition_blocks<std::vector<std::size_t>>::value == 0);
+
+    leekpp::bloom_filter<std::size_t> filter(leekpp::bloom_filter_params(1 << 16, 3));
+    auto lead_blocks = leekpp::detail::line_lead_blocks(filter.data());
+    auto address     = reinterpret_cast<std::uintptr_t>(filter.data().data() + lead_blocks);
+    TEST_ASSERT(lead_blocks < 8);
+    TEST_ASSERT(address % leekpp::detail::cache_line_bytes == 0);
+}
+
+void run_test()
+{
+    run_partition_test();
+    run_counted_test();
+    run_cow_test();
+    run_build_tests<leekpp::bloom_filter<std::size_t>>();
+    run_build_tests<leekpp::cache_aligned_bloom_filter<std::size_t>>();
+    run_build_tests<leekpp::register_blocked_bloom_filter<std::size_t>>();
+}
+
+}
@@ -0,0 +1,124 @@
+#include "test.hpp"
+
+#include <leekpp/bloom_filter.hpp>
+#include <leekpp/counting_storage.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+void test_popcount()
+{
+    std::mt19937_64 rng(7);
+    for (std::size_t size : { 0, 1, 7, 8, 31, 32, 33, 100, 1000, 4099 })
+    {
+        std::vector<unsigned char> a(size), b(size);
+        std::size_t first = 0, second = 0, either = 0;
+        for (std::size_t idx = 0; idx < size; ++idx)
+        {
+            a[idx] = static_cast<unsigned char>(rng());
+            b[idx] = static_cast<unsigned char>(rng());
+            first  += leekpp::detail::popcount(a[idx]);
+            second += leekpp::detail::popcount(b[idx]);
+            either += leekpp::detail::popcount(a[idx] | b[idx]);
+        }
+
+        TEST_ASSERT(leekpp::detail::popcount_bytes(a.data(), size) == first);
+        auto pair = leekpp::detail::popcount_pair_bytes(a.data(), b.data(), size);
+        TEST_ASSERT(pair.first == first);
+        TEST_ASSERT(pair.second == second);
+        TEST_ASSERT(pair.either == either);
+    }
+}
+
+template <typename TBloomFilter>
+void run_estimate_test()
+{
+    auto filter = TBloomFilter::create_ideal(0.01, 100000);
+    TEST_ASSERT(filter.set_bits() == 0);
+    TEST_ASSERT(filter.estimated_size() == 0);
+    TEST_ASSERT(filter.estimated_fpr_now() == 0.0);
+
+    for (std::size_t x = 0; x < 60000; ++x)
+        filter.insert(x);
+    TEST_ASSERT(filter.set_bits() == leekpp::detail::count_set_bits(filter.data()));
+    TEST_ASSERT_WITHIN(60000.0, double(filter.estimated_size()), 60000 * 0.03);
+
+    std::size_t positives = 0;
+    for (std::size_t x = 0; x < 200000; ++x)
+        positives += filter.count(x + 1000000);
+    TEST_ASSERT_WITHIN(filter.estimated_fpr_now(), positives / 200000.0, filter.estimated_fpr_now() * 0.2);
+
+    filter.clear();
+    TEST_ASSERT(filter.set_bits() == 0);
+}
+
+template <typename TBloomFilter>
+void run_similarity_test()
+{
+    const auto params = TBloomFilter::create_ideal(0.01, 100000).params();
+    TBloomFilter a(params), b(params);
+    for (std::size_t x = 0; x < 30000; ++x)
+        a.insert(x);
+    for (std::size_t x = 20000; x < 50000; ++x)
+        b.insert(x);
+
+    TEST_ASSERT_WITHIN(50000.0, double(a.estimated_union_size(b)), 50000 * 0.03);
+    TEST_ASSERT_WITHIN(10000.0, double(a.estimated_intersection_size(b)), 1500.0);
+    TEST_ASSERT_WITHIN(0.2, a.jaccard_similarity(b), 0.03);
+    TEST_ASSERT(a.jaccard_similarity(a) == 1.0);
+
+    TBloomFilter empty(params);
+    TEST_ASSERT(empty.jaccard_similarity(empty) == 0.0);
+    TEST_ASSERT(a.estimated_intersection_size(empty) == 0);
+}
+
+void test_counted_storage()
+{
+    // The running count must stay exact through merges, which go block by block for this storage
+    const auto params = leekpp::bloom_filter<std::size_t>::create_ideal(0.01, 10000).params();
+    leekpp::counted_bloom_filter<std::size_t> a(params), b(params);
+    for (std::size_t x = 0; x < 5000; ++x)
+    {
+        a.insert(x);
+        b.insert(x + 2500);
+    }
+    a.union_with(b);
+    TEST_ASSERT(a.set_bits() == leekpp::detail::count_set_bits(a.data().storage()));
+    a.intersect_with(b);
+    TEST_ASSERT(a.set_bits() == leekpp::detail::count_set_bits(a.data().storage()));
+
+    // With counting storage underneath, a bit only stops counting once every value which set it is erased
+    using counting_filter = leekpp::basic_bloom_filter<std::size_t,
+                                                       leekpp::basic_mixer<std::size_t>,
+                                                       leekpp::basic_counted_storage<leekpp::counting_storage>
+                                                      >;
+    counting_filter counting(params);
+    for (std::size_t x = 0; x < 5000; ++x)
+        counting.insert(x);
+    for (std::size_t x = 0; x < 5000; x += 2)
+        counting.erase(x);
+    TEST_ASSERT(counting.set_bits() == leekpp::detail::count_set_bits(counting.data().storage()));
+    for (std::size_t x = 1; x < 5000; x += 2)
+        counting.erase(x);
+    TEST_ASSERT(counting.set_bits() == 0);
+}
+
+void run_test()
+{
+    test_popcount();
+    run_estimate_test<leekpp::bloom_filter<std::size_t>>();
+    run_estimate_test<leekpp::cache_aligned_bloom_filter<std::size_t>>();
+    run_estimate_test<leekpp::thread_safe_bloom_filter<std::size_t>>();
+    run_estimate_test<leekpp::counted_bloom_filter<std::size_t>>();
+    run_similarity_test<leekpp::bloom_filter<std::size_t>>();
+    run_similarity_test<leekpp::thread_safe_bloom_filter<std::size_t>>();
+    run_similarity_test<leekpp::counted_bloom_filter<std::size_t>>();
+    test_counted_storage();
+}
+
+}
@@ -0,0 +1,160 @@
+#include "test.hpp"
+
+#include <leekpp/bloom_filter.hpp>
+#include <leekpp/compressed_serialization.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+template <typename TFilterA, typename TFilterB>
+void assert_same_contents(const TFilterA& a, const TFilterB& b)
+{
+    TEST_ASSERT(a.params().bit_count == b.params().bit_count);
+    TEST_ASSERT(a.params().num_hashes == b.params().num_hashes);
+    TEST_ASSERT(a.data().block_count() == b.data().block_count());
+    for (std::size_t block_idx = 0; block_idx < a.data().block_count(); ++block_idx)
+        TEST_ASSERT(a.data()[block_idx] == b.data()[block_idx]);
+}
+
+template <typename TFunction>
+bool throws_serialization_error(TFunction func)
+{
+    try
+    {
+        func();
+        return false;
+    }
+    catch (const leekpp::serialization_error&)
+    {
+        return true;
+    }
+}
+
+template <typename TBloomFilter>
+std::vector<char> save_to_buffer(const TBloomFilter& filter)
+{
+    std::vector<char> buffer(leekpp::compressed_size(filter));
+    TEST_ASSERT(leekpp::save_compressed(buffer.data(), buffer.size(), filter) == buffer.size());
+    return buffer;
+}
+
+template <typename TBloomFilter>
+void run_round_trip_test()
+{
+    const std::size_t capacity = 200000;
+
+    // From empty to over capacity, which moves chunks through every encoding
+    for (std::size_t element_count : { std::size_t(0), capacity / 1000, capacity / 50, capacity / 10, capacity / 4,
+                                       capacity, 4 * capacity })
+    {
+        auto filter = TBloomFilter::create_ideal(0.01, capacity);
+        for (std::size_t x = 0; x < element_count; ++x)
+            filter.insert(x * 13);
+
+        std::stringstream ss;
+        leekpp::save_compressed(ss, filter);
+        TEST_ASSERT(ss.str().size() == leekpp::compressed_size(filter));
+        assert_same_contents(filter, leekpp::load_compressed<TBloomFilter>(ss));
+
+        auto buffer = save_to_buffer(filter);
+        assert_same_contents(filter, leekpp::load_compressed<TBloomFilter>(buffer.data(), buffer.size()));
+
+        // Never much larger than the plain format, and much smaller while the filter is sparse
+        auto plain_size = leekpp::serialized_size(filter);
+        TEST_ASSERT(buffer.size() <= plain_size + plain_size / 1000);
+        if (element_count <= capacity / 10)
+            TEST_ASSERT(buffer.size() < plain_size / 2);
+    }
+}
+
+template <typename TBloomFilter>
+void run_clustered_test()
+{
+    // Dense blocks in one region and nothing elsewhere
+    auto filter = TBloomFilter::create_ideal(0.01, 100000);
+    for (std::size_t block_idx = 0; block_idx < filter.data().block_count() / 8; ++block_idx)
+        filter.data().set_mask(block_idx * 3, typename TBloomFilter::block_type(0x5a));
+
+    auto buffer = save_to_buffer(filter);
+    assert_same_contents(filter, leekpp::load_compressed<TBloomFilter>(buffer.data(), buffer.size()));
+    TEST_ASSERT(buffer.size() < leekpp::serialized_size(filter) / 2);
+}
+
+void run_error_test()
+{
+    using filter_type = leekpp::bloom_filter<std::size_t>;
+
+    auto filter = filter_type::create_ideal(0.01, 100000);
+    for (std::size_t x = 0; x < 5000; ++x)
+        filter.insert(x);
+    auto buffer = save_to_buffer(filter);
+
+    // Truncated input
+    TEST_ASSERT(throws_serialization_error([&]
+                                           {
+                                               leekpp::load_compressed<filter_type>(buffer.data(), buffer.size() - 1);
+                                           }
+                                          ));
+
+    // A flipped bit in a payload is caught by the decoder or the checksum
+    for (std::size_t offset = 70; offset < buffer.size(); offset += buffer.size() / 7)
+    {
+        auto corrupt = buffer;
+        corrupt[offset] ^= 0x04;
+        TEST_ASSERT(throws_serialization_error([&]
+                                               {
+                                                   leekpp::load_compressed<filter_type>(corrupt.data(), corrupt.size());
+                                               }
+                                              ));
+    }
+
+    // The checksum covers the header too, and a header describing more chunks than the input holds is rejected
+    auto patch = [] (std::vector<char> buffer, std::size_t offset, std::uint64_t value)
+                 {
+                     std::memcpy(buffer.data() + offset, &value, sizeof value);
+                     return buffer;
+                 };
+    std::uint64_t huge_bits = std::uint64_t(1) << 46;
+    for (const auto& corrupt : { patch(buffer, 24, 0),
+                                 patch(buffer, 24, 40),
+                                 patch(patch(buffer, 16, huge_bits), 32, huge_bits / 64)
+                               })
+    {
+        TEST_ASSERT(throws_serialization_error([&]
+                                               {
+                                                   leekpp::load_compressed<filter_type>(corrupt.data(), corrupt.size());
+                                               }
+                                              ));
+    }
+
+    // The plain and compressed formats are not interchangeable
+    std::vector<char> plain(leekpp::serialized_size(filter));
+    leekpp::save(plain.data(), plain.size(), filter);
+    TEST_ASSERT(throws_serialization_error([&] { leekpp::load_compressed<filter_type>(plain.data(), plain.size()); }));
+    TEST_ASSERT(throws_serialization_error([&] { leekpp::load<filter_type>(buffer.data(), buffer.size()); }));
+}
+
+void run_test()
+{
+    run_round_trip_test<leekpp::bloom_filter<std::size_t>>();
+    run_round_trip_test<leekpp::cache_aligned_bloom_filter<std::size_t>>();
+    run_round_trip_test<leekpp::register_blocked_bloom_filter<std::size_t>>();
+    run_round_trip_test<leekpp::basic_bloom_filter<std::size_t,
+                                                   leekpp::basic_mixer<std::size_t>,
+                                                   leekpp::basic_storage<std::uint8_t>
+                                                  >
+                       >();
+    run_round_trip_test<leekpp::thread_safe_bloom_filter<std::size_t>>();
+    run_clustered_test<leekpp::bloom_filter<std::size_t>>();
+    run_clustered_test<leekpp::thread_safe_bloom_filter<std::size_t>>();
+    run_error_test();
+}
+
+}
@@ -0,0 +1,101 @@
+#include "test.hpp"
+
+#include <leekpp/counting_storage.hpp>
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+void test_nibble_operations()
+{
+    for (std::uint64_t mask = 0; mask <= 0xffff; ++mask)
+        TEST_ASSERT(leekpp::detail::gather_nibbles(leekpp::detail::spread_nibbles(mask)) == mask);
+
+    leekpp::counting_storage storage(128);
+    const std::uint64_t mask = 0x8000000100010001ULL;
+    for (unsigned count = 1; count <= 20; ++count)
+    {
+        storage.set_mask(1, mask);
+        TEST_ASSERT(storage.counter(64) == (count < 15 ? count : 15));
+        TEST_ASSERT(storage.counter(127) == (count < 15 ? count : 15));
+        TEST_ASSERT(storage.counter(65) == 0);
+        TEST_ASSERT(storage[1] == mask);
+        TEST_ASSERT(storage[0] == 0);
+    }
+
+    // Saturated counters stick, while the others count back down to zero
+    storage.set_mask(1, 0x2);
+    storage.clear_mask(1, mask | 0x2);
+    TEST_ASSERT(storage.counter(64) == 15);
+    TEST_ASSERT(storage.counter(65) == 0);
+    TEST_ASSERT(storage[1] == mask);
+
+    // Decrementing a zero counter leaves it alone
+    storage.clear_mask(0, 0xffffffffffffffffULL);
+    TEST_ASSERT(storage[0] == 0);
+}
+
+template <typename TBloomFilter>
+void run_erase_test(std::size_t element_count = 20000)
+{
+    auto filter = TBloomFilter::create_ideal(0.01, element_count);
+    for (std::size_t x = 0; x < element_count; ++x)
+        filter.insert(x);
+    for (std::size_t x = 0; x < element_count; x += 2)
+        filter.erase(x);
+
+    std::size_t erased_positives = 0;
+    for (std::size_t x = 0; x < element_count; ++x)
+    {
+        if (x % 2 == 1)
+            TEST_ASSERT(filter.count(x) == 1);
+        else
+            erased_positives += filter.count(x);
+    }
+    TEST_ASSERT(erased_positives < element_count / 2 / 50);
+
+    // The collapsed filter must answer exactly the same as the counting filter
+    auto bits = leekpp::to_bit_filter(filter);
+    for (std::size_t x = 0; x < 2 * element_count; ++x)
+        TEST_ASSERT(bits.count(x) == filter.count(x));
+
+    // Erasing everything gets back to an empty filter
+    for (std::size_t x = 1; x < element_count; x += 2)
+        filter.erase(x);
+    for (std::size_t block_idx = 0; block_idx < filter.data().block_count(); ++block_idx)
+        TEST_ASSERT(filter.data()[block_idx] == 0);
+}
+
+void test_thread_safe_counting()
+{
+    auto filter = leekpp::thread_safe_counting_bloom_filter<std::size_t>::create_ideal(0.01, 40000);
+    std::vector<std::thread> threads;
+    for (std::size_t id = 0; id < 4; ++id)
+        threads.emplace_back([&filter, id]
+                             {
+                                 for (std::size_t x = id; x < 40000; x += 4)
+                                     filter.insert(x);
+                                 for (std::size_t x = id; x < 40000; x += 8)
+                                     filter.erase(x);
+                             });
+    for (auto& thread : threads)
+        thread.join();
+
+    for (std::size_t x = 0; x < 40000; ++x)
+        if (x % 8 >= 4)
+            TEST_ASSERT(filter.count(x) == 1);
+}
+
+void run_test()
+{
+    test_nibble_operations();
+    run_erase_test<leekpp::counting_bloom_filter<std::size_t>>();
+    run_erase_test<leekpp::counting_bloom_filter<std::size_t, leekpp::basic_cache_aligned_mixer<std::size_t>>>();
+    run_erase_test<leekpp::counting_bloom_filter<std::size_t, leekpp::basic_register_blocked_mixer<std::size_t>>>();
+    test_thread_safe_counting();
+}
+
+}
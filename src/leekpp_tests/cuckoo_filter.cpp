@@ -0,0 +1,169 @@
+#include "accuracy.hpp"
+#include "test.hpp"
+
+#include <leekpp/cuckoo_filter.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+void test_insert_erase()
+{
+    for (std::size_t fingerprint_bits : { 8, 12, 16 })
+    {
+        leekpp::cuckoo_filter<std::size_t> filter(leekpp::cuckoo_filter_params(1000, fingerprint_bits));
+        for (std::size_t x = 0; x < 3000; ++x)
+            TEST_ASSERT(filter.insert(x));
+        TEST_ASSERT(filter.size() == 3000);
+        for (std::size_t x = 0; x < 3000; ++x)
+            TEST_ASSERT(filter.count(x) == 1);
+
+        // Remove the even values; the odd ones must stay
+        for (std::size_t x = 0; x < 3000; x += 2)
+            TEST_ASSERT(filter.erase(x));
+        TEST_ASSERT(filter.size() == 1500);
+        for (std::size_t x = 1; x < 3000; x += 2)
+            TEST_ASSERT(filter.count(x) == 1);
+        std::size_t erased_positives = 0;
+        for (std::size_t x = 0; x < 3000; x += 2)
+            erased_positives += filter.count(x);
+        TEST_ASSERT(erased_positives < 100);
+
+        filter.clear();
+        TEST_ASSERT(filter.size() == 0);
+        TEST_ASSERT(!filter.erase(1));
+    }
+}
+
+/** Storage without contiguous data goes through a different bucket access path, which must behave the same. **/
+void test_atomic_storage()
+{
+    using atomic_filter_type = leekpp::basic_cuckoo_filter<std::size_t,
+                                                           leekpp::hash<std::size_t>,
+                                                           leekpp::basic_thread_safe_storage<std::uint64_t>
+                                                          >;
+
+    for (std::size_t fingerprint_bits : { 8, 12, 16 })
+    {
+        leekpp::cuckoo_filter_params params(1001, fingerprint_bits);
+        leekpp::cuckoo_filter<std::size_t> plain(params);
+        atomic_filter_type atomic(params);
+        for (std::size_t x = 0; x < 3800; ++x)
+            TEST_ASSERT(plain.insert(x) == atomic.insert(x));
+        for (std::size_t x = 0; x < 3800; x += 3)
+            TEST_ASSERT(plain.erase(x) == atomic.erase(x));
+        TEST_ASSERT(plain.size() == atomic.size());
+        for (std::size_t x = 0; x < 10000; ++x)
+            TEST_ASSERT(plain.count(x) == atomic.count(x));
+    }
+}
+
+void test_full()
+{
+    // Inserting until there is no room must fail without losing anything already in the filter
+    leekpp::cuckoo_filter<std::size_t> filter(leekpp::cuckoo_filter_params(257, 12));
+    std::size_t inserted = 0;
+    while (filter.insert(inserted))
+        ++inserted;
+    TEST_ASSERT(inserted == filter.size());
+    TEST_ASSERT(inserted > 257 * 4 * 9 / 10);
+    TEST_ASSERT(inserted <= 257 * 4);
+    for (std::size_t x = 0; x < inserted; ++x)
+        TEST_ASSERT(filter.count(x) == 1);
+
+    // Making room lets inserts succeed again
+    TEST_ASSERT(filter.erase(0));
+    TEST_ASSERT(filter.insert(0));
+
+    // The same value fills both of its buckets
+    leekpp::cuckoo_filter<std::size_t> repeated(leekpp::cuckoo_filter_params(1000, 16));
+    std::size_t copies = 0;
+    while (repeated.insert(7))
+        ++copies;
+    TEST_ASSERT(copies == 8);
+}
+
+void test_concurrent()
+{
+    auto filter = leekpp::concurrent_cuckoo_filter<std::size_t>::create_ideal(0.001, 100000);
+    const std::size_t per_thread = 20000;
+
+    std::vector<std::thread> threads;
+    for (std::size_t thread_idx = 0; thread_idx < 4; ++thread_idx)
+    {
+        threads.emplace_back([&, thread_idx]
+                             {
+                                 for (std::size_t x = 0; x < per_thread; ++x)
+                                 {
+                                     filter.insert(thread_idx * per_thread + x);
+                                     filter.count(x);
+                                 }
+                             }
+                            );
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    TEST_ASSERT(filter.size() == 4 * per_thread);
+    for (std::size_t x = 0; x < 4 * per_thread; ++x)
+        TEST_ASSERT(filter.count(x) == 1);
+}
+
+/** Readers running alongside a writer must always find every value whose insert has finished, even while later inserts
+ *  kick fingerprints between buckets. The filter is filled close to capacity so that kicks are common.
+**/
+void test_concurrent_readers()
+{
+    const std::size_t elements = 40000;
+    auto filter = leekpp::concurrent_cuckoo_filter<std::size_t>::create_ideal(0.001, elements);
+    std::atomic<std::size_t> inserted(0);
+    std::atomic<std::size_t> misses(0);
+
+    std::vector<std::thread> readers;
+    for (std::size_t reader_idx = 0; reader_idx < 2; ++reader_idx)
+    {
+        readers.emplace_back([&, reader_idx]
+                             {
+                                 std::size_t probe = reader_idx;
+                                 for (auto limit = inserted.load(); limit < elements; limit = inserted.load())
+                                 {
+                                     for (std::size_t idx = 0; idx < 64 && limit > 0; ++idx)
+                                     {
+                                         probe = (probe * 6364136223846793005ULL + 1442695040888963407ULL);
+                                         if (filter.count((probe >> 16) % limit) == 0)
+                                             ++misses;
+                                     }
+                                 }
+                             }
+                            );
+    }
+
+    for (std::size_t x = 0; x < elements; ++x)
+    {
+        TEST_ASSERT(filter.insert(x));
+        inserted.store(x + 1);
+    }
+    for (auto& reader : readers)
+        reader.join();
+    TEST_ASSERT(misses.load() == 0);
+    TEST_ASSERT(filter.size() == elements);
+}
+
+void run_test()
+{
+    test_insert_erase();
+    test_atomic_storage();
+    test_full();
+    test_concurrent();
+    test_concurrent_readers();
+    run_accuracy_test<leekpp::cuckoo_filter<std::uint64_t>>(0.05);
+    run_accuracy_test<leekpp::cuckoo_filter<std::uint64_t>>(0.002);
+    run_accuracy_test<leekpp::cuckoo_filter<std::uint64_t>>(0.0002, 1000000, 0.3);
+}
+
+}
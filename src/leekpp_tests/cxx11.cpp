@@ -0,0 +1,106 @@
+#include "test.hpp"
+
+// This test is built as C++11 (see CMakeLists.txt), so it catches newer features leaking into the headers. The other
+// tests use the compiler's default standard.
+#include <leekpp/aligned_allocator.hpp>
+#include <leekpp/assert.hpp>
+#include <leekpp/binary_fuse_filter.hpp>
+#include <leekpp/bloom_filter.hpp>
+#include <leekpp/bloom_filter_io.hpp>
+#include <leekpp/compressed_serialization.hpp>
+#include <leekpp/counting_storage.hpp>
+#include <leekpp/cuckoo_filter.hpp>
+#include <leekpp/hash.hpp>
+#include <leekpp/mapped_storage.hpp>
+#include <leekpp/mixer.hpp>
+#include <leekpp/numa_allocator.hpp>
+#include <leekpp/numa_sharded_bloom_filter.hpp>
+#include <leekpp/parallel.hpp>
+#include <leekpp/published_filter.hpp>
+#include <leekpp/scalable_bloom_filter.hpp>
+#include <leekpp/serialization.hpp>
+#include <leekpp/simd.hpp>
+#include <leekpp/sliding_window_bloom_filter.hpp>
+#include <leekpp/split_block_bloom_filter.hpp>
+#include <leekpp/static_bloom_filter.hpp>
+#include <leekpp/stats.hpp>
+#include <leekpp/storage.hpp>
+#include <leekpp/storage_io.hpp>
+#include <leekpp/write_combining_buffer.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+/** Without C++17's aligned <tt>operator new</tt>, \c aligned_allocator over-allocates and aligns by hand. **/
+void test_aligned_allocator()
+{
+    for (std::size_t bit_count : { 64, 4096 + 64, 1 << 20 })
+    {
+        leekpp::basic_aligned_storage<std::size_t, 256> storage(bit_count);
+        TEST_ASSERT(reinterpret_cast<std::uintptr_t>(storage.data()) % 256 == 0);
+        storage.set_mask(storage.block_count() - 1, 1);
+        TEST_ASSERT(storage[storage.block_count() - 1] == 1);
+    }
+}
+
+void test_filter()
+{
+    auto filter = leekpp::cache_aligned_bloom_filter<std::size_t>::create_ideal(0.01, 1000);
+    for (std::size_t x = 0; x < 1000; ++x)
+        filter.insert(x);
+
+    std::vector<char> buffer(leekpp::serialized_size(filter));
+    leekpp::save(buffer.data(), buffer.size(), filter);
+    auto loaded = leekpp::load<leekpp::cache_aligned_bloom_filter<std::size_t>>(buffer.data(), buffer.size());
+    for (std::size_t x = 0; x < 1000; ++x)
+        TEST_ASSERT(loaded.count(x) == 1);
+}
+
+void test_concurrent_cuckoo_filter()
+{
+    auto filter = leekpp::concurrent_cuckoo_filter<std::size_t>::create_ideal(0.01, 1000);
+    for (std::size_t x = 0; x < 1000; ++x)
+        TEST_ASSERT(filter.insert(x));
+    for (std::size_t x = 0; x < 1000; ++x)
+        TEST_ASSERT(filter.count(x) == 1);
+    filter.clear();
+    TEST_ASSERT(filter.size() == 0);
+}
+
+void test_static_bloom_filter()
+{
+    constexpr auto params = leekpp::static_ideal_params(0.01, 100, 512);
+    leekpp::static_bloom_filter<std::size_t,
+                                params.bit_count,
+                                params.num_hashes,
+                                leekpp::basic_cache_aligned_mixer<std::size_t>
+                               > filter;
+    for (std::size_t x = 0; x < 100; ++x)
+        filter.insert(x);
+    for (std::size_t x = 0; x < 100; ++x)
+        TEST_ASSERT(filter.count(x) == 1);
+}
+
+void test_sliding_window()
+{
+    auto filter = leekpp::sliding_window_bloom_filter<std::size_t>::create_ideal(0.01, 300);
+    for (std::size_t x = 0; x < 1000; ++x)
+        filter.insert(x);
+    for (std::size_t x = 700; x < 1000; ++x)
+        TEST_ASSERT(filter.count(x) == 1);
+}
+
+void run_test()
+{
+    test_aligned_allocator();
+    test_filter();
+    test_concurrent_cuckoo_filter();
+    test_static_bloom_filter();
+    test_sliding_window();
+}
+
+}
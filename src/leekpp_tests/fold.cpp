@@ -0,0 +1,95 @@
+#include "test.hpp"
+
+#include <leekpp/bloom_filter.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+
+namespace leekpp_tests
+{
+
+/** A folded filter must keep every value, set exactly the bits of a filter built at the smaller size and have the FPR
+ *  its folded parameters predict.
+**/
+template <typename TMixer>
+void run_fold_test()
+{
+    using filter_type = leekpp::basic_bloom_filter<std::size_t, TMixer>;
+    const std::size_t elements = 150000;
+
+    filter_type filter(leekpp::bloom_filter_params(std::size_t(1) << 21, 7));
+    for (std::size_t x = 0; x < elements; ++x)
+        filter.insert(x);
+
+    for (std::size_t factor : { 1, 2, 4 })
+    {
+        auto folded = filter.fold(factor);
+        TEST_ASSERT(folded.params().bit_count == filter.params().bit_count / factor);
+        TEST_ASSERT(folded.params().num_hashes == filter.params().num_hashes);
+
+        filter_type direct(filter.params().folded(factor));
+        for (std::size_t x = 0; x < elements; ++x)
+            direct.insert(x);
+        TEST_ASSERT(folded.data().block_count() == direct.data().block_count());
+        for (std::size_t block_idx = 0; block_idx < direct.data().block_count(); ++block_idx)
+            TEST_ASSERT(folded.data()[block_idx] == direct.data()[block_idx]);
+
+        for (std::size_t x = 0; x < elements; ++x)
+            TEST_ASSERT(folded.count(x) == 1);
+
+        std::size_t false_positives = 0;
+        const std::size_t probes = 200000;
+        for (std::size_t x = elements; x < elements + probes; ++x)
+            false_positives += folded.count(x);
+        auto expected = folded.expected_fpr(elements);
+        TEST_ASSERT_WITHIN(expected, double(false_positives) / probes, expected * 0.25);
+    }
+}
+
+void test_invalid_factors()
+{
+    leekpp::bloom_filter<std::size_t> filter(leekpp::bloom_filter_params(4096, 3));
+    leekpp::basic_bloom_filter<std::size_t, leekpp::basic_cache_aligned_mixer<std::size_t>> aligned(
+            leekpp::bloom_filter_params(4096, 3)
+        );
+
+    auto throws = [] (auto&& fold)
+                  {
+                      try
+                      {
+                          fold();
+                      }
+                      catch (const std::invalid_argument&)
+                      {
+                          return true;
+                      }
+                      return false;
+                  };
+    TEST_ASSERT(throws([&] { filter.fold(0); }));
+    TEST_ASSERT(throws([&] { filter.fold(3); }));
+    TEST_ASSERT(throws([&] { filter.fold(128); }));
+    // Folding 4096 bits by 16 leaves 256, less than a single 512-bit group; by 8 leaves exactly one
+    TEST_ASSERT(throws([&] { aligned.fold(16); }));
+    TEST_ASSERT(!throws([&] { aligned.fold(8); }));
+}
+
+void test_create_ideal()
+{
+    auto filter = leekpp::foldable_bloom_filter<std::size_t>::create_ideal(0.01, 100000);
+    auto bit_count = filter.params().bit_count;
+    TEST_ASSERT((bit_count & (bit_count - 1)) == 0);
+    TEST_ASSERT(bit_count >= leekpp::bloom_filter_params::create_ideal(0.01, 100000).bit_count);
+    TEST_ASSERT(filter.expected_fpr(100000) <= 0.01);
+}
+
+void run_test()
+{
+    run_fold_test<leekpp::basic_mixer<std::size_t>>();
+    run_fold_test<leekpp::basic_cache_aligned_mixer<std::size_t>>();
+    run_fold_test<leekpp::basic_foldable_mixer<std::size_t>>();
+    test_invalid_factors();
+    test_create_ideal();
+}
+
+}
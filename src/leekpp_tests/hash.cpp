@@ -0,0 +1,172 @@
+#include "test.hpp"
+
+#include <leekpp/bloom_filter.hpp>
+#include <leekpp/hash.hpp>
+#include <leekpp/split_block_bloom_filter.hpp>
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+namespace
+{
+
+std::size_t allocation_count = 0;
+
+}
+
+void* operator new(std::size_t size)
+{
+    ++allocation_count;
+    if (void* p = std::malloc(size == 0 ? 1 : size))
+        return p;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+namespace leekpp_tests
+{
+
+void test_bytes()
+{
+    std::vector<unsigned char> buffer(4096);
+    for (std::size_t idx = 0; idx < buffer.size(); ++idx)
+        buffer[idx] = static_cast<unsigned char>(leekpp::detail::hash_integer(idx));
+
+    // Every prefix length gets a distinct hash, including across the short, medium and long paths
+    std::unordered_set<std::uint64_t> seen;
+    for (std::size_t len = 0; len <= buffer.size(); ++len)
+    {
+        auto hash = leekpp::detail::hash_bytes(buffer.data(), len);
+        TEST_ASSERT(hash == leekpp::detail::hash_bytes(buffer.data(), len));
+        TEST_ASSERT(seen.insert(hash).second);
+        TEST_ASSERT(hash != leekpp::detail::hash_bytes(buffer.data(), len, 1));
+    }
+
+    // Flipping any single byte changes the hash
+    for (std::size_t len : { 1, 3, 8, 16, 17, 48, 49, 100, 1023, 1024, 1025, 3000 })
+    {
+        auto hash = leekpp::detail::hash_bytes(buffer.data(), len);
+        for (std::size_t idx = 0; idx < len; ++idx)
+        {
+            buffer[idx] ^= 0x10;
+            TEST_ASSERT(hash != leekpp::detail::hash_bytes(buffer.data(), len));
+            buffer[idx] ^= 0x10;
+        }
+    }
+
+    // Swapping two stripes of the long path changes the hash
+    auto original = leekpp::detail::hash_bytes(buffer.data(), 2048);
+    std::swap_ranges(buffer.begin(), buffer.begin() + 64, buffer.begin() + 64);
+    TEST_ASSERT(original != leekpp::detail::hash_bytes(buffer.data(), 2048));
+    std::swap_ranges(buffer.begin(), buffer.begin() + 64, buffer.begin() + 64);
+
+#if LEEK_USE_AVX2
+    for (std::size_t len = leekpp::detail::hash_long_threshold; len <= buffer.size(); len += 37)
+    {
+        std::uint64_t scalar[8], vector[8];
+        for (std::size_t lane = 0; lane < 8; ++lane)
+            scalar[lane] = vector[lane] = leekpp::detail::hash_secret[lane];
+        leekpp::detail::hash_long_lanes_scalar(scalar, buffer.data(), len);
+        leekpp::detail::hash_long_lanes_avx2(vector, buffer.data(), len);
+        TEST_ASSERT(std::equal(scalar, scalar + 8, vector));
+    }
+#endif
+}
+
+void test_integers()
+{
+    leekpp::hash<int> int_hash;
+    leekpp::hash<long long> long_hash;
+    TEST_ASSERT(int_hash(-1) == long_hash(-1LL));
+    TEST_ASSERT(int_hash(42) == long_hash(42LL));
+    TEST_ASSERT(leekpp::hash<double>()(0.0) == leekpp::hash<double>()(-0.0));
+
+    // Sequential integers (the identity under std::hash) set about half of the output bits, at every bit position
+    const std::size_t count = 100000;
+    std::size_t bit_counts[64] = {};
+    for (std::size_t x = 0; x < count; ++x)
+    {
+        auto hash = leekpp::hash<std::size_t>()(x);
+        for (std::size_t bit = 0; bit < 64; ++bit)
+            bit_counts[bit] += (hash >> bit) & 1;
+    }
+    for (auto bit_count : bit_counts)
+        TEST_ASSERT_WITHIN(0.5, double(bit_count) / count, 0.01);
+
+    // Types without a specialization fall back to std::hash
+    TEST_ASSERT(leekpp::hash<std::vector<bool>>()(std::vector<bool>(3, true))
+                == leekpp::detail::hash_integer(std::hash<std::vector<bool>>()(std::vector<bool>(3, true)))
+               );
+}
+
+void test_strings()
+{
+    std::string value = "a string which is long enough to not fit in the small string buffer";
+    std::string_view view = value;
+    leekpp::hash<std::string> string_hash;
+    TEST_ASSERT(string_hash(value) == string_hash(view));
+    TEST_ASSERT(string_hash(value) == string_hash(value.c_str()));
+    TEST_ASSERT(string_hash(value) == leekpp::hash<std::string_view>()(view));
+    TEST_ASSERT(string_hash(value) != string_hash(view.substr(1)));
+    TEST_ASSERT(leekpp::hash<std::wstring>()(L"wide") == leekpp::hash<std::wstring_view>()(std::wstring_view(L"wide")));
+}
+
+template <typename TBloomFilter>
+void run_heterogeneous_test()
+{
+    auto filter = TBloomFilter::create_ideal(0.01, 1000);
+    std::vector<std::string> values;
+    for (std::size_t idx = 0; idx < 1000; ++idx)
+        values.push_back("value number " + std::to_string(idx) + " with a bit of padding past the SSO limit");
+
+    for (std::size_t idx = 0; idx < values.size(); ++idx)
+    {
+        if (idx % 2 == 0)
+            filter.insert(values[idx]);
+        else
+            filter.insert(std::string_view(values[idx]));
+    }
+
+    auto allocations_before = allocation_count;
+    std::size_t found = 0;
+    for (const auto& value : values)
+    {
+        found += filter.count(std::string_view(value));
+        found += filter.count(value.c_str());
+    }
+    TEST_ASSERT(allocation_count == allocations_before);
+    TEST_ASSERT(found == 2 * values.size());
+
+    for (const auto& value : values)
+        TEST_ASSERT(filter.count(value) == 1);
+}
+
+void run_test()
+{
+    test_bytes();
+    test_integers();
+    test_strings();
+    run_heterogeneous_test<leekpp::bloom_filter<std::string>>();
+    run_heterogeneous_test<leekpp::cache_aligned_bloom_filter<std::string>>();
+    run_heterogeneous_test<leekpp::double_hash_bloom_filter<std::string>>();
+    run_heterogeneous_test<leekpp::register_blocked_bloom_filter<std::string>>();
+    run_heterogeneous_test<leekpp::split_block_bloom_filter<std::string>>();
+}
+
+}
@@ -0,0 +1,81 @@
+#include "test.hpp"
+
+#include <leekpp/bloom_filter.hpp>
+#include <leekpp/mapped_storage.hpp>
+
+#include <cstddef>
+#include <cstdio>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include <unistd.h>
+
+namespace leekpp_tests
+{
+
+void run_test()
+{
+    using mapped_filter = leekpp::basic_bloom_filter<std::size_t,
+                                                     leekpp::basic_cache_aligned_mixer<std::size_t>,
+                                                     leekpp::mapped_storage
+                                                    >;
+    using memory_filter = leekpp::cache_aligned_bloom_filter<std::size_t>;
+
+    using leekpp::map_mode;
+    using leekpp::mapped_storage;
+
+    const std::string path = "leekpp_mapped_storage_" + std::to_string(::getpid()) + ".bin";
+    const std::size_t element_count = 10000;
+    auto memory = memory_filter::create_ideal(0.01, element_count);
+    const auto params = memory.params();
+
+    {
+        mapped_filter filter(params, mapped_storage::create(path, params.bit_count, 64));
+        for (std::size_t x = 0; x < element_count; ++x)
+        {
+            filter.insert(x * 3);
+            memory.insert(x * 3);
+        }
+        filter.data().sync();
+    }
+
+    // Reopening the file must give back exactly the same bits
+    {
+        mapped_filter filter(params, mapped_storage::open(path, params.bit_count, map_mode::read_only, 64));
+        TEST_ASSERT(filter.data().block_count() == memory.data().block_count());
+        for (std::size_t block_idx = 0; block_idx < memory.data().block_count(); ++block_idx)
+            TEST_ASSERT(filter.data()[block_idx] == memory.data()[block_idx]);
+        for (std::size_t x = 0; x < element_count; ++x)
+            TEST_ASSERT(filter.count(x * 3) == 1);
+
+        bool threw = false;
+        try
+        {
+            filter.insert(1);
+        }
+        catch (const std::logic_error&)
+        {
+            threw = true;
+        }
+        TEST_ASSERT(threw);
+    }
+
+    // Writes through a read_write mapping must persist after sync
+    {
+        auto storage = mapped_storage::open(path, params.bit_count, map_mode::read_write, 64);
+        mapped_filter filter(params, std::move(storage));
+        filter.insert(1);
+        filter.clear();
+        filter.insert(element_count * 5);
+        filter.data().sync();
+    }
+    {
+        mapped_filter filter(params, mapped_storage::open(path, params.bit_count, map_mode::read_only, 64));
+        TEST_ASSERT(filter.count(element_count * 5) == 1);
+    }
+
+    std::remove(path.c_str());
+}
+
+}
@@ -0,0 +1,135 @@
+#include "test.hpp"
+
+#include <leekpp/numa_sharded_bloom_filter.hpp>
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+void test_parse_id_list()
+{
+    std::vector<std::size_t> ids;
+    leekpp::detail::parse_id_list("0-2,5,8-9\n", [&] (std::size_t id) { ids.push_back(id); });
+    TEST_ASSERT((ids == std::vector<std::size_t>{ 0, 1, 2, 5, 8, 9 }));
+
+    ids.clear();
+    leekpp::detail::parse_id_list("", [&] (std::size_t id) { ids.push_back(id); });
+    TEST_ASSERT(ids.empty());
+    TEST_ASSERT(leekpp::detail::numa_node_count() >= 1);
+}
+
+void test_allocator()
+{
+    // Binding to a node which does not exist must fall back to regular memory
+    for (int node : { -1, 0, 1000 })
+    {
+        leekpp::numa_storage storage(100000, leekpp::numa_allocator<std::size_t>(node));
+        storage.set_mask(1000, 5);
+        TEST_ASSERT(storage[1000] == 5);
+        TEST_ASSERT(storage[0] == 0);
+    }
+}
+
+/** Every node count must give the same answers; counts above the real number of nodes use the fallbacks. **/
+void test_insert_count(std::size_t shard_count, std::size_t node_count)
+{
+    leekpp::numa_sharded_bloom_filter<std::size_t> filter(leekpp::bloom_filter_params(1 << 19, 7),
+                                                           shard_count,
+                                                           node_count
+                                                          );
+    TEST_ASSERT(filter.shard_count() == shard_count);
+    TEST_ASSERT(filter.node_count() == node_count);
+    TEST_ASSERT(filter.params().bit_count >= (1 << 19));
+    TEST_ASSERT(filter.params().num_hashes == 7);
+
+    const std::size_t elements = 50000;
+    std::vector<std::size_t> values;
+    for (std::size_t x = 0; x < elements; ++x)
+        values.push_back(x * 3);
+    filter.insert_many(values.begin(), values.end());
+
+    // Routing spreads the values evenly
+    for (std::size_t shard_idx = 0; shard_idx < shard_count; ++shard_idx)
+        TEST_ASSERT_WITHIN(double(elements) / shard_count,
+                           double(filter.shard(shard_idx).estimated_size()),
+                           0.05 * elements / shard_count
+                          );
+    TEST_ASSERT_WITHIN(double(elements), double(filter.estimated_size()), 0.02 * elements);
+
+    std::vector<std::size_t> probes;
+    for (std::size_t x = 0; x < 3 * elements; ++x)
+        probes.push_back(x);
+    std::vector<std::size_t> on_caller(probes.size());
+    std::vector<std::size_t> on_nodes(probes.size());
+    filter.count_many(probes.begin(), probes.end(), on_caller.begin());
+    filter.count_many(probes.begin(), probes.end(), on_nodes.begin(), leekpp::numa_lookup::node_threads);
+
+    std::size_t false_positives = 0;
+    for (std::size_t x = 0; x < probes.size(); ++x)
+    {
+        TEST_ASSERT(on_caller[x] == filter.count(x));
+        TEST_ASSERT(on_nodes[x] == on_caller[x]);
+        if (x % 3 == 0)
+            TEST_ASSERT(on_caller[x] == 1);
+        else
+            false_positives += on_caller[x];
+    }
+    auto expected = filter.expected_fpr(elements);
+    TEST_ASSERT_WITHIN(expected, double(false_positives) / (2 * elements), expected * 0.3);
+
+    filter.clear();
+    TEST_ASSERT(filter.set_bits() == 0);
+}
+
+void test_concurrent()
+{
+    auto filter = leekpp::numa_sharded_bloom_filter<std::size_t>::create_ideal(0.01, 40000, 4);
+    TEST_ASSERT(filter.shard_count() == 4);
+
+    std::vector<std::thread> threads;
+    for (std::size_t thread_idx = 0; thread_idx < 4; ++thread_idx)
+    {
+        threads.emplace_back([&, thread_idx]
+                             {
+                                 for (std::size_t x = 0; x < 10000; ++x)
+                                     filter.insert(thread_idx + 4 * x);
+                             }
+                            );
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    for (std::size_t x = 0; x < 40000; ++x)
+        TEST_ASSERT(filter.count(x) == 1);
+    TEST_ASSERT(filter.expected_fpr(40000) <= 0.011);
+}
+
+/** A mixer which only supports some bit counts gets one of them for every shard, whatever the bit count asked for. **/
+void test_round_bit_count()
+{
+    using filter_type = leekpp::basic_numa_sharded_bloom_filter<std::size_t, leekpp::basic_foldable_mixer<std::size_t>>;
+
+    filter_type filter(leekpp::bloom_filter_params(300000, 7), 3, 1);
+    for (std::size_t shard_idx = 0; shard_idx < filter.shard_count(); ++shard_idx)
+        TEST_ASSERT(filter.shard(shard_idx).params().bit_count == 131072);
+    for (std::size_t x = 0; x < 10000; ++x)
+        filter.insert(x);
+    for (std::size_t x = 0; x < 10000; ++x)
+        TEST_ASSERT(filter.count(x) == 1);
+}
+
+void run_test()
+{
+    test_parse_id_list();
+    test_allocator();
+    test_insert_count(1, 1);
+    test_insert_count(4, 2);
+    test_insert_count(6, 4);
+    test_concurrent();
+    test_round_bit_count();
+}
+
+}
@@ -0,0 +1,75 @@
+#include "test.hpp"
+
+#include <leekpp/bloom_filter.hpp>
+#include <leekpp/split_block_bloom_filter.hpp>
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+template <typename TBloomFilter>
+void run_prehashed_test()
+{
+    // Filters of several sizes, so every one derives different indices from the same hash
+    std::vector<TBloomFilter> filters;
+    for (std::size_t capacity : { 100, 1000, 5000, 20000 })
+        filters.push_back(TBloomFilter::create_ideal(0.01, capacity));
+
+    std::vector<std::string> values;
+    for (std::size_t idx = 0; idx < 20000; ++idx)
+        values.push_back("prehashed value " + std::to_string(idx));
+
+    // insert_hash sets the same bits as insert
+    for (std::size_t idx = 0; idx < values.size(); ++idx)
+    {
+        auto& filter = filters[idx % filters.size()];
+        if (idx % 2 == 0)
+            filter.insert(values[idx]);
+        else
+            filter.insert_hash(filter.hash_value(values[idx]));
+    }
+    for (std::size_t idx = 0; idx < values.size(); ++idx)
+        TEST_ASSERT(filters[idx % filters.size()].count(values[idx]) == 1);
+
+    // One hash gives the same answer as count on every filter
+    for (const auto& value : values)
+    {
+        auto hashed = TBloomFilter::hash_value(value);
+        for (const auto& filter : filters)
+            TEST_ASSERT(filter.count_hash(hashed) == filter.count(value));
+    }
+}
+
+template <typename TBloomFilter>
+void run_probe_test()
+{
+    // Same-sized filters can share a probe
+    std::vector<TBloomFilter> filters(8, TBloomFilter::create_ideal(0.01, 1000));
+    for (std::size_t x = 0; x < 8000; ++x)
+        filters[x % filters.size()].insert(x);
+
+    for (std::size_t x = 0; x < 16000; ++x)
+    {
+        auto probe = filters.front().probe(TBloomFilter::hash_value(x));
+        for (const auto& filter : filters)
+            TEST_ASSERT(filter.count_probe(probe) == filter.count(x));
+    }
+}
+
+void run_test()
+{
+    run_prehashed_test<leekpp::bloom_filter<std::string>>();
+    run_prehashed_test<leekpp::cache_aligned_bloom_filter<std::string>>();
+    run_prehashed_test<leekpp::double_hash_bloom_filter<std::string>>();
+    run_prehashed_test<leekpp::register_blocked_bloom_filter<std::string>>();
+    run_prehashed_test<leekpp::split_block_bloom_filter<std::string>>();
+
+    run_probe_test<leekpp::bloom_filter<std::size_t>>();
+    run_probe_test<leekpp::cache_aligned_bloom_filter<std::size_t>>();
+    run_probe_test<leekpp::register_blocked_bloom_filter<std::size_t>>();
+}
+
+}
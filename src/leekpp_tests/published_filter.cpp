@@ -0,0 +1,144 @@
+#include "test.hpp"
+
+#include <leekpp/bloom_filter.hpp>
+#include <leekpp/published_filter.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+void test_cow_storage()
+{
+    leekpp::cow_bloom_filter<std::size_t> original(leekpp::bloom_filter_params(std::size_t(1) << 24, 7));
+    TEST_ASSERT(original.data().unshared_page_count() == 0);
+    for (std::size_t x = 0; x < 1000; ++x)
+        original.insert(x);
+    auto written_pages = original.data().unshared_page_count();
+    TEST_ASSERT(written_pages > 0);
+
+    // A copy shares every page until it writes, and then only duplicates the pages it writes to
+    auto copy = original;
+    TEST_ASSERT(copy.data().unshared_page_count() == 0);
+    for (std::size_t x = 0; x < 1000; ++x)
+        copy.insert(x);
+    TEST_ASSERT(copy.data().unshared_page_count() == 0);
+    for (std::size_t x = 1000; x < 1010; ++x)
+        copy.insert(x);
+    TEST_ASSERT(copy.data().unshared_page_count() > 0);
+    TEST_ASSERT(copy.data().unshared_page_count() <= 70);
+
+    std::size_t original_positives = 0;
+    for (std::size_t x = 0; x < 1010; ++x)
+    {
+        TEST_ASSERT(copy.count(x) == 1);
+        original_positives += original.count(x);
+    }
+    TEST_ASSERT(original_positives == 1000);
+
+    copy.clear();
+    TEST_ASSERT(copy.set_bits() == 0);
+    TEST_ASSERT(original.count(1) == 1);
+}
+
+/** Readers must always see a whole filter: one of the two which are being published in turn. **/
+void test_publish()
+{
+    const auto params = leekpp::bloom_filter_params::create_ideal(0.001, 2000);
+    auto build = [&] (std::size_t base)
+                 {
+                     leekpp::bloom_filter<std::size_t> filter(params);
+                     for (std::size_t x = base; x < base + 1000; ++x)
+                         filter.insert(x);
+                     return filter;
+                 };
+
+    leekpp::published_bloom_filter<std::size_t> published(build(0));
+    std::atomic<bool> done(false);
+    std::atomic<std::size_t> torn(0);
+    std::vector<std::thread> readers;
+    for (std::size_t reader_idx = 0; reader_idx < 2; ++reader_idx)
+    {
+        readers.emplace_back([&]
+                             {
+                                 while (!done.load())
+                                 {
+                                     auto snapshot = published.read();
+                                     std::size_t low = 0, high = 0;
+                                     for (std::size_t x = 0; x < 1000; ++x)
+                                     {
+                                         low  += snapshot->count(x);
+                                         high += snapshot->count(x + 1000);
+                                     }
+                                     if (low != 1000 && high != 1000)
+                                         ++torn;
+                                 }
+                             }
+                            );
+    }
+
+    for (std::size_t round = 1; round <= 50; ++round)
+    {
+        auto previous = published.publish(build(round % 2 == 0 ? 0 : 1000));
+        TEST_ASSERT(previous.count(round % 2 == 0 ? 1000 : 0) == 1);
+    }
+    done.store(true);
+    for (auto& reader : readers)
+        reader.join();
+    TEST_ASSERT(torn.load() == 0);
+
+    published.clear();
+    TEST_ASSERT(published.read()->set_bits() == 0);
+}
+
+void test_update()
+{
+    leekpp::published_cow_bloom_filter<std::size_t> published(
+            leekpp::cow_bloom_filter<std::size_t>(leekpp::bloom_filter_params::create_ideal(0.001, 100000))
+        );
+
+    std::atomic<bool> done(false);
+    std::atomic<std::size_t> lost(0);
+    std::thread reader([&]
+                       {
+                           while (!done.load())
+                           {
+                               // Once the first update is published, every later snapshot has all of its values
+                               auto snapshot = published.read();
+                               if (snapshot->set_bits() == 0)
+                                   continue;
+                               for (std::size_t x = 0; x < 100; ++x)
+                                   if (snapshot->count(x) == 0)
+                                       ++lost;
+                           }
+                       }
+                      );
+
+    for (std::size_t round = 0; round < 100; ++round)
+    {
+        published.update([&] (leekpp::cow_bloom_filter<std::size_t>& filter)
+                         {
+                             for (std::size_t x = round * 100; x < (round + 1) * 100; ++x)
+                                 filter.insert(x);
+                         }
+                        );
+    }
+    done.store(true);
+    reader.join();
+    TEST_ASSERT(lost.load() == 0);
+
+    for (std::size_t x = 0; x < 10000; ++x)
+        TEST_ASSERT(published.count(x) == 1);
+}
+
+void run_test()
+{
+    test_cow_storage();
+    test_publish();
+    test_update();
+}
+
+}
@@ -0,0 +1,23 @@
+#include "accuracy.hpp"
+#include "test.hpp"
+
+#include <leekpp/bloom_filter.hpp>
+
+namespace leekpp_tests
+{
+
+void run_test()
+{
+    using filter_type = leekpp::register_blocked_bloom_filter<std::size_t>;
+
+    // The FPR penalty of blocking on a single word is substantial, so make sure it is accounted for
+    auto filter = filter_type::create_ideal(0.05, 1000000);
+    TEST_ASSERT(filter.expected_fpr(1000000) > 1.2 * filter.params().expected_fpr(1000000));
+
+    run_accuracy_test<filter_type>();
+    run_accuracy_test<filter_type>(0.01, 200000);
+    // More than 10 bits use more than one 64-bit hash's worth of 6-bit draws
+    run_accuracy_test<filter_type>(0.0005, 200000);
+}
+
+}
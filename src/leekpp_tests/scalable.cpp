@@ -0,0 +1,59 @@
+#include "test.hpp"
+
+#include <leekpp/scalable_bloom_filter.hpp>
+
+#include <cstddef>
+#include <iostream>
+
+namespace leekpp_tests
+{
+
+template <typename TScalableFilter>
+void run_growth_test(double desired_fpr, std::size_t initial_capacity, std::size_t element_count)
+{
+    auto filter = TScalableFilter::create_ideal(desired_fpr, initial_capacity);
+    TEST_ASSERT(filter.stages().size() == 1);
+
+    for (std::size_t x = 0; x < element_count; ++x)
+        filter.insert(x);
+
+    // Growing 10x past the initial capacity with a growth of 2 takes at least 3 more stages
+    TEST_ASSERT(filter.stages().size() >= 4);
+    TEST_ASSERT(filter.expected_fpr() <= desired_fpr);
+
+    auto estimate = filter.estimated_count();
+    TEST_ASSERT(estimate > element_count * 9 / 10 && estimate < element_count * 11 / 10);
+
+    for (std::size_t x = 0; x < element_count; ++x)
+        TEST_ASSERT(filter.count(x) == 1);
+
+    std::size_t false_positives = 0;
+    for (std::size_t x = element_count; x < 2 * element_count; ++x)
+        false_positives += filter.count(x);
+    double measured_fpr = double(false_positives) / element_count;
+    std::cout << "stages=" << filter.stages().size()
+              << " expected_fpr=" << filter.expected_fpr()
+              << " measured_fpr=" << measured_fpr
+              << std::endl;
+    TEST_ASSERT(measured_fpr <= desired_fpr * 1.1);
+
+    filter.clear();
+    TEST_ASSERT(filter.stages().size() == 1);
+    TEST_ASSERT(filter.count(0) == 0);
+}
+
+void run_test()
+{
+    run_growth_test<leekpp::scalable_bloom_filter<std::size_t>>(0.01, 10000, 100000);
+    run_growth_test<leekpp::basic_scalable_bloom_filter<std::size_t,
+                                                        leekpp::basic_cache_aligned_mixer<std::size_t>
+                                                       >
+                   >(0.01, 10000, 100000);
+    // Stages must get a bit count the mixer supports, which for this one is a power of 2
+    run_growth_test<leekpp::basic_scalable_bloom_filter<std::size_t,
+                                                        leekpp::basic_foldable_mixer<std::size_t>
+                                                       >
+                   >(0.01, 10000, 100000);
+}
+
+}
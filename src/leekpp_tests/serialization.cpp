@@ -0,0 +1,176 @@
+#include "test.hpp"
+
+#include <leekpp/bloom_filter.hpp>
+#include <leekpp/serialization.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace leekpp_tests
+{
+
+template <typename TFilterA, typename TFilterB>
+void assert_same_contents(const TFilterA& a, const TFilterB& b)
+{
+    TEST_ASSERT(a.params().bit_count == b.params().bit_count);
+    TEST_ASSERT(a.params().num_hashes == b.params().num_hashes);
+    TEST_ASSERT(a.data().block_count() == b.data().block_count());
+    for (std::size_t block_idx = 0; block_idx < a.data().block_count(); ++block_idx)
+        TEST_ASSERT(a.data()[block_idx] == b.data()[block_idx]);
+}
+
+template <typename TBloomFilter>
+TBloomFilter make_filter(std::size_t element_count = 20000)
+{
+    auto filter = TBloomFilter::create_ideal(0.01, element_count);
+    for (std::size_t x = 0; x < element_count; ++x)
+        filter.insert(x * 7);
+    return filter;
+}
+
+template <typename TFunction>
+bool throws_serialization_error(TFunction func)
+{
+    try
+    {
+        func();
+        return false;
+    }
+    catch (const leekpp::serialization_error&)
+    {
+        return true;
+    }
+}
+
+void test_stream_round_trip()
+{
+    auto original = make_filter<leekpp::cache_aligned_bloom_filter<std::size_t>>();
+    std::stringstream ss;
+    leekpp::save(ss, original);
+    TEST_ASSERT(ss.str().size() == leekpp::serialized_size(original));
+
+    auto loaded = leekpp::load<leekpp::cache_aligned_bloom_filter<std::size_t>>(ss);
+    assert_same_contents(original, loaded);
+}
+
+void test_buffer_round_trip()
+{
+    auto original = make_filter<leekpp::bloom_filter<std::size_t>>();
+    std::vector<char> buffer(leekpp::serialized_size(original));
+    TEST_ASSERT(leekpp::save(buffer.data(), buffer.size(), original) == buffer.size());
+    auto loaded = leekpp::load<leekpp::bloom_filter<std::size_t>>(buffer.data(), buffer.size());
+    assert_same_contents(original, loaded);
+
+    // Storage without contiguous data goes through the chunked path, but uses the same format
+    auto thread_safe = leekpp::load<leekpp::thread_safe_bloom_filter<std::size_t>>(buffer.data(), buffer.size());
+    assert_same_contents(original, thread_safe);
+    std::vector<char> rewritten(buffer.size());
+    leekpp::save(rewritten.data(), rewritten.size(), thread_safe);
+    TEST_ASSERT(rewritten == buffer);
+
+    // Mismatches must be detected
+    TEST_ASSERT(throws_serialization_error([&] { leekpp::save(buffer.data(), buffer.size() - 1, original); }));
+    TEST_ASSERT(throws_serialization_error([&]
+    {
+        leekpp::load<leekpp::bloom_filter<std::size_t>>(buffer.data(), 63);
+    }));
+    TEST_ASSERT(throws_serialization_error([&]
+    {
+        leekpp::load<leekpp::double_hash_bloom_filter<std::size_t>>(buffer.data(), buffer.size());
+    }));
+    TEST_ASSERT(throws_serialization_error([&]
+    {
+        leekpp::load<leekpp::cache_aligned_bloom_filter<std::size_t>>(buffer.data(), buffer.size());
+    }));
+
+    auto corrupt = buffer;
+    corrupt[corrupt.size() / 2] ^= 0x10;
+    TEST_ASSERT(throws_serialization_error([&]
+    {
+        leekpp::load<leekpp::bloom_filter<std::size_t>>(corrupt.data(), corrupt.size());
+    }));
+}
+
+/** Overwrite the header field at \a offset, leaving the checksum as it was. **/
+std::vector<char> patch_header(std::vector<char> buffer, std::size_t offset, std::uint64_t value)
+{
+    std::memcpy(buffer.data() + offset, &value, sizeof value);
+    return buffer;
+}
+
+void test_corrupt_header()
+{
+    using filter_type = leekpp::bloom_filter<std::size_t>;
+
+    auto original = make_filter<filter_type>();
+    std::vector<char> buffer(leekpp::serialized_size(original));
+    leekpp::save(buffer.data(), buffer.size(), original);
+
+    // The checksum covers the header, so a changed hash count is caught rather than loaded as a broken filter
+    for (std::uint64_t num_hashes : { 0, 40 })
+    {
+        auto corrupt = patch_header(buffer, 24, num_hashes);
+        TEST_ASSERT(throws_serialization_error([&] { leekpp::load<filter_type>(corrupt.data(), corrupt.size()); }));
+        std::stringstream ss(std::string(corrupt.begin(), corrupt.end()));
+        TEST_ASSERT(throws_serialization_error([&] { leekpp::load<filter_type>(ss); }));
+    }
+
+    // A consistent bit and block count which is far larger than the input must fail before allocating
+    std::uint64_t huge_bits = std::uint64_t(1) << 60;
+    auto corrupt = patch_header(patch_header(buffer, 16, huge_bits), 32, huge_bits / 64);
+    TEST_ASSERT(throws_serialization_error([&] { leekpp::load<filter_type>(corrupt.data(), corrupt.size()); }));
+    std::stringstream ss(std::string(corrupt.begin(), corrupt.end()));
+    TEST_ASSERT(throws_serialization_error([&] { leekpp::load<filter_type>(ss); }));
+}
+
+void test_file_round_trip()
+{
+    using mapped_filter = leekpp::basic_bloom_filter<std::size_t,
+                                                     leekpp::basic_cache_aligned_mixer<std::size_t>,
+                                                     leekpp::mapped_storage
+                                                    >;
+
+    auto original = make_filter<leekpp::cache_aligned_bloom_filter<std::size_t>>();
+    const std::string path = "leekpp_serialization_" + std::to_string(::getpid()) + ".bin";
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    TEST_ASSERT(fd >= 0);
+    leekpp::save(fd, original);
+    ::lseek(fd, 0, SEEK_SET);
+    auto loaded = leekpp::load<leekpp::cache_aligned_bloom_filter<std::size_t>>(fd);
+    ::close(fd);
+    assert_same_contents(original, loaded);
+
+    auto mapped = leekpp::load_mapped<mapped_filter>(path, leekpp::map_mode::read_only, true);
+    assert_same_contents(original, mapped);
+    for (std::size_t x = 0; x < 20000; ++x)
+        TEST_ASSERT(mapped.count(x * 7) == 1);
+
+    // A truncated file is rejected from its size before it is read or mapped
+    TEST_ASSERT(::truncate(path.c_str(), off_t(leekpp::serialized_size(original) - 8)) == 0);
+    fd = ::open(path.c_str(), O_RDONLY);
+    TEST_ASSERT(fd >= 0);
+    TEST_ASSERT(throws_serialization_error([&] { leekpp::load<leekpp::cache_aligned_bloom_filter<std::size_t>>(fd); }));
+    ::close(fd);
+    TEST_ASSERT(throws_serialization_error([&] { leekpp::load_mapped<mapped_filter>(path); }));
+
+    std::remove(path.c_str());
+}
+
+void run_test()
+{
+    test_stream_round_trip();
+    test_buffer_round_trip();
+    test_corrupt_header();
+    test_file_round_trip();
+}
+
+}
@@ -0,0 +1,117 @@
+#include "test.hpp"
+
+#include <leekpp/bloom_filter.hpp>
+#include <leekpp/parallel.hpp>
+
+#include <cstddef>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+template <typename TFilterA, typename TFilterB>
+void assert_same_contents(const TFilterA& a, const TFilterB& b)
+{
+    TEST_ASSERT(a.data().block_count() == b.data().block_count());
+    for (std::size_t block_idx = 0; block_idx < a.data().block_count(); ++block_idx)
+        TEST_ASSERT(a.data()[block_idx] == b.data()[block_idx]);
+}
+
+template <typename TBloomFilter>
+void run_union_test()
+{
+    const auto params = TBloomFilter::create_ideal(0.01, 20000).params();
+    TBloomFilter a(params), b(params), both(params);
+    for (std::size_t x = 0; x < 10000; ++x)
+    {
+        a.insert(x);
+        b.insert(x + 1000000);
+        both.insert(x);
+        both.insert(x + 1000000);
+    }
+
+    // A union is exactly the same as inserting everything into one filter
+    assert_same_contents(a | b, both);
+
+    // An intersection keeps everything in both, but nothing which is only in one of them (modulo false positives)
+    TBloomFilter b_and_a(params);
+    for (std::size_t x = 5000; x < 10000; ++x)
+        b_and_a.insert(x);
+    auto intersection = a & (b | b_and_a);
+    std::size_t only_a_positives = 0;
+    for (std::size_t x = 0; x < 10000; ++x)
+    {
+        if (x >= 5000)
+            TEST_ASSERT(intersection.count(x) == 1);
+        else
+            only_a_positives += intersection.count(x);
+    }
+    TEST_ASSERT(only_a_positives < 500);
+}
+
+void test_mismatched_params()
+{
+    leekpp::bloom_filter<std::size_t> a(leekpp::bloom_filter_params(1024, 3));
+    leekpp::bloom_filter<std::size_t> b(leekpp::bloom_filter_params(2048, 3));
+    bool threw = false;
+    try
+    {
+        a.union_with(b);
+    }
+    catch (const std::invalid_argument&)
+    {
+        threw = true;
+    }
+    TEST_ASSERT(threw);
+}
+
+void test_live_merge()
+{
+    const auto params = leekpp::bloom_filter_params::create_ideal(0.01, 200000);
+    leekpp::thread_safe_bloom_filter<std::size_t> live(params);
+    leekpp::bloom_filter<std::size_t> shard(params);
+    for (std::size_t x = 0; x < 100000; ++x)
+        shard.insert(x);
+
+    // Merge a shard into a filter which another thread is inserting into at the same time
+    std::thread writer([&] { for (std::size_t x = 100000; x < 200000; ++x) live.insert(x); });
+    live.union_with(shard);
+    writer.join();
+
+    for (std::size_t x = 0; x < 200000; ++x)
+        TEST_ASSERT(live.count(x) == 1);
+}
+
+void test_merge_parallel()
+{
+    using filter_type = leekpp::cache_aligned_bloom_filter<std::size_t>;
+    const auto params = filter_type::create_ideal(0.01, 80000).params();
+
+    std::vector<filter_type> shards(8, filter_type(params));
+    filter_type expected(params);
+    for (std::size_t x = 0; x < 80000; ++x)
+    {
+        shards[x % shards.size()].insert(x);
+        expected.insert(x);
+    }
+
+    for (std::size_t threads : { 1, 3, 4, 64 })
+    {
+        filter_type merged(params);
+        leekpp::merge_parallel(merged, shards.begin(), shards.end(), threads);
+        assert_same_contents(merged, expected);
+    }
+}
+
+void run_test()
+{
+    run_union_test<leekpp::bloom_filter<std::size_t>>();
+    run_union_test<leekpp::cache_aligned_bloom_filter<std::size_t>>();
+    test_mismatched_params();
+    test_live_merge();
+    test_merge_parallel();
+}
+
+}
@@ -0,0 +1,110 @@
+#include "test.hpp"
+
+#include <leekpp/sliding_window_bloom_filter.hpp>
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+template <typename TWindowFilter>
+void run_capacity_window_test()
+{
+    const std::size_t capacity = 1000;
+    TWindowFilter filter(0.01, capacity, 4);
+    TEST_ASSERT(filter.generations().size() == 5);
+
+    const std::size_t element_count = 20 * capacity;
+    for (std::size_t x = 0; x < element_count; ++x)
+        filter.insert(x);
+
+    // The last (g - 1) generations' worth is always remembered
+    for (std::size_t x = element_count - 3 * capacity; x < element_count; ++x)
+        TEST_ASSERT(filter.count(x) == 1);
+
+    // Anything older than g generations is forgotten, apart from false positives
+    std::size_t old_positives = 0;
+    for (std::size_t x = 0; x < element_count - 4 * capacity; ++x)
+        old_positives += filter.count(x);
+    TEST_ASSERT(old_positives < (element_count - 4 * capacity) * 0.01);
+    TEST_ASSERT(filter.expected_fpr() <= 0.01);
+    // The last insert filled a generation, so the current one is empty
+    TEST_ASSERT_WITHIN(3.0 * capacity, double(filter.estimated_count()), 0.05 * 3 * capacity);
+
+    filter.clear();
+    TEST_ASSERT(filter.count(element_count - 1) == 0);
+    TEST_ASSERT(filter.estimated_count() == 0);
+}
+
+void test_manual_rotation()
+{
+    leekpp::sliding_window_bloom_filter<std::size_t> filter(0.01, 1000, 3, leekpp::window_rotation::manual);
+    for (std::size_t x = 0; x < 5000; ++x)
+        filter.insert(x);
+    // Over capacity, but nothing rotates without being asked
+    TEST_ASSERT(filter.count(0) == 1);
+
+    filter.rotate();
+    filter.rotate();
+    for (std::size_t x = 0; x < 5000; ++x)
+        TEST_ASSERT(filter.count(x) == 1);
+
+    filter.rotate();
+    std::size_t positives = 0;
+    for (std::size_t x = 0; x < 5000; ++x)
+        positives += filter.count(x);
+    TEST_ASSERT(positives == 0);
+}
+
+void test_concurrent()
+{
+    const std::size_t capacity = 5000;
+    leekpp::thread_safe_sliding_window_bloom_filter<std::size_t> filter(0.01, capacity, 4);
+
+    std::atomic<bool> done(false);
+    std::thread reader([&]
+                       {
+                           std::size_t x = 0;
+                           while (!done.load())
+                               filter.count(x++);
+                       }
+                      );
+    std::vector<std::thread> writers;
+    for (std::size_t thread_idx = 0; thread_idx < 4; ++thread_idx)
+    {
+        writers.emplace_back([&, thread_idx]
+                             {
+                                 for (std::size_t x = 0; x < 10 * capacity; ++x)
+                                     filter.insert(thread_idx << 32 | x);
+                             }
+                            );
+    }
+    for (auto& writer : writers)
+        writer.join();
+    done.store(true);
+    reader.join();
+
+    // With no rotation in flight, the newest values must all be present
+    for (std::size_t x = 0; x < capacity; ++x)
+        filter.insert(std::size_t(5) << 32 | x);
+    for (std::size_t x = 0; x < capacity; ++x)
+        TEST_ASSERT(filter.count(std::size_t(5) << 32 | x) == 1);
+    TEST_ASSERT(filter.generations().size() == 5);
+}
+
+void run_test()
+{
+    run_capacity_window_test<leekpp::sliding_window_bloom_filter<std::size_t>>();
+    run_capacity_window_test<leekpp::basic_sliding_window_bloom_filter<std::size_t,
+                                                                       leekpp::basic_cache_aligned_mixer<std::size_t>
+                                                                      >
+                            >();
+    run_capacity_window_test<leekpp::thread_safe_sliding_window_bloom_filter<std::size_t>>();
+    test_manual_rotation();
+    test_concurrent();
+}
+
+}
@@ -0,0 +1,15 @@
+#include "accuracy.hpp"
+#include "test.hpp"
+
+#include <leekpp/split_block_bloom_filter.hpp>
+
+namespace leekpp_tests
+{
+
+void run_test()
+{
+    run_accuracy_test<leekpp::split_block_bloom_filter<std::size_t>>();
+    run_accuracy_test<leekpp::split_block_bloom_filter<std::size_t>>(0.01, 200000);
+}
+
+}
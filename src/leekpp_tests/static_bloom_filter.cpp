@@ -0,0 +1,127 @@
+#include "test.hpp"
+
+#include <leekpp/bloom_filter.hpp>
+#include <leekpp/static_bloom_filter.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace leekpp_tests
+{
+
+// The sizing helper must agree with the runtime one, and be usable as template arguments
+constexpr auto small_params   = leekpp::static_ideal_params(0.01, 1000);
+constexpr auto aligned_params = leekpp::static_ideal_params(0.01, 1000, 512);
+static_assert(small_params.num_hashes == 7, "static_ideal_params should give k=7 for 1%");
+static_assert(aligned_params.bit_count % 512 == 0, "static_ideal_params should round up to the block size");
+static_assert(leekpp::static_ideal_params(0.01, 10, 512).num_hashes == 7,
+              "static_ideal_params should pick k before rounding up to the block size"
+             );
+
+template <typename TFunction>
+bool throws_invalid_argument(TFunction func)
+{
+    try
+    {
+        func();
+        return false;
+    }
+    catch (const std::invalid_argument&)
+    {
+        return true;
+    }
+}
+
+void test_sizing()
+{
+    for (double fpr : { 0.5, 0.1, 0.01, 0.001, 1e-6 })
+    {
+        for (std::size_t elements : { 1, 100, 12345, 10000000 })
+        {
+            auto expected = leekpp::bloom_filter_params::create_ideal(fpr, elements);
+            auto actual   = leekpp::static_ideal_params(fpr, elements);
+            // The last digit of a float-to-integer truncation can differ between the two logs
+            TEST_ASSERT_WITHIN(double(expected.bit_count), double(actual.bit_count), 1.0);
+            TEST_ASSERT(expected.num_hashes == actual.num_hashes);
+
+            // Rounding up to a block must not change the number of hashes
+            auto aligned = leekpp::cache_aligned_bloom_filter<std::size_t>::create_ideal(fpr, elements).params();
+            auto rounded = leekpp::static_ideal_params(fpr, elements, 512);
+            TEST_ASSERT(rounded.bit_count % 512 == 0);
+            TEST_ASSERT_WITHIN(double(aligned.bit_count), double(rounded.bit_count), 512.0);
+            TEST_ASSERT(aligned.num_hashes == rounded.num_hashes);
+        }
+    }
+
+    // Bad arguments must throw at runtime rather than loop forever or divide by zero
+    for (double fpr : { 0.0, -0.5, 1.0, 2.0 })
+        TEST_ASSERT(throws_invalid_argument([&] { leekpp::static_ideal_params(fpr, 1000); }));
+    TEST_ASSERT(throws_invalid_argument([] { leekpp::static_ideal_params(0.01, 0); }));
+}
+
+/** A static filter must set exactly the same bits as a dynamic one with the same parameters and mixer. **/
+template <typename TMixer, std::size_t KBits, std::size_t KHashes>
+void run_equivalence_test()
+{
+    using static_filter  = leekpp::static_bloom_filter<std::size_t, KBits, KHashes, TMixer>;
+    using dynamic_filter = leekpp::basic_bloom_filter<std::size_t, TMixer, leekpp::basic_storage<std::uint64_t>>;
+
+    static_filter  fixed;
+    dynamic_filter dynamic(leekpp::bloom_filter_params(KBits, KHashes));
+    for (std::size_t x = 0; x < 1000; ++x)
+    {
+        fixed.insert(x * 7);
+        dynamic.insert(x * 7);
+    }
+
+    TEST_ASSERT(fixed.data().size() == dynamic.data().block_count());
+    for (std::size_t block_idx = 0; block_idx < fixed.data().size(); ++block_idx)
+        TEST_ASSERT(fixed.data()[block_idx] == dynamic.data()[block_idx]);
+    for (std::size_t x = 0; x < 10000; ++x)
+        TEST_ASSERT(fixed.count(x) == dynamic.count(x));
+    TEST_ASSERT(fixed.set_bits() == dynamic.set_bits());
+    TEST_ASSERT(fixed.expected_fpr(1000) == dynamic.expected_fpr(1000));
+
+    auto hashed = static_filter::hash_value(std::size_t(7));
+    TEST_ASSERT(fixed.count_hash(hashed) == 1);
+
+    fixed.clear();
+    TEST_ASSERT(fixed.set_bits() == 0);
+    TEST_ASSERT(fixed.count(7) == 0);
+}
+
+void test_inline()
+{
+    // Lives on the stack, holds what it was given and merges with another of the same type
+    using filter_type = leekpp::static_bloom_filter<std::string, small_params.bit_count, small_params.num_hashes>;
+    struct holder
+    {
+        int         id;
+        filter_type filter;
+    };
+    static_assert(sizeof(holder) >= small_params.bit_count / 8, "The blocks should be stored inline");
+
+    holder a{ 1, {} }, b{ 2, {} };
+    a.filter.insert("alpha");
+    b.filter.insert(std::string_view("beta"));
+    a.filter.union_with(b.filter);
+    TEST_ASSERT(a.filter.count("alpha") == 1);
+    TEST_ASSERT(a.filter.count(std::string("beta")) == 1);
+    TEST_ASSERT_WITHIN(2.0, double(a.filter.estimated_size()), 0.5);
+}
+
+void run_test()
+{
+    test_sizing();
+    run_equivalence_test<leekpp::basic_double_hash_mixer<std::size_t>, 9585, 7>();
+    run_equivalence_test<leekpp::basic_mixer<std::size_t>, 9585, 7>();
+    run_equivalence_test<leekpp::basic_cache_aligned_double_hash_mixer<std::size_t>, aligned_params.bit_count,
+                         aligned_params.num_hashes>();
+    run_equivalence_test<leekpp::basic_register_blocked_mixer<std::size_t>, 8192, 4>();
+    test_inline();
+}
+
+}
@@ -0,0 +1,149 @@
+#include "test.hpp"
+
+#include <leekpp/bloom_filter.hpp>
+#include <leekpp/parallel.hpp>
+#include <leekpp/serialization.hpp>
+#include <leekpp/stats.hpp>
+#include <leekpp/write_combining_buffer.hpp>
+
+#include <cstddef>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+using stats_filter = leekpp::basic_bloom_filter<std::size_t,
+                                                leekpp::basic_mixer<std::size_t>,
+                                                leekpp::storage,
+                                                leekpp::sharded_stats
+                                               >;
+
+void test_no_stats()
+{
+    // The default policy must not cost any space
+    constexpr auto plain_size = sizeof(leekpp::storage) + sizeof(leekpp::bloom_filter_params);
+    static_assert(sizeof(leekpp::bloom_filter<std::size_t>) == plain_size, "no_stats should take no space");
+
+    auto filter = leekpp::bloom_filter<std::size_t>::create_ideal(0.01, 1000);
+    filter.insert(1);
+    filter.count(1);
+    auto snapshot = filter.snapshot();
+    TEST_ASSERT(snapshot.counters.inserts == 0);
+    TEST_ASSERT(snapshot.counters.queries == 0);
+    TEST_ASSERT(snapshot.hit_ratio() == 0.0);
+    TEST_ASSERT(snapshot.set_bits == filter.set_bits());
+    TEST_ASSERT(snapshot.estimated_size == 1);
+}
+
+void test_counters()
+{
+    auto filter = stats_filter::create_ideal(0.01, 10000);
+    for (std::size_t x = 0; x < 5000; ++x)
+        filter.insert(x);
+    std::vector<std::size_t> values;
+    for (std::size_t x = 5000; x < 10000; ++x)
+        values.push_back(x);
+    filter.insert_many(values.begin(), values.end());
+    filter.insert_hash(stats_filter::hash_value(std::size_t(10000)));
+
+    std::size_t positives = 0;
+    for (std::size_t x = 0; x < 20000; ++x)
+        positives += filter.count(x);
+    std::vector<std::size_t> results(values.size());
+    filter.count_many(values.begin(), values.end(), results.begin());
+    positives += values.size();
+    positives += filter.count_hash(stats_filter::hash_value(std::size_t(1)));
+
+    auto snapshot = filter.snapshot();
+    TEST_ASSERT(snapshot.counters.inserts == 10001);
+    TEST_ASSERT(snapshot.counters.queries == 20000 + values.size() + 1);
+    TEST_ASSERT(snapshot.counters.positives == positives);
+    TEST_ASSERT_WITHIN(double(positives) / (20000 + values.size() + 1), snapshot.hit_ratio(), 1e-12);
+    TEST_ASSERT_WITHIN(10001.0, double(snapshot.estimated_size), 300.0);
+    TEST_ASSERT_WITHIN(0.01, snapshot.expected_fpr, 0.002);
+    TEST_ASSERT_WITHIN(snapshot.expected_fpr, snapshot.estimated_fpr, snapshot.expected_fpr * 0.1);
+
+    // Copies (and so loading, which returns by value) keep the totals
+    stats_filter copy(filter);
+    TEST_ASSERT(copy.snapshot().counters.inserts == 10001);
+    std::stringstream ss;
+    leekpp::save(ss, filter);
+    auto loaded = leekpp::load<stats_filter>(ss);
+    TEST_ASSERT(loaded.count(1) == 1);
+
+    // Clearing the contents does not clear the counters
+    filter.clear();
+    TEST_ASSERT(filter.snapshot().counters.inserts == 10001);
+    filter.reset_stats();
+    TEST_ASSERT(filter.snapshot().counters.inserts == 0);
+    TEST_ASSERT(filter.snapshot().counters.queries == 0);
+}
+
+void test_threads()
+{
+    using filter_type = leekpp::basic_bloom_filter<std::size_t,
+                                                   leekpp::basic_mixer<std::size_t>,
+                                                   leekpp::thread_safe_storage,
+                                                   leekpp::basic_sharded_stats<4>
+                                                  >;
+    auto filter = filter_type::create_ideal(0.01, 100000);
+
+    // More threads than shards, so some of them share
+    std::vector<std::thread> threads;
+    for (std::size_t thread_idx = 0; thread_idx < 6; ++thread_idx)
+    {
+        threads.emplace_back([&, thread_idx]
+                             {
+                                 for (std::size_t x = 0; x < 10000; ++x)
+                                 {
+                                     filter.insert(thread_idx * 10000 + x);
+                                     filter.count(thread_idx * 10000 + x);
+                                 }
+                             }
+                            );
+    }
+    for (auto& thread : threads)
+        thread.join();
+
+    auto counters = filter.stats().counters();
+    TEST_ASSERT(counters.inserts == 60000);
+    TEST_ASSERT(counters.queries == 60000);
+    TEST_ASSERT(counters.positives == 60000);
+}
+
+/** Inserts which write masks to the storage directly must still be counted, whatever the thread count. **/
+void test_bulk_inserts()
+{
+    std::vector<std::size_t> values;
+    for (std::size_t x = 0; x < 50000; ++x)
+        values.push_back(x);
+
+    for (std::size_t threads : { 1, 2, 4 })
+    {
+        auto filter = stats_filter::create_ideal(0.01, values.size());
+        leekpp::insert_parallel(filter, values.begin(), values.end(), threads);
+        TEST_ASSERT(filter.snapshot().counters.inserts == values.size());
+    }
+
+    auto filter = stats_filter::create_ideal(0.01, values.size());
+    {
+        leekpp::write_combining_buffer<stats_filter> buffer(filter);
+        buffer.insert(values.front());
+        buffer.insert_many(values.begin() + 1, values.end());
+    }
+    TEST_ASSERT(filter.snapshot().counters.inserts == values.size());
+    for (auto x : values)
+        TEST_ASSERT(filter.count(x) == 1);
+}
+
+void run_test()
+{
+    test_no_stats();
+    test_counters();
+    test_threads();
+    test_bulk_inserts();
+}
+
+}
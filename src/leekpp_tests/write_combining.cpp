@@ -0,0 +1,79 @@
+#include "test.hpp"
+
+#include <leekpp/write_combining_buffer.hpp>
+
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace leekpp_tests
+{
+
+template <typename TBloomFilter, typename TReference>
+void assert_same_bits(const TBloomFilter& filter, const TReference& reference)
+{
+    for (std::size_t block_idx = 0; block_idx < filter.data().block_count(); ++block_idx)
+        TEST_ASSERT(filter.data()[block_idx] == reference.data()[block_idx]);
+}
+
+template <typename TBloomFilter>
+void run_single_thread_test(std::size_t element_count = 100000)
+{
+    auto direct   = TBloomFilter::create_ideal(0.01, element_count);
+    auto buffered = TBloomFilter::create_ideal(0.01, element_count);
+    {
+        // A tiny buffer forces plenty of evictions
+        leekpp::write_combining_buffer<TBloomFilter, 16> buffer(buffered);
+        for (std::size_t x = 0; x < element_count; ++x)
+        {
+            direct.insert(x);
+            buffer.insert(x);
+        }
+    }
+    assert_same_bits(buffered, direct);
+
+    // Values are invisible until they are flushed
+    leekpp::write_combining_buffer<TBloomFilter> buffer(buffered);
+    buffer.insert(element_count * 3);
+    buffer.flush();
+    TEST_ASSERT(buffered.count(element_count * 3) == 1);
+}
+
+template <typename TBloomFilter>
+void run_multi_thread_test(std::size_t element_count = 200000, std::size_t thread_count = 4)
+{
+    auto filter = TBloomFilter::create_ideal(0.01, element_count);
+    std::vector<std::thread> threads;
+    for (std::size_t id = 0; id < thread_count; ++id)
+        threads.emplace_back([&filter, id, element_count, thread_count]
+                             {
+                                 leekpp::write_combining_buffer<TBloomFilter> buffer(filter);
+                                 for (std::size_t x = id; x < element_count; x += thread_count)
+                                     buffer.insert(x);
+                             });
+    for (auto& thread : threads)
+        thread.join();
+
+    auto reference = leekpp::basic_bloom_filter<typename TBloomFilter::value_type,
+                                                typename TBloomFilter::mixer_type
+                                               >::create_ideal(0.01, element_count);
+    for (std::size_t x = 0; x < element_count; ++x)
+        reference.insert(x);
+    assert_same_bits(filter, reference);
+}
+
+void run_test()
+{
+    run_single_thread_test<leekpp::bloom_filter<std::size_t>>();
+    run_single_thread_test<leekpp::cache_aligned_bloom_filter<std::size_t>>();
+    run_single_thread_test<leekpp::register_blocked_bloom_filter<std::size_t>>();
+
+    run_multi_thread_test<leekpp::thread_safe_bloom_filter<std::size_t>>();
+    run_multi_thread_test<leekpp::contention_aware_bloom_filter<std::size_t>>();
+    run_multi_thread_test<leekpp::contention_aware_bloom_filter<std::size_t,
+                                                                leekpp::basic_cache_aligned_mixer<std::size_t>
+                                                               >
+                         >();
+}
+
+}